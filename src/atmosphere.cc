@@ -36,7 +36,7 @@ const double atmos::maxchange[7] = {7000., 7.0e5, 5.0e5, 600., 600., phyc::PI/5,
 inline double SQ(const double a){return a*a;};
 inline double CUB(const double a){return a*a*a;};
 
-atmos::atmos(iput_t &inpt, double grav): eos(NULL), inst(NULL)
+atmos::atmos(iput_t &inpt, double grav): eos(NULL), inst(NULL), fit(NULL), iter_scale(1.0)
 {
   if(inpt.eos_type == 0) eos = new ceos(inpt.lines, inpt.abfile, grav);
   else                   eos = new eos::witt(inpt.lines, inpt.abfile, grav);
@@ -85,6 +85,15 @@ void atmos::responseFunction(int npar, mdepth_t &m_in, double *pars, int nd, dou
   
   bool store_pops = false;
   int centder = input.centder; 
+  int deriv = ((input.fixed_pops) ? fixed_pops_deriv : full_deriv);
+  
+  /* --- The populations are solved without magnetic field, the
+     B nodes only need the final formal solution --- */
+  
+  if((deriv == full_deriv) && ((input.nodes.ntype[pp] == bl_node) ||
+			       (input.nodes.ntype[pp] == bh_node) ||
+			       (input.nodes.ntype[pp] == azi_node)))
+    deriv = magnetic_deriv;
   //if(input.nodes.ntype[pp] == v_node) centder = 1;
 
   
@@ -138,7 +147,7 @@ void atmos::responseFunction(int npar, mdepth_t &m_in, double *pars, int nd, dou
 	m.getPressureScale(input.nodes.depth_t, input.boundary, *eos);
 	//m.nne_enhance(input.nodes, npar, &ipars[0], eos);
 
-	synth(m, &out[0], 1, (cprof_solver)input.solver, store_pops);
+	synth(m, &out[0], deriv, (cprof_solver)input.solver, store_pops, iter_scale);
     }
 
     
@@ -157,7 +166,7 @@ void atmos::responseFunction(int npar, mdepth_t &m_in, double *pars, int nd, dou
       m.getPressureScale(input.nodes.depth_t, input.boundary, *eos);
 	//m.nne_enhance(input.nodes, npar, &ipars[0], eos);
 
-      synth(m, &spec[0], 1, (cprof_solver)input.solver, store_pops);
+      synth(m, &spec[0], deriv, (cprof_solver)input.solver, store_pops, iter_scale);
     }
 
     /* --- Compute finite difference --- */
@@ -206,7 +215,7 @@ void atmos::responseFunction(int npar, mdepth_t &m_in, double *pars, int nd, dou
     m.getPressureScale(input.nodes.depth_t, input.boundary, *eos);
     //m.nne_enhance(input.nodes, npar, &ipars[0], eos);
       
-    synth(m, &out[0], 1, (cprof_solver)input.solver, store_pops);
+    synth(m, &out[0], deriv, (cprof_solver)input.solver, store_pops, iter_scale);
     
     /* --- Finite differences ---*/
     
@@ -226,13 +235,13 @@ void atmos::randomizeParameters(const nodes_t &n, int npar, double *pars, const
   static const double vtau[4] = {-7.0, -5.0, -3.0, 1.0};
   static const double vvel[4] = {10, 6.0, 3.0, 0.0};
   std::vector<double> res(n.v.size(), 0.0);
-  static bool firsttime = true;
+  static thread_local bool firsttime = true; // one generator per slave thread
   
-  static std::mt19937 rng;
+  static thread_local std::mt19937 rng;
   if(firsttime){
     rng.seed(std::random_device()());
   }
-  static std::uniform_int_distribution<std::mt19937::result_type> rand_dist(0,1.e4);
+  static thread_local std::uniform_int_distribution<std::mt19937::result_type> rand_dist(0,1.e4);
   firsttime = false;
   
   
@@ -883,11 +892,22 @@ int getChi2(int npar1, int nd, double *pars1, double *syn_in, double *dev, doubl
   
   
   
+  /* --- Inexact NLTE solution while the fit is far from converged:
+     the populations are converged to ITER_LIMIT times a factor that
+     decreases with the relative change of chi2 in the last accepted
+     iteration, down to 1 when it reaches the tolerance of clm --- */
+
+  atm.iter_scale = 1.0;
+  if(atm.fit && (atm.input.inexact_nlte > 1.0))
+    atm.iter_scale = std::max<double>(1.0, std::min<double>(atm.input.inexact_nlte,
+							     atm.fit->dchi / atm.fit->xtol));
+  
+  
   /* --- Compute synthetic spetra --- */
   
   memset(&atm.isyn[0], 0, nd*sizeof(double));
   //  for(int ii=0; ii<m.ndep;ii++) fprintf(stderr,"%e %e %e %e %e\n", m.cmass[ii], m.temp[ii], m.v[ii], m.vturb[ii], m.pgas[ii]);
-  bool conv = atm.synth( m , &atm.isyn[0], 0, (cprof_solver)atm.input.solver, true);  
+  bool conv = atm.synth( m , &atm.isyn[0], 0, (cprof_solver)atm.input.solver, true, atm.iter_scale);  
   
   
   if(!conv){
@@ -898,6 +918,19 @@ int getChi2(int npar1, int nd, double *pars1, double *syn_in, double *dev, doubl
  /* --- Compute derivatives? --- */
   
   if(derivs){
+
+    /* --- With fixed populations the perturbed spectra are compared
+       with the unperturbed one computed in the same way, the NLTE
+       spectrum is still used for the residue --- */
+
+    double *rsyn = &atm.isyn[0];
+    std::vector<double> fsyn;
+    
+    if(atm.input.fixed_pops){
+      fsyn.resize(nd, 0.0);
+      atm.synth(m, &fsyn[0], fixed_pops_deriv, (cprof_solver)atm.input.solver, false, atm.iter_scale);
+      rsyn = &fsyn[0];
+    }
     
     for(int pp = npar1-1; pp >= 0; pp--){
       
@@ -907,7 +940,7 @@ int getChi2(int npar1, int nd, double *pars1, double *syn_in, double *dev, doubl
 	
 	memset(&derivs[pp][0], 0, nd*sizeof(double));
 	atm.responseFunction(npar1, m, &ipars[0], nd,
-			      &derivs[pp][0], pp, &atm.isyn[0]);
+			      &derivs[pp][0], pp, rsyn);
 
 	
 	/* --- Degrade response function --- */
@@ -1157,8 +1190,24 @@ double atmos::fitModel2(mdepth_t &m, int npar, double *pars, int nobs, double *o
     
     /* --- Call clm --- */
 
+    fit = &lm;
     double chi2 = lm.fitdata(getChi2, &ipars[0], (void*)this, input.max_inv_iter, regul);
+    fit = NULL;
+
+    
+    /* --- The best model may come from an inexact NLTE solution,
+       evaluate it again with the full convergence limit --- */
 
+    if(input.inexact_nlte > 1.0){
+      vector<double> dev(ndata, 0.0), x(npar, 0.0);
+      reg_t dregul = regul;
+      if(!depth_per) memcpy(&x[0], &ipars[0], npar*sizeof(double));
+      
+      if(!getChi2(npar, ndata, &x[0], &lm.bestSyn[0], &dev[0], NULL, (void*)this, dregul, false)){
+	chi2 = dregul.getReg();
+	for(int ww = 0; ww < ndata; ww++) chi2 += dev[ww]*dev[ww];
+      }
+    }
     
     
     /* --- Re-start populations --- */
@@ -1234,6 +1283,7 @@ void atmos::responseFunctionFull(mdepth_t m, int nd, double *out_in, double *syn
   double dpar = ((input.dpar >= 1.e-3)?input.dpar : 0.01);
   double pertu = scal[pp] * dpar;
   int ndep = (int)m.ndep, centder = input.centder;
+  int deriv = (((pp >= 3) && (pp <= 5)) ? magnetic_deriv : full_deriv); // bl, bh, azi
   bool store_pops = false;
   //double (&out)[ndep][nd] = *reinterpret_cast< double (*)[ndep][nd]>(out_in);
   double **out = mmem::var2dim(out_in, ndep, nd);
@@ -1265,7 +1315,7 @@ void atmos::responseFunctionFull(mdepth_t m, int nd, double *out_in, double *syn
 	  eos.store_partial_pressures(m.ndep, kk, eos.xna, m.nne[kk]);
 	}
 	*/
-	synth(m, &syup[0], 1, (cprof_solver)input.solver, store_pops);
+	synth(m, &syup[0], deriv, (cprof_solver)input.solver, store_pops);
 	
       }
 
@@ -1284,7 +1334,7 @@ void atmos::responseFunctionFull(mdepth_t m, int nd, double *out_in, double *syn
 	  eos.store_partial_pressures(m.ndep, kk, eos.xna, m.nne[kk]);
 	}
 	*/
-	synth(m, &sydow[0], 1, (cprof_solver)input.solver, store_pops);
+	synth(m, &sydow[0], deriv, (cprof_solver)input.solver, store_pops);
       }
 
       
@@ -1330,7 +1380,7 @@ void atmos::responseFunctionFull(mdepth_t m, int nd, double *out_in, double *syn
       }
       */
 	
-      synth(m, &out[kk][0], 1, (cprof_solver)input.solver, store_pops);
+      synth(m, &out[kk][0], deriv, (cprof_solver)input.solver, store_pops);
 
       m.cub(pp, kk) = pval;
 
@@ -14,6 +14,17 @@
 #include "clm.h"
 #include "eoswrap.h"
 //
+/* --- computing_derivatives in synth: the perturbed models are solved
+   in full, or keep the populations of the last converged solution
+   always (fixed_pops_deriv) or when the perturbation cannot change
+   them (magnetic_deriv, only B) --- */
+enum deriv_type_t{
+  no_deriv,
+  full_deriv,
+  fixed_pops_deriv,
+  magnetic_deriv
+};
+//
 class atmos{
  public: 
   std::vector<double> mmin, mmax, scal, step, isyn, maxc;
@@ -27,15 +38,17 @@ class atmos{
   double *w;
   mdepth_t *imodel;
   eoswrap *eos;
+  clm *fit;          // fit in progress (fitModel2), NULL otherwise
+  double iter_scale; // NLTE convergence limit relative to ITER_LIMIT for the current getChi2
   
-  atmos(){};
+  atmos(): fit(NULL), iter_scale(1.0){};
   //atmos(iput_t &inpt, double grav = 4.44): eos(inpt.lines, inpt.abfile, grav), inst(NULL){};
   atmos(iput_t &inpt, double grav = 4.44);
 
   ~atmos(){if(eos) delete eos;}
   //virtual ~atmos(){};
   // virtual void init(iput_t &input) = 0;
-  virtual bool synth(mdepth_t &m, double *out, int computing_derivatives = 0, cprof_solver sol = bez_ltau, bool store_pops = true) = 0;
+  virtual bool synth(mdepth_t &m, double *out, int computing_derivatives = 0, cprof_solver sol = bez_ltau, bool store_pops = true, double iter_scale = 1.0) = 0;
   // virtual void synth_grad(double *model,  double *out, double *dout,  double change = 1.e-3) = 0;
   //virtual double fitmodel(double *m, double *syn) = 0;
   virtual void cleanup() = 0;
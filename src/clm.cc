@@ -378,6 +378,7 @@ clm::clm(int ind, int inpar){
   regul_scal_in = 0.0;// scale factor for regularization terms input
   proc = 0;           // print-out processor number
   reset_par = false;  // If true, use perturbation approach
+  dchi = 1.0;         // Relative change of chi2 of the last accepted iteration
 
   bestSyn.resize(nd, 0.0);
   iSyn.resize(nd, 0.0);
@@ -804,6 +805,7 @@ double clm::fitdata(clm_func fx, double *x, void *mydat, int maxiter, reg_t &dre
   regul_scal = regul_scal_in;
   int n_bracket = delay_bracket;
   corr = 1.0, q = 1.0;
+  dchi = 1.0;
   
   if(reset_par) memset(x, 0, npar*sizeof(double));
   
@@ -912,7 +914,8 @@ double clm::fitdata(clm_func fx, double *x, void *mydat, int maxiter, reg_t &dre
       
       /* --- is the improvements below our threshold? --- */
 
-      if(fabs(reldchi) < xtol){
+      dchi = fabs(reldchi);
+      if(dchi < xtol){
 	if(toolittle) exitme = true;
 	else toolittle = true;
       }else toolittle = false;
@@ -112,6 +112,7 @@ class clm{
   std::vector<std::vector<unsigned>> pidx;
   bool verb, regularize, first;
   double xtol, chi2_thres, svd_thres, lfac, lmax, lmin, ilambda, regul_scal, regul_scal_in, reset_par, corr, q, tchi;
+  double dchi; // |relative change of chi2| in the last accepted iteration, fx may use it to set its own accuracy
   int maxreject, proc, nvar, use_geo_accel, delay_bracket;
 
   
@@ -266,7 +266,7 @@ double clte::lte_opac(double temp, double n_u, double gf, double elow, double nu
 // -------------------------------------------------------------------------
 // Synthesize profiles given a depth-stratified model
 // -------------------------------------------------------------------------
-bool clte::synth(mdepth &m, double *syn, int computing_derivatives, cprof_solver sol, bool store_pops){
+bool clte::synth(mdepth &m, double *syn, int computing_derivatives, cprof_solver sol, bool store_pops, double iter_scale){
   string inam = "clte::synth: ";
   
   int ndep =   m.ndep;
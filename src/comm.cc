@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstdio>
 #include <chrono>
 #include <thread>
 #include "input.h"
@@ -12,6 +13,41 @@
 //
 using namespace std;
 //
+/* --- Outstanding nonblocking sends of the master (mpi_prefetch > 0) --- */
+
+static vector<char*> comm_sbuf;
+static vector<MPI_Request> comm_sreq;
+
+/* --- Pre-posted persistent receives of the master, one per slave --- */
+
+static vector<vector<char>> comm_rbuf;
+static vector<MPI_Request> comm_rreq;
+static double comm_trecv = 0.0;
+//
+static void comm_master_reap_sends()
+{
+  int nreq = (int)comm_sreq.size(), ndone = 0;
+  if(nreq == 0) return;
+  
+  vector<int> idx(nreq, 0);
+  MPI_Testsome(nreq, &comm_sreq[0], &ndone, &idx[0], MPI_STATUSES_IGNORE);
+  if(ndone <= 0) return;
+
+  for(int ii=0; ii<ndone; ii++){
+    delete [] comm_sbuf[idx[ii]];
+    comm_sbuf[idx[ii]] = NULL;
+  }
+
+  int kk = 0;
+  for(int ii=0; ii<nreq; ii++){
+    if(comm_sbuf[ii] == NULL) continue;
+    comm_sbuf[kk] = comm_sbuf[ii];
+    comm_sreq[kk++] = comm_sreq[ii];
+  }
+  comm_sbuf.resize(kk);
+  comm_sreq.resize(kk);
+}
+//
 int getNinstrumentData(std::vector<region_t> const &reg)
 {
   int const nReg = int(reg.size());
@@ -53,6 +89,19 @@ std::vector<double> packInstrumentalData(iput_t &input, int yy, int xx)
   }
   return res;
 }
+/* --- Packages carry the instrumental profiles of their first pixel only.
+   That is fine unless a region has a different profile for each pixel,
+   which then needs packages of one pixel --- */
+
+bool comm_pixel_instruments(iput_t const &input)
+{
+  static const string no = "none";
+  
+  for(auto &it: input.regions)
+    if(it.inst != no && it.psf.ndims() > 1) return true;
+  
+  return false;
+}
 void unpackInstrumentalData(iput_t &input, std::vector<double> const &buff)
 {
   static const string no = "none";
@@ -87,18 +136,21 @@ void comm_get_buffer_size(iput_t &input){
 	 (13 * input.ndep + 1)* sizeof(double) + //non-inverted quantities
 	 2*sizeof(double)) * input.npack + // Chi2, boundary value
 	6*sizeof(int) +      // xx, yy, iproc, pix, action, npacked
+	input.npack*sizeof(int) + // pixel list
 	ninstrumentaldata * sizeof(double);      
       
-      input.buffer_size1 = input.buffer_size;
+      input.buffer_size1 = input.buffer_size +
+	input.npack*sizeof(double); // wall time per pixel
       break;
       //
     case 2: // Synthesis
       input.buffer_size =
 	(13 * input.ndep * sizeof(double)) * input.npack + // depth-stratified quantities
 	6*sizeof(int) + // xx, yy, iproc, pix, action, npacked
+	input.npack*sizeof(int) + // pixel list
 	ninstrumentaldata * sizeof(double);      
       input.buffer_size1 =
-	(input.nw_tot*4*sizeof(double)) * input.npack + 6*sizeof(int);
+	(input.nw_tot*4*sizeof(double) + sizeof(double) + sizeof(int)) * input.npack + 6*sizeof(int);
       break;
       //
     case 3: // Synthesis + derivatives
@@ -106,20 +158,23 @@ void comm_get_buffer_size(iput_t &input){
 	8*sizeof(int) + // xx, yy, iproc, pix, action, npacked, ndep, cgrad
 	input.npar*sizeof(double) * input.npack + // Values of the nodes * npacked
 	1*sizeof(double) + // perturbation to the parameter
-	(13*input.ndep + 1)*sizeof(double)*input.npack; // atmospheric model
+	(13*input.ndep + 1)*sizeof(double)*input.npack + // atmospheric model
+	input.npack*sizeof(int); // pixel list
       
       input.buffer_size1 = (input.nw_tot*4*sizeof(double) +                    
 			    input.nw_tot*4*input.npar*sizeof(double) + // Derivatives
-			    1*sizeof(double)) * input.npack +// perturbation to the parameter
+			    2*sizeof(double) + sizeof(int)) * input.npack +// perturbation to the parameter, wall time, pixel list
 	                    13*input.npack*input.ndep*sizeof(double)+ // Send back the pressure scale
 	                    6*sizeof(int); // xx, yy, ipix, npacked, iproc
 
     case 4:// Synthesis + derivatives at all heights
       input.buffer_size =
 	(13 * input.ndep * sizeof(double)) * input.npack + // depth-stratified quantities
-	6*sizeof(int)+ninstrumentaldata * sizeof(double);; // xx, yy, iproc, pix, action, npacked
+	6*sizeof(int)+ninstrumentaldata * sizeof(double) + // xx, yy, iproc, pix, action, npacked
+	input.npack*sizeof(int); // pixel list
       
-      input.buffer_size1 = (input.nw_tot*4*sizeof(double) * (input.ndep*input.nresp+1)) + 6*sizeof(int);
+      input.buffer_size1 = (input.nw_tot*4*sizeof(double) * (input.ndep*input.nresp+1) +
+			    sizeof(double) + sizeof(int)) * input.npack + 6*sizeof(int); // wall time and pixel list
       break;
     default:
       cout << input.myid<< inam <<"ERROR, work mode ("<<input.mode<<") not valid"<<endl;
@@ -143,13 +198,13 @@ void comm_send_parameters(iput_t &input){
   status = MPI_Bcast(&nregions,  1,    MPI_INT, 0, MPI_COMM_WORLD);  
   status = MPI_Bcast(&input.buffer_size,  2,    MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
 
-  status = MPI_Bcast(&input.nt, 38,    MPI_INT, 0, MPI_COMM_WORLD); // We are sending 11 ints from the struct!
+  status = MPI_Bcast(&input.nt, 47,    MPI_INT, 0, MPI_COMM_WORLD); // We are sending 11 ints from the struct!
   status = MPI_Bcast(&input.nodes.regul_type, 8,    MPI_INT, 0, MPI_COMM_WORLD); // We are getting 15 ints from the struc
   status = MPI_Bcast(&input.nodes.rewe, 9,    MPI_DOUBLE, 0, MPI_COMM_WORLD); // We are getting 15 ints from the struct!
   // status = MPI_Bcast(&input.nodes.nregul,     1,    MPI_INT, 0, MPI_COMM_WORLD);
 
 
-  status = MPI_Bcast(&input.mu,  8, MPI_DOUBLE, 0, MPI_COMM_WORLD); // We are sending 4 doubles from the struct!
+  status = MPI_Bcast(&input.mu,  9, MPI_DOUBLE, 0, MPI_COMM_WORLD); // We are sending 4 doubles from the struct!
   status = MPI_Bcast(&input.max_inv_iter,  1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
     
   //int dummy = (int)input.verbose;
@@ -252,7 +307,7 @@ void comm_recv_parameters(iput_t &input){
   status = MPI_Bcast(&nline,     1,    MPI_INT, 0, MPI_COMM_WORLD);
   status = MPI_Bcast(&nregions,  1,    MPI_INT, 0, MPI_COMM_WORLD);
   status = MPI_Bcast(&input.buffer_size,  2,    MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
-  status = MPI_Bcast(&input.nt, 38,    MPI_INT, 0, MPI_COMM_WORLD); // We are getting 15 ints from the struct!
+  status = MPI_Bcast(&input.nt, 47,    MPI_INT, 0, MPI_COMM_WORLD); // We are getting 15 ints from the struct!
 
   status = MPI_Bcast(&input.nodes.regul_type, 8,    MPI_INT, 0, MPI_COMM_WORLD); // We are getting 15 ints from the struct!
   status = MPI_Bcast(&input.nodes.rewe, 9,    MPI_DOUBLE, 0, MPI_COMM_WORLD); // We are getting 15 ints from the struct!
@@ -260,7 +315,7 @@ void comm_recv_parameters(iput_t &input){
   // status = MPI_Bcast(&input.nodes.nregul,     1,    MPI_INT, 0, MPI_COMM_WORLD);
 
 
-  status = MPI_Bcast(&input.mu,  8, MPI_DOUBLE, 0, MPI_COMM_WORLD); // We are getting 4 doubles from the struct!
+  status = MPI_Bcast(&input.mu,  9, MPI_DOUBLE, 0, MPI_COMM_WORLD); // We are getting 4 doubles from the struct!
   status = MPI_Bcast(&input.max_inv_iter,  1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
 
   //int dummy = 0;
@@ -385,9 +440,40 @@ void comm_recv_parameters(iput_t &input){
 
   
 }
+/* --- Pack/unpack "n" doubles per pixel for the pixels in "pix", d points to
+   the first pixel of the raster. Contiguous lists go in one call --- */
+
+static bool comm_contiguous(std::vector<int> const& pix)
+{
+  for(size_t ii=1; ii<pix.size(); ii++) if(pix[ii] != pix[0]+int(ii)) return false;
+  return true;
+}
+
+static void comm_pack_pixels(double *d, unsigned long n, std::vector<int> const& pix,
+			     char *buffer, int bsize, int &pos)
+{
+  if(comm_contiguous(pix)){
+    MPI_Pack(d + pix[0]*n, n*pix.size(), MPI_DOUBLE, buffer, bsize, &pos, MPI_COMM_WORLD);
+    return;
+  }
+  for(auto &it: pix)
+    MPI_Pack(d + it*n, n, MPI_DOUBLE, buffer, bsize, &pos, MPI_COMM_WORLD);
+}
+
+static void comm_unpack_pixels(double *d, unsigned long n, std::vector<int> const& pix,
+			       char *buffer, int bsize, int &pos)
+{
+  if(comm_contiguous(pix)){
+    MPI_Unpack(buffer, bsize, &pos, d + pix[0]*n, n*pix.size(), MPI_DOUBLE, MPI_COMM_WORLD);
+    return;
+  }
+  for(auto &it: pix)
+    MPI_Unpack(buffer, bsize, &pos, d + it*n, n, MPI_DOUBLE, MPI_COMM_WORLD);
+}
+
 void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
 			   unsigned long &ipix, int proc, mdepthall_t &m, int cgrad,
-			   int action){
+			   int action, int npack){
   string inam = "comm_pack_data: ";
   double dum[m.ndep];
   memset(dum, 0, m.ndep * sizeof(double));
@@ -405,20 +491,35 @@ void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
 
   status = MPI_Pack(&action, 1,     MPI_INT, &buffer[0], input.buffer_size, &pos, MPI_COMM_WORLD);
   //
+  if(npack <= 0 || npack > input.npack) npack = input.npack; // buffers are sized for input.npack
   int init = ipix;
-  int end  = min(ipix + input.npack-1, ntot-1); 
+  int end  = min(ipix + npack-1, ntot-1); 
   int nPacked = end - init + 1;
   //
   status = MPI_Pack(&nPacked, 1,     MPI_INT, &buffer[0], input.buffer_size, &pos, MPI_COMM_WORLD);
+
+  
+  /* --- Pixels in this package, raster order unless input.order is set --- */
+  
+  std::vector<int> &pix = input.pixels;
+  pix.resize(nPacked);
+  for(int ii=0; ii<nPacked; ii++) pix[ii] = (input.order.size() == ntot) ? input.order[init+ii] : init+ii;
+  status = MPI_Pack(&pix[0], nPacked, MPI_INT, &buffer[0], input.buffer_size, &pos, MPI_COMM_WORLD);
+
+  int first = pix[0]; // first pixel, used for the instrumental data
+  if(nPacked > 1 && input.mode != 3 && comm_pixel_instruments(input)){
+    cerr << input.myid << inam << "ERROR, instrumental profiles per pixel need mpi_pack = 1" << endl;
+    exit(0);
+  }
   //
   switch(input.mode)
     {
     case 1:
       {
 	/* ---  Pack all pixels --- */
-	comm_get_xy(ipix, model.size(1), yy, xx);
+	comm_get_xy(first, model.size(1), yy, xx);
 	
-	status = MPI_Pack(&ipix  , 1,     MPI_INT, &buffer[0], input.buffer_size,
+	status = MPI_Pack(&first , 1,     MPI_INT, &buffer[0], input.buffer_size,
 			  &pos, MPI_COMM_WORLD);
 	status = MPI_Pack(&xx    , 1,     MPI_INT, &buffer[0], input.buffer_size,
 			  &pos, MPI_COMM_WORLD);
@@ -426,23 +527,13 @@ void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
 			  &pos, MPI_COMM_WORLD);
 	
 	/* --- Pack model and obs --- */
-	int len = nPacked * input.ns * input.nw_tot;
-	status = MPI_Pack(&obs(yy,xx,0,0), len,  MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
-	
-	len = nPacked * input.npar;
-	status = MPI_Pack(&model(yy,xx,0), len,  MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
+	comm_pack_pixels(&obs.d[0], input.ns * input.nw_tot, pix, &buffer[0], input.buffer_size, pos);
+	comm_pack_pixels(&model.d[0], input.npar, pix, &buffer[0], input.buffer_size, pos);
 	
 
 	/* --- Pack full stratified atmos ---*/
-	len = m.ndep * nPacked * 13;
-	status = MPI_Pack(&m.cub(yy,xx,0,0), len, MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
-	
-	len = nPacked;
-	status = MPI_Pack(&m.boundary(yy,xx), len, MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
+	comm_pack_pixels(&m.cub.d[0], m.ndep * 13, pix, &buffer[0], input.buffer_size, pos);
+	comm_pack_pixels(&m.boundary.d[0], 1, pix, &buffer[0], input.buffer_size, pos);
 	//
 	ipix += nPacked; // Increase the pixel count
 
@@ -461,8 +552,8 @@ void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
 
 
 	/* ---  Pack all pixels --- */
-	comm_get_xy(ipix, model.size(1), yy, xx);
-	status = MPI_Pack(&ipix  , 1,     MPI_INT, &buffer[0], input.buffer_size,
+	comm_get_xy(first, model.size(1), yy, xx);
+	status = MPI_Pack(&first , 1,     MPI_INT, &buffer[0], input.buffer_size,
 			  &pos, MPI_COMM_WORLD);
 	status = MPI_Pack(&xx    , 1,     MPI_INT, &buffer[0], input.buffer_size,
 			  &pos, MPI_COMM_WORLD);
@@ -471,9 +562,7 @@ void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
 
 	
 	/* --- Pack full stratified atmos ---*/
-	len = m.ndep * nPacked * 13;
-	status = MPI_Pack(&m.cub(yy,xx,0,0), len, MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
+	comm_pack_pixels(&m.cub.d[0], m.ndep * 13, pix, &buffer[0], input.buffer_size, pos);
 
 	
 
@@ -490,28 +579,21 @@ void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
       }
     case 3:
       { //Synthesis + Derivatives
-	comm_get_xy(ipix, model.size(1), yy, xx);
+	comm_get_xy(first, model.size(1), yy, xx);
 	
 	/* --- Pack data: ipix, xx, yy, compute_grad (?) --- */
-	int pint[4] = {(int)ipix, (int)xx, (int)yy, (int)cgrad};
+	int pint[4] = {(int)first, (int)xx, (int)yy, (int)cgrad};
 	status = MPI_Pack(&pint[0]       , 4,     MPI_INT,    &buffer[0],
 			  input.buffer_size, &pos, MPI_COMM_WORLD);
 	status = MPI_Pack(&input.dpar    , 1,     MPI_DOUBLE, &buffer[0],
 			  input.buffer_size, &pos, MPI_COMM_WORLD);
 	
 	/* --- Pack node values --- */
-	len = input.npar * nPacked;
-	status = MPI_Pack(&model(yy,xx,0), len, MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
+	comm_pack_pixels(&model.d[0], input.npar, pix, &buffer[0], input.buffer_size, pos);
 
 	/* --- Pack full stratified atmos ---*/
-	len = m.ndep * nPacked * 13;
-	status = MPI_Pack(&m.cub(yy,xx,0,0), len, MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
-
-	len = nPacked;
-	status = MPI_Pack(&m.boundary(yy,xx), len, MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
+	comm_pack_pixels(&m.cub.d[0], m.ndep * 13, pix, &buffer[0], input.buffer_size, pos);
+	comm_pack_pixels(&m.boundary.d[0], 1, pix, &buffer[0], input.buffer_size, pos);
 	
 	/* --- Increase the count --- */
 	ipix += nPacked; // Increase the pixel count
@@ -520,15 +602,13 @@ void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
       }
     case 4:
       { // synthesis + derivatives at all heights
-	comm_get_xy(ipix, model.size(1), yy, xx);
-	int pint[3] = {(int)ipix, (int)xx, (int)yy};
+	comm_get_xy(first, model.size(1), yy, xx);
+	int pint[3] = {(int)first, (int)xx, (int)yy};
 	status = MPI_Pack(&pint[0]       , 3,     MPI_INT,    &buffer[0],
 			  input.buffer_size, &pos, MPI_COMM_WORLD);
 
 	/* --- pack ful model --- */
-	len = input.ndep * 13*nPacked;
-	status = MPI_Pack(&m.cub(yy,xx,0,0), len, MPI_DOUBLE, &buffer[0],
-			  input.buffer_size, &pos, MPI_COMM_WORLD);
+	comm_pack_pixels(&m.cub.d[0], input.ndep * 13, pix, &buffer[0], input.buffer_size, pos);
 	ipix += nPacked; // Increase the pixel count
 
 	// --- Instrumental profiles --- //
@@ -545,14 +625,71 @@ void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model,
 
   
   /* ---  Send data to slave --- */
+
+  if(input.prefetch > 0){
+
+    /* --- The slave may still be busy, do not wait for it --- */
+    
+    MPI_Request req;
+    status = MPI_Isend(&buffer[0], input.buffer_size, MPI_PACKED, proc, 1, MPI_COMM_WORLD, &req);
+    comm_sbuf.push_back(buffer);
+    comm_sreq.push_back(req);
+
+    comm_master_reap_sends();
+    
+  }else{
+    status = MPI_Send(&buffer[0], input.buffer_size, MPI_PACKED, proc, 1, MPI_COMM_WORLD);
+    delete [] buffer;
+  }
+}
+
+void comm_master_wait_sends()
+{
+  int nreq = (int)comm_sreq.size();
+  if(nreq == 0) return;
   
-  status = MPI_Send(&buffer[0], input.buffer_size, MPI_PACKED, proc, 1, MPI_COMM_WORLD);
+  MPI_Waitall(nreq, &comm_sreq[0], MPI_STATUSES_IGNORE);
+  
+  for(auto &it: comm_sbuf) delete [] it;
+  comm_sbuf.clear();
+  comm_sreq.clear();
+}
 
-  delete [] buffer;
+void comm_slave_init_queue(iput_t &input, comm_queue_t &q)
+{
+  q.nbuf = 1 + std::max(input.prefetch, 0);
+  q.head = 0;
+  q.rbuf.resize(q.nbuf);
+  q.rreq.resize(q.nbuf, MPI_REQUEST_NULL);
+  q.sbuf.resize(input.buffer_size1);
+  q.sreq = MPI_REQUEST_NULL;
 
+  
+  /* --- Post all receives, the master fills them in order --- */
+  
+  for(int ii=0; ii<q.nbuf; ii++){
+    q.rbuf[ii].resize(input.buffer_size);
+    MPI_Irecv(&q.rbuf[ii][0], input.buffer_size, MPI_PACKED, input.parent, 1, MPI_COMM_WORLD, &q.rreq[ii]);
+  }
+}
+
+void comm_slave_free_queue(comm_queue_t &q)
+{
+  for(auto &it: q.rreq){
+    if(it == MPI_REQUEST_NULL) continue;
+    MPI_Cancel(&it);
+    MPI_Wait(&it, MPI_STATUS_IGNORE);
+  }
+  
+  MPI_Wait(&q.sreq, MPI_STATUS_IGNORE);
+  
+  q.rbuf.clear();
+  q.rreq.clear();
+  q.sbuf.clear();
+  q.nbuf = 0;
 }
 
-void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<double> &pars, vector<mdepth_t> &m, int &cgrad){
+void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<double> &pars, vector<mdepth_t> &m, int &cgrad, comm_queue_t *q){
   string inam = "comm_slave_unpack_data: ";
 
   //char buffer[input.buffer_size];
@@ -568,7 +705,18 @@ void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<do
   
   //int status = MPI_Recv(buffer, input.buffer_size, MPI_PACKED, 0, 1, MPI_COMM_WORLD, &ierr);
 
-  while(1){
+  static double twait = 0.0;
+  static long nwait = 0;
+  double t0 = MPI_Wtime();
+  
+  if(q){
+
+    /* --- Next package is (most likely) already here --- */
+    
+    MPI_Wait(&q->rreq[q->head], &ierr);
+    buffer = &q->rbuf[q->head][0];
+    
+  }else while(1){
     int from_process = MPI_ANY_SOURCE, msg_tag = 1, flag = 0;
     MPI_Iprobe(from_process, msg_tag, MPI_COMM_WORLD, &flag, &stat);
     
@@ -589,17 +737,31 @@ void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<do
   /* --- Unpack action --- */
   
   status = MPI_Unpack(buffer, input.buffer_size, &pos, &action, 1, MPI_INT, MPI_COMM_WORLD );
+
+
+  /* --- Keep track of the time spent idle waiting for packages --- */
+  
+  if(action != 0){
+    twait += MPI_Wtime() - t0;
+    nwait++;
+  }else if(input.verbose && nwait > 0)
+    fprintf(stderr,"%scomm_slave_unpack_data: waited %.3f ms per package on average (%ld packages)\n",
+	    input.myid.c_str(), twait*1.e3/nwait, nwait);
   
   if(action == 1){
 
+    /* --- Number of packed pixels and their location in the raster --- */
+    
+    status = MPI_Unpack(buffer, input.buffer_size, &pos, &nPacked, 1, MPI_INT, MPI_COMM_WORLD );
+    input.pixels.resize(nPacked);
+    status = MPI_Unpack(buffer, input.buffer_size, &pos, &input.pixels[0], nPacked, MPI_INT, MPI_COMM_WORLD );
+
+    
     // Check mode and do whatever is required
     switch(input.mode)
       {
       case 1:
 	{
-	  // Number of packed pixels
-	  status = MPI_Unpack(buffer, input.buffer_size, &pos, &nPacked, 1,
-			      MPI_INT, MPI_COMM_WORLD );
 	  
 
 	  input.chi.resize(nPacked);
@@ -667,9 +829,6 @@ void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<do
 	  break;
 	}
       case 2:
-	  // Number of packed pixels
-	  status = MPI_Unpack(buffer, input.buffer_size, &pos, &nPacked, 1,
-			      MPI_INT, MPI_COMM_WORLD );
 	  
 
 	  input.nPacked = nPacked;
@@ -714,8 +873,6 @@ void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<do
 	break;
       case 3: // Synthesize + derivatives
 	{
-	  /* --- Number of packed pixels --- */
-	  status = MPI_Unpack(buffer, input.buffer_size, &pos, &nPacked, 1, MPI_INT, MPI_COMM_WORLD );
 	  input.nPacked = nPacked;
 
 	  
@@ -760,7 +917,6 @@ void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<do
 	  break;
 	}
       case 4:
-	status = MPI_Unpack(buffer, input.buffer_size, &pos, &nPacked, 1, MPI_INT, MPI_COMM_WORLD );
 	input.nPacked = nPacked;
 	m.resize(nPacked);
 
@@ -797,28 +953,78 @@ void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<do
       }
   } // action = 1
     
+
+  if(action == 1) input.ptime.assign(input.nPacked, 0.0);
+
+  
+  if(q){
+
+    /* --- Re-post the receive on this slot for a future package --- */
+    
+    if(action != 0)
+      MPI_Irecv(buffer, input.buffer_size, MPI_PACKED, input.parent, 1, MPI_COMM_WORLD, &q->rreq[q->head]);
+    q->head = (q->head + 1) % q->nbuf;
     
-  delete [] buffer;
+  }else delete [] buffer;
+}
+
+
+void comm_master_init_recv(iput_t &input)
+{
+  int const nslaves = (int)input.children.size();
+  if(nslaves <= 0) return;
+  
+  comm_rbuf.resize(nslaves);
+  comm_rreq.resize(nslaves, MPI_REQUEST_NULL);
+  
+  for(int ss=0; ss<nslaves; ss++){
+    comm_rbuf[ss].resize(input.buffer_size1);
+    MPI_Recv_init(&comm_rbuf[ss][0], input.buffer_size1, MPI_PACKED, input.children[ss], 3, MPI_COMM_WORLD, &comm_rreq[ss]);
+  }
+  
+  MPI_Startall(nslaves, &comm_rreq[0]);
+}
+
+void comm_master_free_recv()
+{
+  for(auto &it: comm_rreq){
+    MPI_Cancel(&it);
+    MPI_Wait(&it, MPI_STATUS_IGNORE);
+    MPI_Request_free(&it);
+  }
+  
+  comm_rreq.clear();
+  comm_rbuf.clear();
 }
 
+double comm_master_recv_time()
+{
+  return comm_trecv;
+}
 
-void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, mat<double> &pars, mat<double> &chi2, unsigned long &irec, mat<double> &dsyn, int cgrad, mdepthall_t &m){
+void comm_master_unpack_data(int &iproc, iput_t &input, mat<double> &obs, mat<double> &pars, mat<double> &chi2, unsigned long &irec, mat<double> &dsyn, int cgrad, mdepthall_t &m, mat<double> *ptime){
   
   // char buffer[input.buffer_size];
   char *buffer;// = new char [input.buffer_size1];
   
   int  pos = 0;
-  int nPacked = 0, nbuff=0, tag = 0;
+  int nPacked = 0, nbuff=0, tag = 0, islot = -1;
   int status = 0;
   MPI_Status ierr = {}, stat = {};
-  unsigned long len;
 
   // Get buffer from the slave
   //status = MPI_Recv(buffer, input.buffer_size1, MPI_PACKED, MPI_ANY_SOURCE,
   //		    MPI_ANY_TAG, MPI_COMM_WORLD, &ierr);
 
-  while(1){
-    int from_process = MPI_ANY_SOURCE, msg_tag = MPI_ANY_TAG, flag = 0;
+  if(comm_rreq.size() > 0){
+
+    /* --- Block until any of the pre-posted receives completes --- */
+    
+    status = MPI_Waitany((int)comm_rreq.size(), &comm_rreq[0], &islot, &ierr);
+    buffer = &comm_rbuf[islot][0];
+    
+  }else while(1){
+    int from_process = MPI_ANY_SOURCE, msg_tag = 3, flag = 0;
     MPI_Iprobe(from_process, msg_tag, MPI_COMM_WORLD, &flag, &stat);
     
     if(flag > 0){
@@ -834,6 +1040,7 @@ void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, mat<dou
     std::this_thread::sleep_for(std::chrono::microseconds(40)); // Avoid polling all the time
     
   }
+  comm_trecv = MPI_Wtime();
 
 
   
@@ -845,49 +1052,40 @@ void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, mat<dou
   status = MPI_Unpack(buffer, input.buffer_size1, &pos, &iproc, 1, MPI_INT,
 		      MPI_COMM_WORLD );
 
+  // Get wall time per pixel and where the pixels go in the raster
+  vector<double> wtime(nPacked, 0.0);
+  vector<int> pixl(nPacked, 0);
+  status = MPI_Unpack(buffer, input.buffer_size1, &pos, &wtime[0], nPacked, MPI_DOUBLE,
+		      MPI_COMM_WORLD );
+  status = MPI_Unpack(buffer, input.buffer_size1, &pos, &pixl[0], nPacked, MPI_INT,
+		      MPI_COMM_WORLD );
+
   switch(input.mode)
     {
     case 1:
       {
 	// Unpack pixel data
 	//for(int pp = 0; pp<nPacked;pp++){
-	int pix, xx, yy;
+	int pix;
 	status = MPI_Unpack(&buffer[0], input.buffer_size1, &pos, &pix, 1,
 			    MPI_INT, MPI_COMM_WORLD );
-	comm_get_xy(pix, input.nx, yy, xx);
 	
-	status = MPI_Unpack(&buffer[0], input.buffer_size1, &pos, &chi2(yy,xx),
-			    nPacked, MPI_DOUBLE, MPI_COMM_WORLD );
-	len = input.nw_tot * input.ns * nPacked;
-	status = MPI_Unpack(&buffer[0], input.buffer_size1, &pos, &obs(yy,xx,0,0),
-			    len, MPI_DOUBLE, MPI_COMM_WORLD );
-
-  
-	len = input.npar*nPacked;
-	status = MPI_Unpack(&buffer[0], input.buffer_size1, &pos, &pars(yy,xx,0),
-			    len, MPI_DOUBLE, MPI_COMM_WORLD );
+	comm_unpack_pixels(&chi2.d[0], 1, pixl, buffer, input.buffer_size1, pos);
+	comm_unpack_pixels(&obs.d[0], input.nw_tot * input.ns, pixl, buffer, input.buffer_size1, pos);
+	comm_unpack_pixels(&pars.d[0], input.npar, pixl, buffer, input.buffer_size1, pos);
 	irec += nPacked;
 
-	len = input.ndep*13;
-	for(int ii=0;ii<nPacked;ii++){
-	  comm_get_xy(pix++, input.nx, yy, xx);
-	  status = MPI_Unpack(buffer, input.buffer_size1, &pos, &m.cub(yy,xx,0,0),
-			      len, MPI_DOUBLE, MPI_COMM_WORLD);
-
-	}
+	comm_unpack_pixels(&m.cub.d[0], input.ndep*13, pixl, buffer, input.buffer_size1, pos);
 	break;
       }
     case 2:
       {
 	
-	int pix, xx, yy;
+	int pix;
 	status = MPI_Unpack(&buffer[0], input.buffer_size1, &pos, &pix, 1,
 			    MPI_INT, MPI_COMM_WORLD );
-	comm_get_xy(pix, input.nx, yy, xx);
 	
-	len = input.nw_tot * input.ns * nPacked;
-	status = MPI_Unpack(&buffer[0], input.buffer_size1, &pos, &obs(yy,xx,0,0),
-			    len, MPI_DOUBLE, MPI_COMM_WORLD );
+	comm_unpack_pixels(&obs.d[0], input.nw_tot * input.ns, pixl, buffer, input.buffer_size1, pos);
 
   
 	irec += nPacked;
@@ -897,32 +1095,16 @@ void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, mat<dou
     case 3:
       {
 	// for(int pp = 0; pp<nPacked;pp++){
-	int pix, xx, yy, nx;
-	nx = (int)obs.size(1);
+	int pix;
 	
 	status = MPI_Unpack(buffer, input.buffer_size1, &pos, &pix, 1, MPI_INT,
 			    MPI_COMM_WORLD );
-	comm_get_xy(pix, nx, yy, xx);
-	
-	len = input.nw_tot * input.ns * nPacked;
-	status = MPI_Unpack(buffer, input.buffer_size1, &pos, &obs(yy,xx,0,0), len,
-			    MPI_DOUBLE, MPI_COMM_WORLD );
-
-	len = input.ndep*13;
-	int mypix = pix, iyy=0, ixx=0;
 	
-	for(int ii = 0; ii< nPacked;ii++){
-	  comm_get_xy(mypix++, nx, iyy, ixx);
-	  status = MPI_Unpack(buffer, input.buffer_size1, &pos, &m.cub(yy,xx,0,0),
-			      len, MPI_DOUBLE, MPI_COMM_WORLD);
-	  //cerr<<mypix-1<<" "<<iyy<<" "<<ixx<<endl;
-	}
+	comm_unpack_pixels(&obs.d[0], input.nw_tot * input.ns, pixl, buffer, input.buffer_size1, pos);
+	comm_unpack_pixels(&m.cub.d[0], input.ndep*13, pixl, buffer, input.buffer_size1, pos);
 	  
-	if(cgrad > 0){
-	  len = input.nw_tot * input.ns * input.npar * nPacked;
-	  status = MPI_Unpack(buffer, input.buffer_size1, &pos, &dsyn(yy,xx,0,0,0), len,
-			      MPI_DOUBLE, MPI_COMM_WORLD);
-	}
+	if(cgrad > 0)
+	  comm_unpack_pixels(&dsyn.d[0], input.nw_tot * input.ns * input.npar, pixl, buffer, input.buffer_size1, pos);
 	
 	irec += nPacked;
 	
@@ -930,19 +1112,13 @@ void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, mat<dou
       }
     case 4:
       {
-	int pix, xx, yy, nx;
-	nx = (int)obs.size(1);
+	int pix;
 	status = MPI_Unpack(buffer, input.buffer_size1, &pos, &pix, 1, MPI_INT,
 			    MPI_COMM_WORLD );
-	comm_get_xy(pix, nx, yy, xx);
-	
-	len = input.nw_tot * input.ns * nPacked;
-	status = MPI_Unpack(buffer, input.buffer_size1, &pos, &obs(yy,xx,0,0), len,
-			    MPI_DOUBLE, MPI_COMM_WORLD );
 	
-	len = input.nw_tot * input.ns * input.ndep * input.nresp * nPacked;
-	status = MPI_Unpack(buffer, input.buffer_size1, &pos, &dsyn(yy,xx,0,0,0,0), len,
-			    MPI_DOUBLE, MPI_COMM_WORLD);
+	comm_unpack_pixels(&obs.d[0], input.nw_tot * input.ns, pixl, buffer, input.buffer_size1, pos);
+	comm_unpack_pixels(&dsyn.d[0], input.nw_tot * input.ns * input.ndep * input.nresp, pixl,
+			   buffer, input.buffer_size1, pos);
 	
 	irec += nPacked;
 
@@ -953,14 +1129,23 @@ void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, mat<dou
     }
   
 
-  delete [] buffer;
+  if(ptime && ptime->d.size() > 0)
+    for(int ii=0; ii<nPacked; ii++) ptime->d[pixl[ii]] = wtime[ii];
+
+  
+  if(islot >= 0) MPI_Start(&comm_rreq[islot]); // ready for the next one
+  else delete [] buffer;
   
 }
 
 
-void comm_slave_pack_data(iput_t &input, mat<double> &obs, mat<double> &pars, mat<double> &dobs, int cgrad, vector<mdepth_t> &m){
+void comm_slave_pack_data(iput_t &input, mat<double> &obs, mat<double> &pars, mat<double> &dobs, int cgrad, vector<mdepth_t> &m, comm_queue_t *q){
 
-  char *buffer = new char [input.buffer_size1];
+  char *buffer = NULL;
+  if(q){
+    MPI_Wait(&q->sreq, MPI_STATUS_IGNORE); // previous results must be gone
+    buffer = &q->sbuf[0];
+  }else buffer = new char [input.buffer_size1];
 
   int  pos = 0;
   int nPacked = input.nPacked;
@@ -970,6 +1155,10 @@ void comm_slave_pack_data(iput_t &input, mat<double> &obs, mat<double> &pars, ma
 			&pos, MPI_COMM_WORLD);
   status = MPI_Pack(&input.myrank, 1,     MPI_INT, &buffer[0], input.buffer_size1,
 		    &pos, MPI_COMM_WORLD);
+  status = MPI_Pack(&input.ptime[0], nPacked, MPI_DOUBLE, &buffer[0], input.buffer_size1,
+		    &pos, MPI_COMM_WORLD);
+  status = MPI_Pack(&input.pixels[0], nPacked, MPI_INT, &buffer[0], input.buffer_size1,
+		    &pos, MPI_COMM_WORLD);
 
   switch(input.mode)
     {
@@ -1053,10 +1242,13 @@ void comm_slave_pack_data(iput_t &input, mat<double> &obs, mat<double> &pars, ma
 
   
   /* --- Send data to master --- */
-  
-  status = MPI_Send(&buffer[0], input.buffer_size1, MPI_PACKED, 0, 3, MPI_COMM_WORLD);
 
-  delete [] buffer;
+  if(q){
+    status = MPI_Isend(&buffer[0], input.buffer_size1, MPI_PACKED, input.parent, 3, MPI_COMM_WORLD, &q->sreq);
+  }else{
+    status = MPI_Send(&buffer[0], input.buffer_size1, MPI_PACKED, input.parent, 3, MPI_COMM_WORLD);
+    delete [] buffer;
+  }
 
 }
 
@@ -1071,9 +1263,10 @@ void comm_kill_slaves(iput_t &input, int nprocs){
   // Pack kill command
   int status = MPI_Pack(&action, 1,     MPI_INT, &buffer[0], input.buffer_size, &pos, MPI_COMM_WORLD);
   
-  // Send kill command to slaves
-  for(int ss = 1; ss<nprocs; ss++) status = MPI_Send(&buffer[0], input.buffer_size, MPI_PACKED, ss, 1, MPI_COMM_WORLD);
+  // Send kill command to slaves (or sub-masters, that pass it on)
+  for(auto &ss: input.children) status = MPI_Send(&buffer[0], input.buffer_size, MPI_PACKED, ss, 1, MPI_COMM_WORLD);
 
+  if(input.parent >= 0) return;
   cout << " "<<endl;
   cout << input.myid << inam << "Killing slaves" << endl;
 }
@@ -1088,3 +1281,96 @@ void comm_send_weights(iput_t &input, mat<double> &w){
 
   
 }
+
+int comm_init_hierarchy(iput_t &input, iput_t *up)
+{
+  int const myrank = input.myrank, nprocs = input.nprocs;
+  
+  
+  /* --- Flat master/slave scheme by default --- */
+  
+  input.parent = (myrank == 0) ? -1 : 0;
+  input.children.clear();
+  if(myrank == 0)
+    for(int ss=1; ss<nprocs; ss++) input.children.push_back(ss);
+
+  if(input.submasters <= 0 || nprocs < 3) return (myrank == 0) ? 0 : 2;
+  
+
+  /* --- Group ranks by node, the lowest rank in each node (other than the
+     master) becomes the sub-master of the rest --- */
+  
+  MPI_Comm node;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, myrank, MPI_INFO_NULL, &node);
+
+  int nnode = 0;
+  MPI_Comm_size(node, &nnode);
+  std::vector<int> ranks(nnode, 0);
+  MPI_Allgather((void*)&myrank, 1, MPI_INT, &ranks[0], 1, MPI_INT, node);
+  MPI_Comm_free(&node);
+
+  std::vector<int> local;
+  for(auto &it: ranks) if(it != 0) local.push_back(it);
+  std::sort(local.begin(), local.end());
+  
+  int const sub = (local.size() > 0) ? local[0] : -1; // rank 0 can be alone in its node
+  int const nslaves = max(int(local.size()) - 1, 0);
+
+  
+  /* --- Only worth it if we get 2+ sub-masters with 1+ slaves each --- */
+  
+  int nmin = (myrank == 0) ? nprocs : nslaves, nmax = 0;
+  int issub = (myrank == sub) ? 1 : 0, nsub = 0;
+  MPI_Allreduce(MPI_IN_PLACE, &nmin, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(&nslaves, &nmax, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(&issub, &nsub, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+  if(nmin < 1 || nsub < 2){
+    if(myrank == 0)
+      fprintf(stderr, "comm_init_hierarchy: WARNING, sub-masters need 2+ nodes with 2+ slave ranks each, using a flat scheme\n");
+    return (myrank == 0) ? 0 : 2;
+  }
+  
+  std::vector<int> subs(nprocs, 0);
+  MPI_Allgather(&issub, 1, MPI_INT, &subs[0], 1, MPI_INT, MPI_COMM_WORLD);
+
+
+  /* --- Blocks of pixels sent to each sub-master and their buffer sizes --- */
+  
+  int const nblock = (input.block > 0) ? input.block : 2*input.npack*nmax;
+  unsigned long bsize[2] = {0, 0};
+  
+  if(myrank == 0){
+    iput_t tmp = input;
+    tmp.npack = nblock;
+    comm_get_buffer_size(tmp);
+    bsize[0] = tmp.buffer_size, bsize[1] = tmp.buffer_size1;
+  }
+  MPI_Bcast(&bsize[0], 2, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+
+  
+  if(myrank == 0){
+    input.children.clear();
+    for(int ss=1; ss<nprocs; ss++) if(subs[ss]) input.children.push_back(ss);
+    input.npack = nblock;
+    input.buffer_size = bsize[0], input.buffer_size1 = bsize[1];
+
+    if(input.verbose)
+      fprintf(stderr, "comm_init_hierarchy: %d sub-masters, %d pixels per block\n", nsub, nblock);
+    return 0;
+  }
+
+  if(myrank == sub){
+    input.children.assign(local.begin()+1, local.end());
+    if(up){
+      *up = input;
+      up->children.clear();
+      up->npack = nblock;
+      up->buffer_size = bsize[0], up->buffer_size1 = bsize[1];
+    }
+    return 1;
+  }
+
+  input.parent = sub;
+  return 2;
+}
@@ -19,21 +19,50 @@ inline void comm_get_xy(const int t, const int nx, int &y, int &x){
   x = t - (y*nx); 
 }
 //
+/* --- 
+   Ring of pre-posted receives used by a slave to keep packages queued
+   (mpi_prefetch > 0). Packages are consumed in the order they were sent.
+   --- */
+struct comm_queue{
+  int nbuf, head;
+  std::vector<std::vector<char>> rbuf;
+  std::vector<MPI_Request> rreq;
+  std::vector<char> sbuf;
+  MPI_Request sreq;
+};
+typedef comm_queue comm_queue_t;
+//
 void comm_get_buffer_size(iput_t &input);
 void comm_send_parameters(iput_t &input);
 void comm_recv_parameters(iput_t &input);
 void comm_master_pack_data(iput_t &input, mat<double> &obs, mat<double> &model, 
-			   unsigned long &ipix, int proc, mdepthall_t &m, int cgrad, int action = 1);
+			   unsigned long &ipix, int proc, mdepthall_t &m, int cgrad, int action = 1, int npack = -1);
 //void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, 
 //			     mat<double> &pars, mat<double> &chi2);
-void comm_master_unpack_data(int &iproc, iput_t input, mat<double> &obs, 
+void comm_master_unpack_data(int &iproc, iput_t &input, mat<double> &obs, 
 			     mat<double> &pars, mat<double> &chi2, unsigned long &irec,
-			     mat<double> &dobs, int cgrad, mdepthall_t &m);
+			     mat<double> &dobs, int cgrad, mdepthall_t &m, mat<double> *ptime = NULL);
+
+void comm_master_wait_sends();
+void comm_master_init_recv(iput_t &input);
+void comm_master_free_recv();
+double comm_master_recv_time();
 
-void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<double> &pars, std::vector<mdepth_t> &m, int &cgrad);
+void comm_slave_init_queue(iput_t &input, comm_queue_t &q);
+void comm_slave_free_queue(comm_queue_t &q);
+void comm_slave_unpack_data(iput_t &input, int &action, mat<double> &obs, mat<double> &pars, std::vector<mdepth_t> &m, int &cgrad, comm_queue_t *q = NULL);
 void comm_kill_slaves(iput_t &input, int nprocs);
-void comm_slave_pack_data(iput_t &input, mat<double> &obs, mat<double> &pars, mat<double> &dobs, int cgrad, std::vector<mdepth_t> &m); 
+void comm_slave_pack_data(iput_t &input, mat<double> &obs, mat<double> &pars, mat<double> &dobs, int cgrad, std::vector<mdepth_t> &m, comm_queue_t *q = NULL); 
 void comm_send_weights(iput_t &input, mat<double> &w);
 int getNinstrumentData(std::vector<region_t> const &reg);
+bool comm_pixel_instruments(iput_t const &input);
+
+/* --- 
+   Sets the parent/children ranks of this process. With mpi_submasters > 0,
+   rank 0 sends blocks of pixels to one sub-master per node (MPI_COMM_TYPE_SHARED)
+   that distributes them over the slaves of the node. The sub-master gets its
+   settings towards rank 0 in "up". Returns 0 (master), 1 (sub-master), 2 (slave).
+   --- */
+int comm_init_hierarchy(iput_t &input, iput_t *up = NULL);
 
 #endif /* COMM_H */ 
@@ -204,6 +204,9 @@ crh::crh(iput_t &inpt, double grav): atmos(inpt, grav){
 
   /* --- Init saved pop --- */
   memset(&save_pop, 0, sizeof(crhpop));
+  memset(&last_pop, 0, sizeof(crhpop));
+  last_conv = false;
+  ctx = rh_new_context();
   //save_pop.pop = NULL;
   //save_pop.nactive = 0;
 
@@ -229,9 +232,9 @@ crh::crh(iput_t &inpt, double grav): atmos(inpt, grav){
 
 /* ----------------------------------------------------------------*/
 
-bool crh::synth(mdepth_t &m_in, double *syn, int computing_derivatives, cprof_solver sol, bool save_pops){
+bool crh::synth(mdepth_t &m_in, double *syn, int computing_derivatives, cprof_solver sol, bool save_pops, double iter_scale){
 
-  static int ncall = 0, npix = 0;
+  static thread_local int ncall = 0, npix = 0;
   ncall++;
 
   /* --- Copy model, RH seems to tamper with the model --- */
@@ -305,6 +308,13 @@ bool crh::synth(mdepth_t &m_in, double *syn, int computing_derivatives, cprof_so
 
   int savep = 0, hydrostat = 0;
   if(save_pops) savep = 1;
+
+
+  /* --- Start from the solution of the previous pixel if we have
+     nothing better, RH interpolates it to the new tau_ref scale --- */
+
+  if(input.warm_start && (save_pop.nactive == 0) && (last_pop.nactive > 0))
+    std::swap(save_pop, last_pop);
   
   
   /* --- Call RH --- */
@@ -312,7 +322,9 @@ bool crh::synth(mdepth_t &m_in, double *syn, int computing_derivatives, cprof_so
   bool conv = rhf1d(input.mu, m.ndep, &m.temp[0], &m.rho[0], &m.nne[0], &m.vturb[0], &m.v[0],
 		     &B[0], &inc[0], &m.azi[0], &m.z[0], &nhtot[0], &m.tau[0],
 		    &m.cmass[0], 4.44, (bool_t)true, &sp, &save_pop, nlambda, &lambda[0],
-		    input.myrank, savep, (int)input.verbose, &hydrostat, computing_derivatives);
+		    input.myrank, savep, (int)input.verbose, &hydrostat, computing_derivatives,
+		    iter_scale, ctx);
+  last_conv = conv;
   
   delete [] B;
   delete [] inc;
@@ -388,13 +400,27 @@ bool crh::synth(mdepth_t &m_in, double *syn, int computing_derivatives, cprof_so
 /* ----------------------------------------------------------------*/
 
 void crh::cleanup(void){
-  clean_saved_populations(&save_pop);
+
+  /* --- With warm_start the last converged solution is kept to
+     initialize the next pixel, unless the last solution failed --- */
+  
+  if(input.warm_start && last_conv){
+    if(save_pop.nactive > 0){
+      clean_saved_populations(&last_pop);
+      std::swap(save_pop, last_pop);
+    }
+  }else{
+    clean_saved_populations(&last_pop);
+    clean_saved_populations(&save_pop);
+  }
 }
 
 /* ----------------------------------------------------------------*/
 
 crh::~crh(void){
-  cleanup();
+  clean_saved_populations(&save_pop);
+  clean_saved_populations(&last_pop);
+  rh_free_context(ctx);
 }
 
 /* ----------------------------------------------------------------*/
@@ -24,13 +24,16 @@ class crh: public atmos{
   int nlambda, nlines, nregions;
   std::vector<double> lambda, cmass, nhtot;
   crhpop save_pop;
+  crhpop last_pop; // last converged solution of the previous pixel (warm_start)
+  bool last_conv;  // did the last call to synth converge?
+  rhcontext *ctx; // state of our own instance of RH
   
   /* --- Prototypes --- */
   std::vector<double> get_max_limits(nodes_t &n, int mode =1);
   std::vector<double> get_min_limits(nodes_t &n, int mode = 1);
   std::vector<double> get_scaling(nodes_t &n, int mode =1);
   std::vector<double> get_steps(nodes_t &n, int mode = 1);
-  bool synth(mdepth &m, double *syn, int computing_derivatives = 0, cprof_solver sol = bez_ltau, bool store_pops = true);
+  bool synth(mdepth &m, double *syn, int computing_derivatives = 0, cprof_solver sol = bez_ltau, bool store_pops = true, double iter_scale = 1.0);
   void cleanup();
   void lambdaIDX(int nw, double *lambda);
   void checkBounds(mdepth_t &m);
@@ -40,6 +43,10 @@ class crh: public atmos{
   /* --- Contructor / Destructor --- */
   crh(iput_t &iput, double grav = 4.44);
   ~crh();
+
+  /* --- ctx is owned by this instance, it cannot be copied --- */
+  crh(const crh &) = delete;
+  crh &operator=(const crh &) = delete;
   
 
   
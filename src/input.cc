@@ -92,6 +92,8 @@ iput_t read_input(std::string filename, bool verbose){
   memset(&input.nodes.toinv[0],0, 7*sizeof(int));
   input.solver = 0;
   input.centder = 0;
+  input.fixed_pops = 0;
+  input.inexact_nlte = 1.0;
   input.init_step = -1.0;
   input.thydro = 1;
   input.nodes.nnodes = 0;
@@ -117,6 +119,14 @@ iput_t read_input(std::string filename, bool verbose){
   input.use_eos = 1;
   input.inv_depth_opt = 0;
   input.nresp = 0;
+  input.prefetch = 0;
+  input.schedule = 0;
+  input.npack_min = 1;
+  input.pix_order = 0;
+  input.submasters = 0;
+  input.block = 0;
+  input.slave_threads = 1;
+  input.warm_start = 0;
   
   // Open File and read
   std::ifstream in(filename, std::ios::in | std::ios::binary);
@@ -186,6 +196,30 @@ iput_t read_input(std::string filename, bool verbose){
 	input.npack = atoi(field.c_str());
 	set = true;
       }
+      else if(key == "mpi_schedule"){
+	input.schedule = atoi(field.c_str());
+	set = true;
+      }
+      else if(key == "mpi_pack_min"){
+	input.npack_min = atoi(field.c_str());
+	set = true;
+      }
+      else if(key == "mpi_submasters"){
+	input.submasters = atoi(field.c_str());
+	set = true;
+      }
+      else if(key == "mpi_block"){
+	input.block = atoi(field.c_str());
+	set = true;
+      }
+      else if(key == "mpi_order"){
+	input.pix_order = atoi(field.c_str());
+	set = true;
+      }
+      else if(key == "mpi_prefetch"){
+	input.prefetch = atoi(field.c_str());
+	set = true;
+      }
       else if(key == "use_geo_accel"){
 	input.use_geo_accel = atoi(field.c_str());
 	set = true;
@@ -202,6 +236,18 @@ iput_t read_input(std::string filename, bool verbose){
 	input.centder = atoi(field.c_str());
 	set = true;
       }
+      else if(key == "fixed_pop_derivatives"){
+	input.fixed_pops = atoi(field.c_str());
+	set = true;
+      }
+      else if(key == "warm_start"){
+	input.warm_start = atoi(field.c_str());
+	set = true;
+      }
+      else if(key == "inexact_nlte"){
+	input.inexact_nlte = atof(field.c_str());
+	set = true;
+      }
       else if(key == "recompute_hydro"){
 	input.thydro = atoi(field.c_str());
 	set = true;
@@ -298,6 +344,10 @@ iput_t read_input(std::string filename, bool verbose){
 	input.max_inv_iter = atoi(field.c_str());
 	set = true;
       }
+      else if(key == "slave_threads"){
+	input.slave_threads = atoi(field.c_str());
+	set = true;
+      }
       else if(key == "master_threads"){
 	input.master_threads = atoi(field.c_str());
 	set = true;
@@ -70,14 +70,16 @@ typedef nodes nodes_t;
 struct iput{
   unsigned long buffer_size, buffer_size1;
   int nt, ny, nx, ns, npar, npack, mode, nInv, inst_len, atmos_len, ab_len,
-    nw_tot, boundary, ndep, solver, centder, thydro, dint, keep_nne, svd_split, random_first, depth_model,
-    use_geo_accel, nresp, getResponse[8], delay_bracket, vgrad, verbose, use_eos, inv_depth_opt, eos_type;
-  double mu, chi2_thres, sparse_threshold, dpar, init_step, marquardt_damping, svd_thres,  tcut;
+    nw_tot, boundary, ndep, solver, centder, fixed_pops, thydro, dint, keep_nne, svd_split, random_first, depth_model,
+    use_geo_accel, nresp, getResponse[8], delay_bracket, vgrad, verbose, use_eos, inv_depth_opt, eos_type, prefetch, schedule, npack_min, pix_order, submasters, block, slave_threads, warm_start;
+  double mu, chi2_thres, sparse_threshold, dpar, init_step, marquardt_damping, svd_thres,  tcut, inexact_nlte;
   std::string imodel, omodel, iprof, oprof, myid, instrument,
     atmos_type, wavelet_type, oatmos, abfile;
   int xx, yy, ipix, nPacked;
-  std::vector<double> chi;
-  int myrank, nprocs, cgrad;
+  std::vector<double> chi, ptime;
+  std::vector<int> pixels, order; // pixels in the current package, dispatch order (master)
+  std::vector<int> children; // ranks we send work to
+  int myrank, nprocs, cgrad, parent;
   unsigned max_inv_iter, master_threads, wavelet_order;
   std::vector<unsigned long> ntosend;
   std::vector<std::string> ilines;
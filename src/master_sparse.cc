@@ -1,5 +1,8 @@
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
 #include <netcdf>
 #include <omp.h>
 #include "io.h"
@@ -37,59 +40,209 @@ void read_instruments(iput_t &iput)
 }
 
 
+/* --- Guided self-scheduling: give each package roughly 1/(2*nslaves) of
+   the predicted work that is left, so packages are large at the beginning
+   (few messages) and small at the end (no long tail). cost holds the
+   cumulative predicted cost, cost[i] = sum of pixels [0,i) --- */
+
+static int guidedPackage(iput_t const& iput, std::vector<double> const& cost,
+			 unsigned long ipix, int nslaves)
+{
+  double const target = (cost.back() - cost[ipix]) / (2.0*nslaves);
+  
+  unsigned long end = std::upper_bound(cost.begin()+ipix+1, cost.end(), cost[ipix]+target) - cost.begin();
+  int npack = int(end - ipix);
+  
+  return max(min(npack, iput.npack), max(iput.npack_min,1));
+}
+
+
+/* --- Cheap prediction of the cost of each pixel: the wall time measured in
+   the previous time-step if available. Otherwise, when inverting, the
+   continuum contrast: umbrae and flare kernels are the pixels that deviate
+   from the mean and tend to need more iterations. Uniform in any other case --- */
+
+static void predictCost(iput_t const& iput, mat<double> const& obs, mat<double> const& ptime,
+			unsigned long ntot, std::vector<double> &pc)
+{
+  pc.assign(ntot, 1.0);
+  
+  if(ptime.d.size() == ntot){
+    for(unsigned long ii=0; ii<ntot; ii++) pc[ii] = max(ptime.d[ii], 1.e-6);
+    return;
+  }
+
+  if(iput.mode != 1 || obs.d.size() != ntot*iput.nw_tot*iput.ns) return;
+
+  
+  /* --- Continuum proxy: maximum of Stokes I in each pixel --- */
+  
+  double mean = 0.0;
+  for(unsigned long ii=0; ii<ntot; ii++){
+    double const* I = &obs.d[ii*iput.nw_tot*iput.ns];
+    double ic = 0.0;
+    for(int ww=0; ww<iput.nw_tot; ww++) ic = max(ic, I[ww*iput.ns]);
+    pc[ii] = ic, mean += ic;
+  }
+  mean /= ntot;
+  if(mean <= 0.0) { pc.assign(ntot, 1.0); return;}
+  
+  for(auto &it: pc) it = 1.0 + fabs(it/mean - 1.0);
+}
+
+
+/* --- Locality-preserving traversal of the ny x nx raster: boustrophedon
+   (type 2) or Hilbert curve (type 3). Consecutive pixels are spatial
+   neighbours, so a slave that keeps the NLTE solution of its previous
+   pixel (warm_start) starts close to the new one --- */
+
+static void localOrder(int ny, int nx, int type, std::vector<int> &order)
+{
+  order.clear();
+  order.reserve((size_t)nx*ny);
+  
+  if(type == 2){
+    for(int yy=0; yy<ny; yy++)
+      for(int xx=0; xx<nx; xx++) order.push_back(yy*nx + ((yy%2) ? nx-1-xx : xx));
+    return;
+  }
+
+  
+  /* --- Hilbert curve on the smallest power of 2 that covers the raster,
+     skipping the points that fall outside --- */
+  
+  long n = 1;
+  while(n < max(nx,ny)) n <<= 1;
+  
+  for(long d=0; d<n*n; d++){
+    long x = 0, y = 0, t = d;
+    for(long s=1; s<n; s<<=1){
+      long const rx = 1 & (t/2), ry = 1 & (t ^ rx);
+      if(ry == 0){
+	if(rx == 1) x = s-1-x, y = s-1-y;
+	std::swap(x, y);
+      }
+      x += s*rx, y += s*ry;
+      t /= 4;
+    }
+    if(x < nx && y < ny) order.push_back(int(y*nx + x));
+  }
+}
+
 //
-void slaveInversion(iput_t &iput, mdepthall_t &m, mat<double> &obs, mat<double> &x, mat<double> &chi2, mat<double> &dsyn){
+void slaveInversion(iput_t &iput, mdepthall_t &m, mat<double> &obs, mat<double> &x, mat<double> &chi2, mat<double> &dsyn, mat<double> &ptime){
 
   /* --- Init dimensions --- */
   unsigned long ntot = (unsigned long)(x.size(0) * x.size(1));
   int ncom = (int)(std::floor(ntot / (double)iput.npack));
   if((unsigned long)(ncom * iput.npack) != ntot) ncom++;
-  int nprocs = iput.nprocs;
+  int nchild = (int)iput.children.size(); // slaves, or sub-masters
+  bool const top = (iput.parent < 0);    // rank 0 prints the progress
   int iproc = 0;
   unsigned long ipix = 0;
   int tocom = ncom;
 
   int compute_gradient = 0; // dummy parameter here
   chi2.set({x.size(0), x.size(1)});
+
+
+  /* --- Predicted cost per pixel for guided scheduling and ordering --- */
+
+  bool const guided = (iput.schedule == 1), ordered = (iput.pix_order >= 1);
+  std::vector<double> pc, cost;
+  iput.order.clear();
   
+  if(guided || iput.pix_order == 1) predictCost(iput, obs, ptime, ntot, pc);
+  if(ptime.d.size() != ntot) ptime.set({x.size(0), x.size(1)});
 
-  if(nprocs > 1){
+  
+  /* --- Dispatch the most expensive pixels first (mpi_order = 1) or along
+     a path of neighbouring pixels (2, 3). The slaves return the location
+     of each pixel so results do not depend on this order --- */
+  
+  if(iput.pix_order == 1){
+    iput.order.resize(ntot);
+    std::iota(iput.order.begin(), iput.order.end(), 0);
+    std::stable_sort(iput.order.begin(), iput.order.end(),
+		     [&pc](int a, int b){return pc[a] > pc[b];});
+  }else if(ordered) localOrder(x.size(0), x.size(1), iput.pix_order, iput.order);
+  
+  if(guided){
+    cost.resize(ntot+1, 0.0);
+    for(unsigned long ii=0; ii<ntot; ii++)
+      cost[ii+1] = cost[ii] + pc[(ordered) ? iput.order[ii] : ii];
+  }
+  int const nslaves = max(nchild, 1);
+  
+
+  if(nchild > 0){
 
   
-    /* --- Init slaves with first package --- */
-    for(int ss = 1; ss<=min(nprocs-1,ncom); ss++)
-      comm_master_pack_data(iput, obs, x, ipix, ss, m, compute_gradient);
+    /* --- Pre-post one receive per slave --- */
+
+    comm_master_init_recv(iput);
+    
+    
+    /* --- Init slaves with first package and queue mpi_prefetch more
+       so they can start the next one without waiting for us --- */
+    
+    int const ndepth = 1 + max(iput.prefetch, 0);
+    for(int dd = 0; dd<ndepth; dd++)
+      for(int ss = 0; ss<min(nchild,(guided)?nslaves:ncom); ss++)
+	if(ipix < ntot) comm_master_pack_data(iput, obs, x, ipix, iput.children[ss], m, compute_gradient, 1,
+					      (guided) ? guidedPackage(iput, cost, ipix, nslaves) : -1);
 
     int per  = 0;
     int oper  = -1;
     float pno =  100.0 / (float(ntot) - 1.0);
     unsigned long irec = 0;
-    cerr << "\rProcessed -> "<<per<<"% ";
+    double tdis = 0.0, tdismax = 0.0;
+    long ndis = 0;
+    if(top) cerr << "\rProcessed -> "<<per<<"% ";
 
 
     /* --- manage packages as long as needed --- */
     while(irec < ntot){
     
       // Receive processed data from any slave (iproc)
-      comm_master_unpack_data(iproc, iput, obs, x, chi2, irec, dsyn, compute_gradient, m);
+      comm_master_unpack_data(iproc, iput, obs, x, chi2, irec, dsyn, compute_gradient, m, &ptime);
       per = irec * pno;
       //cerr << ipix << " " << irec<<" "<<ntot << endl;
       // Send more data to that same slave (iproc)
-      if(ipix < ntot) comm_master_pack_data(iput, obs, x, ipix, iproc, m, compute_gradient);
+      if(ipix < ntot){
+	comm_master_pack_data(iput, obs, x, ipix, iproc, m, compute_gradient, 1,
+			      (guided) ? guidedPackage(iput, cost, ipix, nslaves) : -1);
+
+	// Dispatch latency: from message arrival until the new package has left
+	double dt = MPI_Wtime() - comm_master_recv_time();
+	tdis += dt, ndis++;
+	tdismax = max(tdismax, dt);
+      }
     
       // Keep count of communications left
       tocom--;
     
       // Printout
-      if(per > oper){
+      if(top && per > oper){
 	oper = per;
 	cerr << "\rProcessed -> "<<per<<"% ";
       }
     }
   
-    cerr << " "<<endl;
+    if(top) cerr << " "<<endl;
 
+    if(top && iput.verbose && ndis > 0)
+      fprintf(stderr,"slaveInversion: dispatch latency, mean=%.2f us, max=%.2f us (%ld packages)\n",
+	      tdis*1.e6/ndis, tdismax*1.e6, ndis);
+    
+    
+    /* --- Make sure all queued packages have left --- */
+    
+    comm_master_wait_sends();
+    comm_master_free_recv();
   }
+
+  iput.order.clear();
   
 }
 
@@ -345,12 +498,21 @@ void do_master_sparse(int myrank, int nprocs,  char hostname[]){
     input.npack = (int)((double)(input.ny*input.nx) / nprocs) + 1;
     if(input.verbose) cerr<<input.myid<<"Using NPACK="<<input.npack<<endl;
   }
+
+  
+  /* --- Packages only carry the instrumental profiles of their first pixel --- */
+  
+  if(comm_pixel_instruments(input) && (input.npack != 1 || input.submasters > 0)){
+    cerr<<input.myid<<"WARNING, the instrumental profiles change from pixel to pixel, using NPACK=1 and no sub-masters"<<endl;
+    input.npack = 1, input.npack_min = 1, input.submasters = 0;
+  }
   
   comm_get_buffer_size(input);
   MPI_Barrier(MPI_COMM_WORLD); // Wait until all processors reach this point
   comm_send_parameters(input);
   
   if(inversion) comm_send_weights(input, w); //  
+  comm_init_hierarchy(input); // npack becomes the block size with sub-masters
 
   
   
@@ -366,6 +528,8 @@ void do_master_sparse(int myrank, int nprocs,  char hostname[]){
   //
   // Main loop
   //
+  mat<double> ptime; // wall time per pixel, predicts the cost of the next time-step
+  
   for(int tt = 0; tt<input.nt; tt++){ // Loop in time
 
     /* --- Read Tstep data --- */
@@ -415,11 +579,11 @@ void do_master_sparse(int myrank, int nprocs,  char hostname[]){
       if(nprocs == 1)
 	master_inverter(im, model, obs, w, input);
       else
-	slaveInversion(input, im, obs, model, chi2, dobs); // implemented above!
+	slaveInversion(input, im, obs, model, chi2, dobs, ptime); // implemented above!
       
-    }else if(input.mode == 2) slaveInversion(input, im, obs, model, chi2, dobs); // it won't invert if mode == 2
+    }else if(input.mode == 2) slaveInversion(input, im, obs, model, chi2, dobs, ptime); // it won't invert if mode == 2
     //else if(input.mode == 3) inv.SparseOptimization(obs, model, w, im, pweight);
-    else if(input.mode == 4) slaveInversion(input, im, obs, model, chi2, dobs);
+    else if(input.mode == 4) slaveInversion(input, im, obs, model, chi2, dobs, ptime);
     
     if(inversion){
 
@@ -6,6 +6,6 @@
 #include "cmemt.h"
 //
 void do_master_sparse(int myrank, int nprocs,  char hostname[]);
-void slaveInversion(iput_t &input, mdepthall_t &m, mat<double> &obs, mat<double> &pars, mat<double> &chi2);
+void slaveInversion(iput_t &input, mdepthall_t &m, mat<double> &obs, mat<double> &pars, mat<double> &chi2, mat<double> &dsyn, mat<double> &ptime);
 
 #endif
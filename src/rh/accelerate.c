@@ -11,11 +11,19 @@
   See: K. C. Ng 1974, J. Chem. Phys. 61, 2680
  Also: L. Auer 1987, in "Numerical Radiative Transfer",
          ed. W. Kalkofen, pp. 101-109
+
+       and Anderson mixing with a history of Norder iterations, applied
+       in every iteration after Ndelay, with restart when the residual
+       grows.
+
+  See: D. G. Anderson 1965, J. ACM 12, 547
+ Also: H. F. Walker & P. Ni 2011, SIAM J. Numer. Anal. 49, 1715
        --                                              -------------- */
 
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "rh.h"
 #include "accelerate.h"
@@ -29,20 +37,13 @@
 
 /* --- Global variables --                             -------------- */
 
-extern MPI_t mpi;
+extern RH_TLS MPI_t mpi;
 
 
-/* ------- begin -------------------------- NgInit.c ---------------- */
+/* ------- begin -------------------------- allocNg.c --------------- */
 
-struct Ng* NgInit(int N, int Ndelay, int Norder, int Nperiod,
-		  double *solution)
+static struct Ng* allocNg(int N, int Ndelay, int Norder, int Nperiod)
 {
-  /* --- Initialize data structure and allocate space for previous
-         solutions, coefficient matrix A and correction vector b,
-         copy initial solution into previous solution matrix -- ----- */
-
-  register int k;
-
   struct Ng *Ngs;
 
   Ngs = (struct Ng*) malloc(sizeof(struct Ng));
@@ -58,14 +59,71 @@ struct Ng* NgInit(int N, int Ndelay, int Norder, int Nperiod,
   }
   Ngs->previous   = matrix_double(Norder + 2, N);
   Ngs->theStorage = Ngs->previous[0];
+  Ngs->count = 1;
+
+  Ngs->method   = NG_ACCELERATION;
+  Ngs->N1       = N;
+  Ngs->Nhistory = 0;
+  Ngs->Nrestart = 0;
+  Ngs->dF = Ngs->dG = NULL;
+  Ngs->f  = Ngs->g  = NULL;
+  Ngs->fnorm = 0.0;
+
+  return Ngs;
+}
+/* ------- end ---------------------------- allocNg.c --------------- */
+
+/* ------- begin -------------------------- NgInit.c ---------------- */
+
+struct Ng* NgInit(int N, int Ndelay, int Norder, int Nperiod,
+		  double *solution)
+{
+  /* --- Initialize data structure and allocate space for previous
+         solutions, coefficient matrix A and correction vector b,
+         copy initial solution into previous solution matrix -- ----- */
+
+  register int k;
+
+  struct Ng *Ngs;
+
+  Ngs = allocNg(N, Ndelay, Norder, Nperiod);
   for (k = 0;  k < N;  k++)
     Ngs->previous[0][k] = solution[k];
-  Ngs->count = 1;
 
   return Ngs;
 }
 /* ------- end ---------------------------- NgInit.c ---------------- */
 
+/* ------- begin -------------------------- AndersonInit.c ---------- */
+
+struct Ng* AndersonInit(int N1, int N2, int Ndelay, int Norder,
+			double *solution1, double *solution2)
+{
+  /* --- Same as NgInit, for Anderson mixing of the concatenation of
+         solution1 (N1 elements) and solution2 (N2 elements, may be
+         NULL when N2 = 0) --                          -------------- */
+
+  struct Ng *Ngs;
+
+  Ngs = allocNg(N1 + N2, Ndelay, Norder, 1);
+  Ngs->method = ANDERSON;
+  Ngs->N1     = N1;
+
+  if (Norder > 0) {
+    Ngs->dF = matrix_double(Norder, Ngs->N);
+    Ngs->dG = matrix_double(Norder, Ngs->N);
+  }
+  Ngs->f = (double *) malloc(Ngs->N * sizeof(double));
+  Ngs->g = (double *) malloc(Ngs->N * sizeof(double));
+
+  memcpy(Ngs->previous[0], solution1, N1 * sizeof(double));
+  if (N2 > 0)
+    memcpy(Ngs->previous[0] + N1, solution2, N2 * sizeof(double));
+
+  return Ngs;
+}
+/* ------- end ---------------------------- AndersonInit.c ---------- */
+
 /* ------- begin -------------------------- Accelerate.c ------------ */
 
 bool_t Accelerate(struct Ng *Ngs, double *solution)
@@ -75,6 +133,9 @@ bool_t Accelerate(struct Ng *Ngs, double *solution)
   int      Norder = Ngs->Norder, ip, ipp, i0;
   double **Delta, *weight;
 
+  if (Ngs->method == ANDERSON)
+    return AccelerateCoupled(Ngs, solution, NULL);
+
   /* --- Store the current solution --                --------------- */
 
   i = Ngs->count % (Norder + 2);
@@ -154,6 +215,118 @@ bool_t Accelerate(struct Ng *Ngs, double *solution)
 }
 /* ------- end ---------------------------- Accelerate.c ------------ */
 
+/* ------- begin -------------------------- AccelerateCoupled.c ----- */
+
+bool_t AccelerateCoupled(struct Ng *Ngs, double *solution1,
+			 double *solution2)
+{
+  register int i, j, k;
+
+  bool_t   accelerated = FALSE;
+  int      N = Ngs->N, N1 = Ngs->N1, Norder = Ngs->Norder, Nh, slot;
+  double  *x, *g, *xnew, f, fnorm, diagonal;
+
+  /* --- Anderson mixing (type II) of the fixed-point iteration
+         g = G(x). With residuals f = (g - x) / |g| and the differences
+         dF and dG of the last Nh residuals and iterates the new
+         iterate is g - dG gamma, where gamma minimizes
+         |f - dF gamma|. --                            -------------- */
+
+  /* --- Store the current solution. Without solution2 the second
+         part is kept at its previous value --         -------------- */
+
+  x = Ngs->previous[(Ngs->count - 1) % (Norder + 2)];
+  g = Ngs->previous[Ngs->count % (Norder + 2)];
+  memcpy(g, solution1, N1 * sizeof(double));
+  if (N > N1)
+    memcpy(g + N1, (solution2) ? solution2 : x + N1,
+	   (N - N1) * sizeof(double));
+  (Ngs->count)++;
+
+  if (Norder <= 0) return FALSE;
+  getCPU(4, TIME_START, NULL);
+
+  /* --- Update the history with the new residual, or discard it
+         when the residual grew too much --            -------------- */
+
+  fnorm = 0.0;
+  for (k = 0;  k < N;  k++) {
+    f = (g[k] != 0.0) ? (g[k] - x[k]) / fabs(g[k]) : 0.0;
+    fnorm += SQ(f);
+    if (Ngs->count > 2) {
+      slot = Ngs->Nhistory % Norder;
+      Ngs->dF[slot][k] = f - Ngs->f[k];
+      Ngs->dG[slot][k] = g[k] - Ngs->g[k];
+    }
+    Ngs->f[k] = f;
+    Ngs->g[k] = g[k];
+  }
+  fnorm = sqrt(fnorm);
+
+  if (Ngs->count > 2) {
+    if (fnorm > ANDERSON_RESTART * Ngs->fnorm && Ngs->Nhistory > 0) {
+      Ngs->Nhistory = 0;
+      Ngs->Nrestart++;
+    } else
+      Ngs->Nhistory++;
+  }
+  Ngs->fnorm = fnorm;
+
+  if (Ngs->count >= Ngs->Ndelay && Ngs->Nhistory > 0) {
+    Nh = MIN(Ngs->Nhistory, Norder);
+
+    /* --- Normal equations for gamma, slightly regularized -- ----- */
+
+    for (i = 0;  i < Nh;  i++) {
+      Ngs->b[i] = 0.0;
+      for (k = 0;  k < N;  k++) Ngs->b[i] += Ngs->dF[i][k] * Ngs->f[k];
+      for (j = 0;  j <= i;  j++) {
+	Ngs->A[i][j] = 0.0;
+	for (k = 0;  k < N;  k++)
+	  Ngs->A[i][j] += Ngs->dF[i][k] * Ngs->dF[j][k];
+	Ngs->A[j][i] = Ngs->A[i][j];
+      }
+    }
+    diagonal = 0.0;
+    for (i = 0;  i < Nh;  i++) diagonal = MAX(diagonal, Ngs->A[i][i]);
+    for (i = 0;  i < Nh;  i++) Ngs->A[i][i] += 1.0E-12 * diagonal;
+
+    mpi.stop = FALSE;
+    if (diagonal > 0.0) SolveLinearEq(Nh, Ngs->A, Ngs->b, TRUE);
+
+    if (diagonal > 0.0 && !mpi.stop) {
+
+      /* --- New iterate, rejected when it is not positive -- ----- */
+
+      xnew = (double *) malloc(N * sizeof(double));
+      for (k = 0;  k < N;  k++) {
+	xnew[k] = g[k];
+	if (k >= N1 && solution2 == NULL) continue;
+	for (i = 0;  i < Nh;  i++) xnew[k] -= Ngs->b[i] * Ngs->dG[i][k];
+	if (xnew[k] <= 0.0 && g[k] > 0.0) break;
+      }
+      if (k == N) {
+	memcpy(g, xnew, N * sizeof(double));
+	memcpy(solution1, g, N1 * sizeof(double));
+	if (N > N1 && solution2)
+	  memcpy(solution2, g + N1, (N - N1) * sizeof(double));
+	accelerated = TRUE;
+      }
+      free(xnew);
+    }
+    mpi.stop = FALSE;
+
+    if (!accelerated) {
+      Ngs->Nhistory = 0;
+      Ngs->Nrestart++;
+    }
+  }
+  getCPU(4, TIME_POLL, "Accelerate");
+
+  return accelerated;
+}
+/* ------- end ---------------------------- AccelerateCoupled.c ----- */
+
 /* ------- begin -------------------------- NgFree.c ---------------- */
 
 void NgFree(struct Ng *Ngs)
@@ -164,6 +337,14 @@ void NgFree(struct Ng *Ngs)
     free(Ngs->b);
     freeMatrix((void **) Ngs->A);
   }
+  if (Ngs->method == ANDERSON) {
+    if (Ngs->Norder > 0) {
+      freeMatrix((void **) Ngs->dF);
+      freeMatrix((void **) Ngs->dG);
+    }
+    free(Ngs->f);
+    free(Ngs->g);
+  }
 
   free(Ngs);
 }
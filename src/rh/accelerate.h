@@ -12,11 +12,24 @@
 
 /* --- Defines structure and prototypes for Ng acceleration -- ------ */
 
+/* --- For Anderson mixing the solution may consist of two arrays of
+       N1 and N - N1 elements (populations and electron density) that
+       are accelerated together. dF and dG keep the last Nhistory
+       differences of residuals and iterates -- ------------------- */
+
 struct Ng {
   int      N, Ndelay, Norder, Nperiod, count;
   double **previous, **A, *b, *theStorage;
+  enum AccelMethod method;
+  int      N1, Nhistory, Nrestart;
+  double **dF, **dG, *f, *g, fnorm;
 };
 
+/* --- An Anderson step is rejected, and the history discarded, when
+       the residual grows by more than this factor -- ------------- */
+
+#define ANDERSON_RESTART  2.0
+
 
 /* --- Associated function prototypes --               -------------- */
 
@@ -24,6 +37,10 @@ bool_t Accelerate(struct Ng *Ngs, double *solution);
 void   NgFree(struct Ng *Ngs);
 struct Ng *NgInit(int N, int Ndelay, int Norder, int Nperiod,
 		  double *solution);
+struct Ng *AndersonInit(int N1, int N2, int Ndelay, int Norder,
+			double *solution1, double *solution2);
+bool_t AccelerateCoupled(struct Ng *Ngs, double *solution1,
+			 double *solution2);
 double MaxChange(struct Ng *Ngs, char *text, bool_t quiet);
 
 
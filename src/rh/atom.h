@@ -46,6 +46,17 @@ typedef struct ZeemanMultiplet ZeemanMultiplet;
 typedef struct rhthread rhthread;
 typedef struct Paschenstruct Paschenstruct;
 
+/* --- In-memory store of PRD redistribution weights. Weights are
+       appended in the order they are computed and read back in the
+       same order. When the store would exceed the memory limit it is
+       spilled to the scratch file fp_GII of the line. -- ----------- */
+
+typedef struct {
+  bool_t single;
+  long   N, Nalloc, pos;
+  void  *data;
+} GIIstore;
+
 /* --- Structure defines radiative transition --       -------------- */
 
 struct AtomicLine {
@@ -57,7 +68,9 @@ struct AtomicLine {
          **psi_Q, **psi_U, **psi_V, *wphi, *Qelast, Grad, cvdWaals[4],
     cStark, qcore, qwing, **rho_prd, *c_shift, *c_fraction, **gII;
   int    **id0, **id1;
+  float   *phi_single;
   FILE    *fp_GII;
+  GIIstore GII;
   double  **frac, rel_change;
   //double dum;
   double **Jgas;
@@ -117,6 +130,7 @@ struct MolTransition {
 
 struct rhthread {
   double **gij, **Vij, **wla, **chi_up, **chi_down, **Uji_down, *eta;
+  double **Gamma, **Rij, **Rji;  // Per-thread accumulators, see solveSpectrum
 };
 
 struct Atom {
@@ -136,6 +150,7 @@ struct Atom {
   pthread_mutex_t Gamma_lock;
   FILE *fp_input;
   char **txt;
+  struct CollData *coll;  // Parsed collisional data and rates (collision.c)
 };
 
 typedef struct {
@@ -164,7 +179,7 @@ struct Molecule {
 typedef struct {
   bool_t polarizable;
   enum vdWaals vdwaals;
-  int    pt_index, stage, isotope, Li, Lj, li, lj;
+  int    pt_index, stage, isotope, Li, Lj, li, lj, list_index, line_index;
   double lambda0, gi, gj, Ei, Ej, Bji, Aji, Bij, Si, Sj,
          Grad, GStark, GvdWaals, hyperfine_frac,
          isotope_frac, gL_i, gL_j, hfs_i, hfs_j, iso_dl,
@@ -200,6 +215,7 @@ void   statEquil(Atom *atom, int isum);
 double updatePopulations(int niter);
 
 void CollisionRate(Atom *atom, char **atomFile);
+void freeCollisions(Atom *atom);
 void Damping(AtomicLine *line, double *adamp);
 void FixedRate(Atom *atom);
 void freeAtom(Atom *atom);
@@ -281,6 +297,7 @@ void   PRDAngleScatter(AtomicLine *PRDline,
 		       enum Interpolation representation);
 void   PRDAngleApproxScatter(AtomicLine *PRDline,
 			     enum Interpolation representation);
+void   freeGIIstore(AtomicLine *line);
 
 
 /* --- Polarization related --                         -------------- */
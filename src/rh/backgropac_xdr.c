@@ -35,9 +35,9 @@ bool_t write_contrib_xdr(XDR *xdrs, char *label, enum opac_type type,
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- backgrOpac.c ------------ */
@@ -129,10 +129,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- Background.c ------------ */
@@ -142,7 +142,7 @@ void Background(bool_t write_analyze_output, bool_t equilibria_only)
   const char routineName[] = "Background";
   register int k, nspect, n, mu, to_obs;
 
-  static int ne_iter = 0;
+  static RH_TLS int ne_iter = 0;
   char    inputLine[MAX_LINE_SIZE];
   bool_t  exit_on_EOF, do_fudge, fromscratch;
   int     backgrrecno, index, Nfudge, NrecStokes;
@@ -197,7 +197,7 @@ void Background(bool_t write_analyze_output, bool_t equilibria_only)
     /* --- Read wavelength-dependent fudge factors to compensate for
            missing UV backround line haze --           -------------- */
 
-    if ((fp_fudge = fopen(input.fudgeData, "r")) == NULL) {
+    if ((fp_fudge = openModelFile(input.fudgeData)) == NULL) {
       sprintf(messageStr, "Unable to open input file %s", input.fudgeData);
       Error(ERROR_LEVEL_2, routineName, messageStr);
     }
@@ -33,6 +33,41 @@ struct Linelist {
   AtomicLine *line;
 };
 
+/* --- One line of a Kurucz line list as read from the file, with the
+       lower level first. The labels are the fixed-width fields of the
+       list and are not NUL terminated. line_index is the position of
+       the line in the list, which orders lines of equal wavelength.
+       Binary line lists (see
+       rlkbinary.c) keep these records sorted by wavelength, with the
+       wavelength of the first line of every block of RLK_BLOCK_SIZE
+       records as index. --                            -------------- */
+
+#define RLK_BINARY_MAGIC    "RHRLKBIN"
+#define RLK_BINARY_VERSION  2
+#define RLK_BLOCK_SIZE      1024
+
+typedef struct {
+  int    pt_index, stage, isotope, hfs_i, hfs_j, gL_i, gL_j, line_index;
+  double lambda0, gf, Ei, Ej, Ji, Jj, Grad, GStark, GvdWaals,
+         isotope_frac, hyperfine_frac;
+  char   labeli[RLK_LABEL_LENGTH], labelj[RLK_LABEL_LENGTH];
+} RLK_Record;
+
+typedef struct {
+  char   magic[8];
+  int    version, record_size, block_size, Nblock;
+  long   Nline;
+} RLK_BinaryHeader;
+
+typedef struct {
+  void   *map;
+  size_t  size;
+  int     Nblock;
+  long    Nline;
+  double *block_lambda;
+  RLK_Record *record;
+} RLK_Binary;
+
 
 /* --- Associated function prototypes --               -------------- */
 
@@ -58,6 +93,7 @@ int writeBackground_j(int la, int mu, bool_t to_obs,
 		      double *chip_c);
 
 void init_Background_j();
+void free_Background_j(void);
 void Background_j(bool_t write_analyze_output, bool_t equilibria_only);
 
   
@@ -68,6 +104,12 @@ void   readKuruczLines(char *fileName);
 int    rlk_ascend(const void *v1, const void *v2);
 void   rlk_locate(int N, RLK_Line *lines, double lambda, int *low);
 
+int    readKuruczRecord(char *inputLine, RLK_Record *rec);
+long   writeKuruczBinary(char *listName, char *binaryName);
+bool_t openKuruczBinary(char *fileName, RLK_Binary *rb);
+void   closeKuruczBinary(RLK_Binary *rb);
+long   locateKuruczBinary(RLK_Binary *rb, double lambda);
+
 bool_t Hminus_bf(double lambda, double *chi, double *eta);
 bool_t Hminus_ff(double lambda, double *chi);
 bool_t Hminus_ff_long(double lambda, double *chi);
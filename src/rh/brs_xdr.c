@@ -30,9 +30,9 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- writeBRS.c -------------- */
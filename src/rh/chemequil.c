@@ -98,10 +98,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input; 
-extern char   messageStr[];
-extern MPI_t mpi;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input; 
+extern RH_TLS char   messageStr[];
+extern RH_TLS MPI_t mpi;
 
 
 /* ------- begin -------------------------- ChemicalEquilibrium.c --- */
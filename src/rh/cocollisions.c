@@ -46,8 +46,8 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- COcollisions.c ---------- */
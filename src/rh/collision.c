@@ -78,8 +78,8 @@ void   rowcol(int i, int *row, int *col);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin ---------------------------rowcol.c ---------------- */
@@ -442,54 +442,132 @@ int atomnr(char ID[ATOM_ID_WIDTH+1])
 }
 /* ------- end ---------------------------- atomnr.c ---------------- */
 
-/* ------- begin -------------------------- CollisionRate.c --------- */
+/* ------- begin -------------------------- readCollisions.c -------- */
+
+/* --- The collisional data of an active atom are parsed only once and
+       kept in atom->coll. The cubic spline of each tabulated
+       transition is set up here as well, so that the rates at a given
+       temperature only take a table lookup.
+
+       The rates of each depth are kept too, together with the values
+       they were computed from (T, ne, the total and the lowest and
+       highest LTE populations of the atom, and the neutral hydrogen
+       and proton densities). They are reused as long as these are
+       bitwise the same, across iterations and calls to rhf1d, as in
+       the velocity and magnetic field perturbations of the response
+       functions. --                                   -------------- */
 
 #define MSHELL 5
+#define N_COLL_KEY 7
+
+enum colltype {COLL_OMEGA, COLL_CE, COLL_CI, COLL_CP, COLL_CH, COLL_CH0,
+	       COLL_CHP, COLL_SHULL82, COLL_BADNELL, COLL_AR85_CDI,
+	       COLL_AR85_CEA, COLL_AR85_CHP, COLL_AR85_CHH, COLL_BURGESS};
+
+typedef struct {
+  enum colltype type;
+  bool_t ascend;
+  int    i, j, Nitem, Nrow, jhunt;
+  double sumscl, *T, *coeff, *M, **table;
+} CollRecord;
+
+struct CollData {
+  bool_t  useH;
+  int     Nrecord, Nspace;
+  bool_t *cached;
+  double *key, **C;
+  CollRecord *record;
+};
+
+static void collSpline(CollRecord *cr)
+{
+  register int j;
 
-void CollisionRate(struct Atom *atom, char **fp_atom)
+  int     N = cr->Nitem;
+  double  p, *q, *u, hj, hj1, D, D1, mu, *x = cr->T, *y = cr->coeff;
+
+  /* --- Second derivatives of the cubic spline, as in splineCoef -- */
+
+  cr->ascend = (x[1] > x[0]) ? TRUE : FALSE;
+  cr->M = (double *) malloc(N * sizeof(double));
+  q = cr->M;
+  u = (double *) malloc(N * sizeof(double));
+  hj = x[1] - x[0];
+  D  = (y[1] - y[0]) / hj;
+
+  q[0] = u[0] = 0.0;
+  for (j = 1;   j < N-1;  j++) {
+    hj1 = x[j+1] - x[j];
+    mu  = hj / (hj + hj1);
+    D1  = (y[j+1] - y[j]) / hj1;
+
+    p = mu*q[j-1] + 2;
+    q[j] = (mu - 1) / p;
+    u[j] = ((D1 - D) * 6/(hj + hj1) - mu*u[j-1]) / p;
+
+    hj = hj1;  D = D1;
+  }
+
+  cr->M[N - 1] = 0.0;
+  for (j = N-2;  j >= 0;  j--) {
+    cr->M[j] = q[j]*cr->M[j+1] + u[j];
+  }
+  free(u);
+}
+
+static double collInterp(CollRecord *cr, double x)
 {
-  const char routineName[] = "CollisionRate";
-  register int k, n, m, ii;
-
-  char    inputLine[MAX_LINE_SIZE], keyword[MAX_LINE_SIZE], *pointer,
-          labelStr[MAX_LINE_SIZE];
-  bool_t  hunt, exit_on_EOF;
-  int     nitem, i1, i2, i, j, ij, ji, Nlevel = atom->Nlevel, Nitem,
-          status;
-  long    Nspace = atmos.Nspace, offset = 0;
-  //fpos_t  collpos;
-  double  dE, C0, *T, *coeff, *C=NULL, Cdown, Cup, gij, *np, xj, fac, fxj;
-
-  int      Ncoef, Nrow;
-  double **cdi, **badi;
-  double   acolsh,tcolsh,aradsh,xradsh,adish,bdish,t0sh,t1sh,summrs,tg,cdn,cup;
-  double   ar85t1,ar85t2,ar85a,ar85b,ar85c,ar85d,t4;
-  double   de,zz,betab,cbar,dekt,dekti,wlog,wb, sumscl = 0.0;
+  int    N = cr->Nitem, j;
+  double xmin, xmax, hj, fx, fx1;
 
-  getCPU(3, TIME_START, NULL);
+  /* --- Spline interpolation in temperature. Linear if only 2
+         interpolation points are given --             -------------- */
 
-  C0 = ((E_RYDBERG/sqrt(M_ELECTRON)) * PI*SQ(RBOHR)) *
-    sqrt(8.0/(PI*KBOLTZMANN));
+  xmin = (cr->ascend) ? cr->T[0] : cr->T[N-1];
+  xmax = (cr->ascend) ? cr->T[N-1] : cr->T[0];
 
-  if(atom->C == NULL)
-    atom->C = matrix_double(SQ(Nlevel), Nspace);
-  
-  for (ij = 0;  ij < SQ(Nlevel);  ij++) {
-    for (k = 0;  k < Nspace;  k++) {
-      atom->C[ij][k] = 0.0;
-    }
+  if (x <= xmin)
+    return (cr->ascend) ? cr->coeff[0] : cr->coeff[N-1];
+  else if (x >= xmax)
+    return (cr->ascend) ? cr->coeff[N-1] : cr->coeff[0];
+
+  Hunt(N, cr->T, x, &cr->jhunt);
+  j = cr->jhunt;
+
+  if (cr->M == NULL) {
+    fx = (cr->T[j+1] - x) / (cr->T[j+1] - cr->T[j]);
+    return fx*cr->coeff[j] + (1 - fx)*cr->coeff[j+1];
   }
-  
-  //fgetpos(fp_atom, &collpos);
-  //char *fp_atom = 
-  
-  C = (double *) malloc(Nspace * sizeof(double));
+  hj  = cr->T[j+1] - cr->T[j];
+  fx  = (x - cr->T[j]) / hj;
+  fx1 = 1 - fx;
+
+  return fx1*cr->coeff[j] + fx*cr->coeff[j+1] +
+    (fx1*(SQ(fx1) - 1) * cr->M[j] + fx*(SQ(fx) - 1) * cr->M[j+1]) *
+    SQ(hj)/6.0;
+}
+
+static struct CollData *readCollisions(struct Atom *atom, char **fp_atom)
+{
+  const char routineName[] = "readCollisions";
+  register int n, m;
+
+  char    inputLine[MAX_LINE_SIZE], keyword[MAX_LINE_SIZE], *pointer;
+  bool_t  exit_on_EOF;
+  int     nitem, i1, i2, Nitem, Nrow, Ncoef, status, Nmax = 0;
+  long    offset = 0;
+  double *T, *coeff, **table, sumscl = 0.0;
+  struct CollData *cd;
+  CollRecord *cr;
+
+  cd = (struct CollData *) calloc(1, sizeof(struct CollData));
 
   T = coeff = NULL;
   while ((status = getLine2(fp_atom[offset++], COMMENT_CHAR,
 		  inputLine, exit_on_EOF=FALSE)) != EOF) {
     strcpy(keyword, strtok(inputLine, " "));
 
+    table = NULL;
     if (!strcmp(keyword, "TEMP")) {
 
       /* --- Read temperature grid --                  -------------- */
@@ -515,96 +593,66 @@ void CollisionRate(struct Atom *atom, char **fp_atom)
         if ((pointer = strtok(NULL, " ")) == NULL) break;
 	nitem += sscanf(pointer, "%lf", coeff+n);
       }
-      /* --- Transitions i -> j are stored at index ji, transitions
-	     j -> i are stored under ij. --            -------------- */
+    } else if (!strcmp(keyword, "AR85-CHP") ||
+	       !strcmp(keyword, "AR85-CHH") ||
+	       !strcmp(keyword, "SHULL82")) {
 
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
-
-    } else if (!strcmp(keyword, "AR85-CHP") || !strcmp(keyword, "AR85-CHH")) {
-      
       i1 = atoi(strtok(NULL, " "));
       i2 = atoi(strtok(NULL, " "));
-      
-      Nitem = 6;
+
+      Nitem = (!strcmp(keyword, "SHULL82")) ? 8 : 6;
       coeff = (double *) realloc(coeff, Nitem*sizeof(double));
-      
+
       for (n = 0, nitem = 0;  n < Nitem;  n++) {
         if ((pointer = strtok(NULL, " ")) == NULL) break;
 	nitem += sscanf(pointer, "%lf", coeff+n);
       }
-
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
-
-   } else if (!strcmp(keyword, "AR85-CEA")  ||  !strcmp(keyword, "BURGESS")) {
+    } else if (!strcmp(keyword, "AR85-CEA")  ||  !strcmp(keyword, "BURGESS")) {
 
       i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));      
+      i2 = atoi(strtok(NULL, " "));
 
       Nitem = 1;
       coeff = (double *) realloc(coeff, Nitem*sizeof(double));
-      coeff[0] = atof(strtok(NULL, " "));    
-      nitem = 1;      
-
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
-
-    } else if (!strcmp(keyword, "SHULL82")) {
-      
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));
-      
-      Nitem = 8;
-      coeff = (double *) realloc(coeff, Nitem*sizeof(double));
-      
-      for (n = 0, nitem = 0;  n < Nitem;  n++) {
-        if ((pointer = strtok(NULL, " ")) == NULL) break;
-	nitem += sscanf(pointer, "%lf", coeff+n);
-      }
-      
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
+      coeff[0] = atof(strtok(NULL, " "));
+      nitem = 1;
 
-    } else if (!strcmp(keyword,"BADNELL")) {
+    } else if (!strcmp(keyword,"BADNELL") || !strcmp(keyword, "AR85-CDI")) {
 
       /* --- BADNELL recipe for dielectronic recombination:
-             Bhavna Rathore: 20 Jan 2014
-             --                                        -------------- */
+             Bhavna Rathore: 20 Jan 2014. Two rows with Ncoef
+             coefficients for BADNELL, Nrow rows with MSHELL for
+             AR85-CDI --                               -------------- */
 
       i1 = atoi(strtok(NULL, " "));
       i2 = atoi(strtok(NULL, " "));
-      Ncoef = atoi(strtok(NULL, " "));
 
-      Nrow  = 2;
+      if (!strcmp(keyword,"BADNELL")) {
+	Ncoef = atoi(strtok(NULL, " "));
+	Nrow  = 2;
+      } else {
+	Nrow  = atoi(strtok(NULL, " "));
+	Ncoef = MSHELL;
+	if (Nrow > MSHELL) {
+	  sprintf(messageStr, "Nrow: %i greater than mshell %i",
+		  Nrow, MSHELL);
+	  Error(ERROR_LEVEL_2, routineName, messageStr);
+	}
+      }
       Nitem = Nrow * Ncoef;
-      badi  = matrix_double(Nrow, Ncoef);
+      table = matrix_double(Nrow, Ncoef);
 
       for (m = 0, nitem = 0;  m < Nrow;  m++) {
 	status = getLine2(fp_atom[offset++], COMMENT_CHAR, inputLine,
 			 exit_on_EOF=FALSE);
 
-        badi[m][0] = atof(strtok(inputLine, " "));
+        table[m][0] = atof(strtok(inputLine, " "));
         nitem++;
 	for (n = 1;  n < Ncoef;  n++) {
 	  if ((pointer = strtok(NULL, " ")) == NULL) break;
-	  nitem += sscanf(pointer, "%lf", badi[m]+n);
+	  nitem += sscanf(pointer, "%lf", table[m]+n);
 	}
       }
-
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
-
     } else if (!strcmp(keyword, "SUMMERS")) {
 
       /* --- Switch for density dependent DR coefficent
@@ -619,42 +667,12 @@ void CollisionRate(struct Atom *atom, char **fp_atom)
       sumscl = atof(strtok(NULL, " "));
       nitem = 1;
 
-    } else if (!strcmp(keyword, "AR85-CDI")) {
-	
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));
-      Nrow = atoi(strtok(NULL, " "));
-      
-      if (Nrow > MSHELL) {
-	sprintf(messageStr, "Nrow: %i greater than mshell %i",
-		Nrow, MSHELL);
-	Error(ERROR_LEVEL_2, routineName, messageStr);
-      }
-
-      Nitem = Nrow * MSHELL;
-      cdi = matrix_double(Nrow, MSHELL);
-      
-      for (m = 0, nitem = 0;  m < Nrow;  m++) {
-	status = getLine2(fp_atom[offset++], COMMENT_CHAR, inputLine, exit_on_EOF=FALSE);
-	
-        cdi[m][0] = atof(strtok(inputLine, " "));
-        nitem++;
-	for (n = 1;  n < MSHELL;  n++) {
-	  if ((pointer = strtok(NULL, " ")) == NULL) break;
-	  nitem += sscanf(pointer, "%lf", cdi[m]+n);
-	}
-      }
-
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
-
     } else if (strstr(keyword, "END")) {
       break;
     } else {
       sprintf(messageStr, "[%s] Unknown keyword: !%s!", atom->ID,keyword);
       Error(ERROR_LEVEL_1, routineName, messageStr);
+      continue;
     }
 
     if (nitem != Nitem) {
@@ -662,776 +680,423 @@ void CollisionRate(struct Atom *atom, char **fp_atom)
 	      nitem, Nitem, keyword);
       Error(ERROR_LEVEL_2, routineName, messageStr);
     }
-    /* --- Spline interpolation in temperature T for all spatial
-           locations. Linear if only 2 interpolation points given - - */
-
-    if (!strcmp(keyword, "OMEGA") || !strcmp(keyword, "CE") ||
-	!strcmp(keyword, "CI")    || !strcmp(keyword, "CP") ||
-	!strcmp(keyword, "CH0")   || !strcmp(keyword, "CH+")||
-	!strcmp(keyword, "CH") ) {
-
-      if (Nitem > 2) {
-	splineCoef(Nitem, T, coeff);
-	splineEval(Nspace, atmos.T, C, hunt=TRUE);
-      } else
-	Linear(Nitem, T, coeff, Nspace, atmos.T, C, hunt=TRUE);
-    }
+    if (!strcmp(keyword, "TEMP") || !strcmp(keyword, "SUMMERS")) continue;
 
-    if (!strcmp(keyword, "OMEGA")) {
 
-      /* --- Collisional excitation of ions --         -------------- */ 
+    /* --- Store the transition. Transitions i -> j are stored at
+           index ji, transitions j -> i are stored under ij. -- ----- */
 
-      for (k = 0;  k < Nspace;  k++) {
-        Cdown = C0 * atmos.ne[k] * C[k] /
-                                 (atom->g[j] * sqrt(atmos.T[k]));
-	atom->C[ij][k] += Cdown;
-	atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
-      }
-    } else if (!strcmp(keyword, "CE")) {      
+    if (cd->Nrecord == Nmax) {
+      Nmax = (Nmax > 0) ? 2*Nmax : 16;
+      cd->record = (CollRecord *) realloc(cd->record,
+					  Nmax * sizeof(CollRecord));
+    }
+    cr = &cd->record[cd->Nrecord++];
+    memset(cr, 0, sizeof(CollRecord));
+
+    cr->i = MIN(i1, i2);
+    cr->j = MAX(i1, i2);
+    cr->sumscl = sumscl;
+    cr->Nitem = Nitem;
+
+    if      (!strcmp(keyword, "OMEGA"))    cr->type = COLL_OMEGA;
+    else if (!strcmp(keyword, "CE"))       cr->type = COLL_CE;
+    else if (!strcmp(keyword, "CI"))       cr->type = COLL_CI;
+    else if (!strcmp(keyword, "CP"))       cr->type = COLL_CP;
+    else if (!strcmp(keyword, "CH"))       cr->type = COLL_CH;
+    else if (!strcmp(keyword, "CH0"))      cr->type = COLL_CH0;
+    else if (!strcmp(keyword, "CH+"))      cr->type = COLL_CHP;
+    else if (!strcmp(keyword, "SHULL82"))  cr->type = COLL_SHULL82;
+    else if (!strcmp(keyword, "BADNELL"))  cr->type = COLL_BADNELL;
+    else if (!strcmp(keyword, "AR85-CDI")) cr->type = COLL_AR85_CDI;
+    else if (!strcmp(keyword, "AR85-CEA")) cr->type = COLL_AR85_CEA;
+    else if (!strcmp(keyword, "AR85-CHP")) cr->type = COLL_AR85_CHP;
+    else if (!strcmp(keyword, "AR85-CHH")) cr->type = COLL_AR85_CHH;
+    else                                   cr->type = COLL_BURGESS;
+
+    if (table != NULL) {
+      cr->table = table;
+      cr->Nrow  = Nrow;
+      cr->Nitem = Ncoef;
+    } else {
+      cr->coeff = (double *) malloc(Nitem * sizeof(double));
+      memcpy(cr->coeff, coeff, Nitem * sizeof(double));
+    }
 
-      /* --- Collisional excitation of neutrals --     -------------- */ 
+    if (cr->type <= COLL_CHP) {
+      cr->T = (double *) malloc(Nitem * sizeof(double));
+      memcpy(cr->T, T, Nitem * sizeof(double));
+      if (Nitem > 2) collSpline(cr);
+      else cr->ascend = (T[1] > T[0]) ? TRUE : FALSE;
+    }
 
-      gij = atom->g[i] / atom->g[j];
-      for (k = 0;  k < Nspace;  k++) {
-        Cdown = C[k] * atmos.ne[k] * gij * sqrt(atmos.T[k]);
-	atom->C[ij][k] += Cdown;
-	atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
-      }
-    } else if (!strcmp(keyword, "CI")) {      
+    if (cr->type == COLL_CP  || cr->type == COLL_CH  ||
+	cr->type == COLL_CH0 || cr->type == COLL_CHP ||
+	cr->type == COLL_AR85_CHP || cr->type == COLL_AR85_CHH)
+      cd->useH = TRUE;
+  }
 
-      /* --- Collisional ionization --                 -------------- */
+  if (status == EOF) {
+    sprintf(messageStr, "Reached end of datafile before all data was read");
+    Error(ERROR_LEVEL_1, routineName, messageStr);
+  }
+  free(T);
+  free(coeff);
 
-      dE = atom->E[j] - atom->E[i];
-      for (k = 0;  k < Nspace;  k++) {
-        Cup = C[k] * atmos.ne[k] *
-	  exp(-dE/(KBOLTZMANN*atmos.T[k])) * sqrt(atmos.T[k]);
-	atom->C[ji][k] += Cup;
-	atom->C[ij][k] += Cup * atom->nstar[i][k]/atom->nstar[j][k];
-      }
-    } else if (!strcmp(keyword, "CP")) {
+  return cd;
+}
+/* ------- end ---------------------------- readCollisions.c -------- */
 
-      /* --- Collisions with protons --                -------------- */
+/* ------- begin -------------------------- freeCollisions.c -------- */
 
-      np = atmos.H->n[atmos.H->Nlevel-1];
-      for (k = 0;  k < Nspace;  k++) {
-        Cdown = np[k] * C[k];
-	atom->C[ij][k] += Cdown;
-	atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
-      }
-    } else if (!strcmp(keyword, "CH")) {
+void freeCollisions(struct Atom *atom)
+{
+  register int n;
 
-      /* --- Collisions with neutral hydrogen --       -------------- */
+  struct CollData *cd = atom->coll;
+  CollRecord *cr;
 
-      for (k = 0;  k < Nspace;  k++) {
-        Cup = atmos.H->n[0][k] * C[k];
-	atom->C[ji][k] += Cup;
-	atom->C[ij][k] += Cup * atom->nstar[i][k]/atom->nstar[j][k];
-      }
-    } else if (!strcmp(keyword, "CH0")) {
+  if (cd == NULL) return;
 
-      /* --- Charge exchange with neutral hydrogen --  -------------- */
+  for (n = 0;  n < cd->Nrecord;  n++) {
+    cr = &cd->record[n];
+    if (cr->T != NULL)     free(cr->T);
+    if (cr->coeff != NULL) free(cr->coeff);
+    if (cr->M != NULL)     free(cr->M);
+    if (cr->table != NULL) freeMatrix((void **) cr->table);
+  }
+  if (cd->record != NULL) free(cd->record);
+  if (cd->C != NULL)      freeMatrix((void **) cd->C);
+  if (cd->key != NULL)    free(cd->key);
+  if (cd->cached != NULL) free(cd->cached);
 
-      for (k = 0;  k < Nspace;  k++)
-	atom->C[ij][k] += atmos.H->n[0][k] * C[k];
+  free(cd);
+  atom->coll = NULL;
+}
+/* ------- end ---------------------------- freeCollisions.c -------- */
 
-    } else if (!strcmp(keyword, "CH+")) {
+/* ------- begin -------------------------- collisionDepth.c -------- */
 
-      /* --- Charge exchange with protons --           -------------- */
+static void collisionDepth(struct Atom *atom, struct CollData *cd, int k)
+{
+  register int n, m, ii;
 
-      np = atmos.H->n[atmos.H->Nlevel-1];
-      for (k = 0;  k < Nspace;  k++)
-	atom->C[ji][k] += np[k] * C[k];
+  int     i, j, ij, ji, Nlevel = atom->Nlevel;
+  double  dE, C0, C, Cdown, Cup, gij, *np, xj, fac, fxj, summrs, tg,
+          cdn, cup, t4, de, zz, betab, cbar, dekt, dekti, wlog, wb,
+         *coeff, **table;
+  CollRecord *cr;
 
-    } else if (!strcmp(keyword, "SHULL82")) {
-      
-      acolsh = coeff[0];
-      tcolsh = coeff[1];
-      aradsh = coeff[2];
-      xradsh = coeff[3];
-      adish  = coeff[4];
-      bdish  = coeff[5];
-      t0sh   = coeff[6];
-      t1sh   = coeff[7];
-      
-      for (k = 0;  k < Nspace;  k++) {
-
-	summrs = sumscl * summers(i, j, atmos.ne[k], atom) +
-	  (1.0 - sumscl);
-	tg = atmos.T[k];
-	
-	cdn = aradsh * pow(tg/1.E4, -xradsh) +
-	  summrs * adish /tg/sqrt(tg) * exp(-t0sh/tg) * 
-	  (1.0 + bdish * (exp(-t1sh/tg)));
-	
-	cup = acolsh * sqrt(tg) * exp( -tcolsh / tg) / 
-	  (1.0 + 0.1 * tg / tcolsh);
-	
-	/* --- Convert coefficient from cm^3 s^-1 to m^3 s^-1 -- ---- */
-
-	cdn *= atmos.ne[k] * CUBE(CM_TO_M);
-	cup *= atmos.ne[k] * CUBE(CM_TO_M);
-
-	/* --- 3-body recombination (high density limit) -- -------- */
-
-	cdn += cup * atom->nstar[i][k] / atom->nstar[j][k];
-	
-	atom->C[ij][k] += cdn;
-	atom->C[ji][k] += cup;
-      }
-    } else if (!strcmp(keyword, "BADNELL")) {
+  C0 = ((E_RYDBERG/sqrt(M_ELECTRON)) * PI*SQ(RBOHR)) *
+    sqrt(8.0/(PI*KBOLTZMANN));
 
-      /* --- Fit for dielectronic recombination from Badnell
+  for (ij = 0;  ij < SQ(Nlevel);  ij++) atom->C[ij][k] = 0.0;
 
-	     Bhavna Rathore Jan-14
+  for (n = 0;  n < cd->Nrecord;  n++) {
+    cr = &cd->record[n];
+    i  = cr->i;
+    j  = cr->j;
+    ij = i*Nlevel + j;
+    ji = j*Nlevel + i;
+    coeff = cr->coeff;
+    table = cr->table;
 
-	     First line coefficients are the energies in K (ener in Chianti)
-	     Second line coefficients are the coefficients (coef in Chianti)
-             --                                        -------------- */
+    C = (cr->type <= COLL_CHP) ? collInterp(cr, atmos.T[k]) : 0.0;
 
-      for (k = 0;  k < Nspace;  k++) {
-	summrs = sumscl*summers(i, j, atmos.ne[k], atom) + (1.0-sumscl);
-	tg = atmos.T[k];
+    switch (cr->type) {
+    case COLL_OMEGA:
 
-      	cdn = 0.0;
-	for (ii=0;  ii < Ncoef;  ii++) {
-	  cdn += badi[1][ii] * exp(-badi[0][ii] / tg);
-	}
-	cdn *= pow(tg, -1.5) ;
+      /* --- Collisional excitation of ions --         -------------- */
 
-	/* --- Convert coefficient from cm^3 s^-1 to m^3 s^-1 -- ---- */
+      Cdown = C0 * atmos.ne[k] * C / (atom->g[j] * sqrt(atmos.T[k]));
+      atom->C[ij][k] += Cdown;
+      atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
+      break;
 
-	cdn *= atmos.ne[k] * summrs * CUBE(CM_TO_M);
-	cup  = cdn * atom->nstar[j][k]/atom->nstar[i][k];
+    case COLL_CE:
 
-	/* --- 3-body recombination (high density limit) -- --------- */
+      /* --- Collisional excitation of neutrals --     -------------- */
 
-	cdn += cup * atom->nstar[i][k] / atom->nstar[j][k];
-	
-	atom->C[ij][k] += cdn;
-	atom->C[ji][k] += cup;
-      }
-      freeMatrix((void **) badi);
+      gij = atom->g[i] / atom->g[j];
+      Cdown = C * atmos.ne[k] * gij * sqrt(atmos.T[k]);
+      atom->C[ij][k] += Cdown;
+      atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
+      break;
 
-    } else if (!strcmp(keyword, "AR85-CDI")) {
-      
-      /* --- Direct collionisional ionization --       -------------- */
+    case COLL_CI:
 
-      for (k = 0;  k < Nspace;  k++) {	
-	cup = 0.0;
-	tg  = atmos.T[k];
-	
-	for (m = 0;  m < Nrow;  m++) {
-	  
-	  xj  = cdi[m][0] * EV / (KBOLTZMANN * tg);
-	  fac = exp(-xj) * sqrt(xj);
-	  
-	  fxj = cdi[m][1] + cdi[m][2] * (1.0+xj) + 
-	    (cdi[m][3] -xj*(cdi[m][1]+cdi[m][2]*(2.0+xj)))*fone(xj) + 
-	    cdi[m][4]*xj*ftwo(xj);
-	  
-	  fxj = fxj * fac;
-	  fac = 6.69E-7 / pow(cdi[m][0], 1.5);
-	  cup += fac * fxj * CUBE(CM_TO_M);
-	}
-	if (cup < 0) cup = 0.0;
+      /* --- Collisional ionization --                 -------------- */
 
-	cup *= atmos.ne[k];
-	cdn = cup * atom->nstar[i][k]/atom->nstar[j][k];	  
-	
-	atom->C[ij][k] += cdn;
-	atom->C[ji][k] += cup;
-      }
-      freeMatrix((void **) cdi);
+      dE = atom->E[j] - atom->E[i];
+      Cup = C * atmos.ne[k] *
+	exp(-dE/(KBOLTZMANN*atmos.T[k])) * sqrt(atmos.T[k]);
+      atom->C[ji][k] += Cup;
+      atom->C[ij][k] += Cup * atom->nstar[i][k]/atom->nstar[j][k];
+      break;
 
-    } else if (!strcmp(keyword,"AR85-CEA") ) {
-          
-      /* --- Autoionization --                         -------------- */
+    case COLL_CP:
 
-      for (k = 0;  k < Nspace;  k++) {
-	fac = ar85cea(i, j, k, atom);
-	cup = coeff[0]*fac*atmos.ne[k];
-	atom->C[ji][k] += cup;
-      }	  
-      
-    } else if (!strcmp(keyword, "AR85-CHP")) {
-      
-      /* --- Charge transfer with ionized hydrogen -- --------------- */
-
-      ar85t1 = coeff[0];
-      ar85t2 = coeff[1];
-      ar85a  = coeff[2];
-      ar85b  = coeff[3];
-      ar85c  = coeff[4];
-      ar85d  = coeff[5];
-      
-      for (k = 0;  k < Nspace;  k++) {
-	if (atmos.T[k] >= ar85t1  &&  atmos.T[k] <= ar85t2) {
-
-	  t4 = atmos.T[k] / 1.0E4;
-	  cup = ar85a * 1e-9 * pow(t4,ar85b) * exp(-ar85c*t4) *
-	    exp(-ar85d*EV/KBOLTZMANN/atmos.T[k])*atmos.H->n[atmos.H->Nlevel-1][k] *
-	    CUBE(CM_TO_M);
-	  atom->C[ji][k] += cup;
-	}
-      }
-  } else if (!strcmp(keyword, "AR85-CHH")) {
-      
-      /* --- Charge transfer with neutral hydrogen --  -------------- */
-      
-      ar85t1 = coeff[0];
-      ar85t2 = coeff[1];
-      ar85a  = coeff[2];
-      ar85b  = coeff[3];
-      ar85c  = coeff[4];
-      ar85d  = coeff[5];
-      
-      for (k = 0;  k < Nspace;  k++) {	
-	if (atmos.T[k] >= ar85t1  &&  atmos.T[k] <= ar85t2) {
+      /* --- Collisions with protons --                -------------- */
 
-	  t4 = atmos.T[k] / 1.0E4;
-	  cdn = ar85a * 1E-9 * pow(t4, ar85b) * (1.0 + ar85c*exp(ar85d * t4)) * 
-	    atmos.H->n[0][k] * CUBE(CM_TO_M);
-	  atom->C[ij][k] += cdn;
-	}
-      }
-    } else if (!strcmp(keyword, "BURGESS")) {
-      
-      /* --- Electron impact ionzation following Burgess & Chidichimo 1982,
-	     MNRAS, 203, 1269-1280 
-             --                                        -------------- */
-      
-      de = (atom->E[j] - atom->E[i]) / EV;
-      zz = atom->stage[i];
-      betab = 0.25 * ( sqrt( (100.0*zz +91.0) / (4.0*zz+3.0) ) -5.0 );
-      cbar = 2.3;
-      
-      for (k = 0;  k < Nspace;  k++) {
-	dekt = de * EV / (KBOLTZMANN * atmos.T[k]);
-	dekt = MIN(500, dekt);
-	dekti = 1.0 / dekt;
-        wlog = log(1.0 + dekti);
-	wb = pow(wlog, betab / (1.0 + dekti));
-	cup = 2.1715E-8 * cbar * pow(13.6/de, 1.5) * sqrt(dekt) *
-          E1(dekt) * wb * atmos.ne[k] * CUBE(CM_TO_M);
-	
-        /* --- Add fudge factor --                     -------------- */
-
-	cup *= coeff[0];
-	cdn = cup * atom->nstar[i][k]/atom->nstar[j][k];
-	
-	atom->C[ji][k] += cup;
-	atom->C[ij][k] += cdn;
-      }
-    }
-  }
-  
-  if (status == EOF) {
-    sprintf(messageStr, "Reached end of datafile before all data was read");
-    Error(ERROR_LEVEL_1, routineName, messageStr);
-  }
-  /* --- Clean up --                                   -------------- */
+      np = atmos.H->n[atmos.H->Nlevel-1];
+      Cdown = np[k] * C;
+      atom->C[ij][k] += Cdown;
+      atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
+      break;
 
-  free(C);
-  free(T);
-  free(coeff);
-  
-  //fsetpos(fp_atom, &collpos);
+    case COLL_CH:
 
-  sprintf(labelStr, "Collision Rate %2s", atom->ID);
-  getCPU(3, TIME_POLL, labelStr);
-}
-/* ------- end ---------------------------- CollisionRate.c --------- */
+      /* --- Collisions with neutral hydrogen --       -------------- */
 
-void CollisionRateOne(struct Atom *atom, char **fp_atom, int k)
-{
-  const char routineName[] = "CollisionRateOne";
-  register int  n, m, ii;
-
-  char    inputLine[MAX_LINE_SIZE], keyword[MAX_LINE_SIZE], *pointer,
-          labelStr[MAX_LINE_SIZE];
-  bool_t  hunt, exit_on_EOF;
-  int     nitem, i1, i2, i, j, ij, ji, Nlevel = atom->Nlevel, Nitem,
-          status;
-  long    Nspace = atmos.Nspace, offset = 0;
-  fpos_t  collpos;
-  double  dE, C0, *T, *coeff, C, Cdown, Cup, gij, *np, xj, fac, fxj;
-
-  int      Ncoef, Nrow;
-  double **cdi, **badi;
-  double   acolsh,tcolsh,aradsh,xradsh,adish,bdish,t0sh,t1sh,summrs,tg,cdn,cup;
-  double   ar85t1,ar85t2,ar85a,ar85b,ar85c,ar85d,t4;
-  double   de,zz,betab,cbar,dekt,dekti,wlog,wb, sumscl = 0.0;
+      Cup = atmos.H->n[0][k] * C;
+      atom->C[ji][k] += Cup;
+      atom->C[ij][k] += Cup * atom->nstar[i][k]/atom->nstar[j][k];
+      break;
 
-  getCPU(3, TIME_START, NULL);
+    case COLL_CH0:
 
-  C0 = ((E_RYDBERG/sqrt(M_ELECTRON)) * PI*SQ(RBOHR)) *
-    sqrt(8.0/(PI*KBOLTZMANN));
-  
-  //if(atom->C == NULL)
-  //  atom->C = matrix_double(SQ(Nlevel), Nspace);
-  
-  for (ij = 0;  ij < SQ(Nlevel);  ij++) {
-    //for (k = 0;  k < Nspace;  k++) {
-    atom->C[ij][k] = 0.0;
-      // }
-  }
-  
-  //fgetpos(fp_atom, &collpos);
-  
-  C = 0.0;//(double *) malloc(Nspace * sizeof(double));
+      /* --- Charge exchange with neutral hydrogen --  -------------- */
 
-  T = coeff = NULL;
-  while ((status = getLine2(fp_atom[offset++], COMMENT_CHAR,
-		  inputLine, exit_on_EOF=FALSE)) != EOF) {
-    strcpy(keyword, strtok(inputLine, " "));
+      atom->C[ij][k] += atmos.H->n[0][k] * C;
+      break;
 
-    if (!strcmp(keyword, "TEMP")) {
+    case COLL_CHP:
 
-      /* --- Read temperature grid --                  -------------- */
+      /* --- Charge exchange with protons --           -------------- */
 
-      Nitem = atoi(strtok(NULL, " "));
-      T = (double *) realloc(T, Nitem*sizeof(double));
-      for (n = 0, nitem = 0;  n < Nitem;  n++) {
-        if ((pointer = strtok(NULL, " ")) == NULL) break;
-	nitem += sscanf(pointer, "%lf", T+n);
-      }
-    } else if (!strcmp(keyword, "OMEGA") || !strcmp(keyword, "CE") ||
-	       !strcmp(keyword, "CI")    || !strcmp(keyword, "CP") ||
-	       !strcmp(keyword, "CH0")   || !strcmp(keyword, "CH+")||
-	       !strcmp(keyword, "CH") ) {
+      np = atmos.H->n[atmos.H->Nlevel-1];
+      atom->C[ji][k] += np[k] * C;
+      break;
 
-      /* --- Read level indices and collision coefficients -- ------- */
+    case COLL_SHULL82:
 
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));
-      coeff = (double *) realloc(coeff, Nitem*sizeof(double));
+      /* --- coeff holds acol, tcol, arad, xrad, adi, bdi, t0, t1 -- */
 
-      for (n = 0, nitem = 0;  n < Nitem;  n++) {
-        if ((pointer = strtok(NULL, " ")) == NULL) break;
-	nitem += sscanf(pointer, "%lf", coeff+n);
-      }
-      /* --- Transitions i -> j are stored at index ji, transitions
-	     j -> i are stored under ij. --            -------------- */
+      summrs = cr->sumscl * summers(i, j, atmos.ne[k], atom) +
+	(1.0 - cr->sumscl);
+      tg = atmos.T[k];
 
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
+      cdn = coeff[2] * pow(tg/1.E4, -coeff[3]) +
+	summrs * coeff[4] /tg/sqrt(tg) * exp(-coeff[6]/tg) *
+	(1.0 + coeff[5] * (exp(-coeff[7]/tg)));
 
-    } else if (!strcmp(keyword, "AR85-CHP") || !strcmp(keyword, "AR85-CHH")) {
-      
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));
-      
-      Nitem = 6;
-      coeff = (double *) realloc(coeff, Nitem*sizeof(double));
-      
-      for (n = 0, nitem = 0;  n < Nitem;  n++) {
-        if ((pointer = strtok(NULL, " ")) == NULL) break;
-	nitem += sscanf(pointer, "%lf", coeff+n);
-      }
+      cup = coeff[0] * sqrt(tg) * exp( -coeff[1] / tg) /
+	(1.0 + 0.1 * tg / coeff[1]);
 
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
+      /* --- Convert coefficient from cm^3 s^-1 to m^3 s^-1 -- ---- */
 
-   } else if (!strcmp(keyword, "AR85-CEA")  ||  !strcmp(keyword, "BURGESS")) {
+      cdn *= atmos.ne[k] * CUBE(CM_TO_M);
+      cup *= atmos.ne[k] * CUBE(CM_TO_M);
 
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));      
+      /* --- 3-body recombination (high density limit) -- -------- */
 
-      Nitem = 1;
-      coeff = (double *) realloc(coeff, Nitem*sizeof(double));
-      coeff[0] = atof(strtok(NULL, " "));    
-      nitem = 1;      
+      cdn += cup * atom->nstar[i][k] / atom->nstar[j][k];
 
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
+      atom->C[ij][k] += cdn;
+      atom->C[ji][k] += cup;
+      break;
 
-    } else if (!strcmp(keyword, "SHULL82")) {
-      
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));
-      
-      Nitem = 8;
-      coeff = (double *) realloc(coeff, Nitem*sizeof(double));
-      
-      for (n = 0, nitem = 0;  n < Nitem;  n++) {
-        if ((pointer = strtok(NULL, " ")) == NULL) break;
-	nitem += sscanf(pointer, "%lf", coeff+n);
-      }
-      
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
+    case COLL_BADNELL:
 
-    } else if (!strcmp(keyword,"BADNELL")) {
+      /* --- Fit for dielectronic recombination from Badnell
 
-      /* --- BADNELL recipe for dielectronic recombination:
-             Bhavna Rathore: 20 Jan 2014
+	     Bhavna Rathore Jan-14
+
+	     First line coefficients are the energies in K (ener in Chianti)
+	     Second line coefficients are the coefficients (coef in Chianti)
              --                                        -------------- */
 
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));
-      Ncoef = atoi(strtok(NULL, " "));
+      summrs = cr->sumscl*summers(i, j, atmos.ne[k], atom) +
+	(1.0-cr->sumscl);
+      tg = atmos.T[k];
 
-      Nrow  = 2;
-      Nitem = Nrow * Ncoef;
-      badi  = matrix_double(Nrow, Ncoef);
+      cdn = 0.0;
+      for (ii=0;  ii < cr->Nitem;  ii++) {
+	cdn += table[1][ii] * exp(-table[0][ii] / tg);
+      }
+      cdn *= pow(tg, -1.5) ;
 
-      for (m = 0, nitem = 0;  m < Nrow;  m++) {
-	status = getLine2(fp_atom[offset++], COMMENT_CHAR, inputLine,
-			 exit_on_EOF=FALSE);
+      /* --- Convert coefficient from cm^3 s^-1 to m^3 s^-1 -- ---- */
 
-        badi[m][0] = atof(strtok(inputLine, " "));
-        nitem++;
-	for (n = 1;  n < Ncoef;  n++) {
-	  if ((pointer = strtok(NULL, " ")) == NULL) break;
-	  nitem += sscanf(pointer, "%lf", badi[m]+n);
-	}
-      }
+      cdn *= atmos.ne[k] * summrs * CUBE(CM_TO_M);
+      cup  = cdn * atom->nstar[j][k]/atom->nstar[i][k];
 
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
+      /* --- 3-body recombination (high density limit) -- --------- */
 
-    } else if (!strcmp(keyword, "SUMMERS")) {
+      cdn += cup * atom->nstar[i][k] / atom->nstar[j][k];
 
-      /* --- Switch for density dependent DR coefficent
+      atom->C[ij][k] += cdn;
+      atom->C[ji][k] += cup;
+      break;
 
-             Give default multiplication factor of summers density
-             dependence of dielectronic recombination:
+    case COLL_AR85_CDI:
 
-	     sumscl = 0.0 means there is no density dependence
-	     sumscl = 1.0 means full summers density dependence
-             --                                        -------------- */
-      Nitem = 1;
-      sumscl = atof(strtok(NULL, " "));
-      nitem = 1;
+      /* --- Direct collionisional ionization --       -------------- */
 
-    } else if (!strcmp(keyword, "AR85-CDI")) {
-	
-      i1 = atoi(strtok(NULL, " "));
-      i2 = atoi(strtok(NULL, " "));
-      Nrow = atoi(strtok(NULL, " "));
-      
-      if (Nrow > MSHELL) {
-	sprintf(messageStr, "Nrow: %i greater than mshell %i",
-		Nrow, MSHELL);
-	Error(ERROR_LEVEL_2, routineName, messageStr);
-      }
+      cup = 0.0;
+      tg  = atmos.T[k];
 
-      Nitem = Nrow * MSHELL;
-      cdi = matrix_double(Nrow, MSHELL);
-      
-      for (m = 0, nitem = 0;  m < Nrow;  m++) {
-	status = getLine2(fp_atom[offset++], COMMENT_CHAR, inputLine, exit_on_EOF=FALSE);
-	
-        cdi[m][0] = atof(strtok(inputLine, " "));
-        nitem++;
-	for (n = 1;  n < MSHELL;  n++) {
-	  if ((pointer = strtok(NULL, " ")) == NULL) break;
-	  nitem += sscanf(pointer, "%lf", cdi[m]+n);
-	}
-      }
+      for (m = 0;  m < cr->Nrow;  m++) {
 
-      i  = MIN(i1, i2);
-      j  = MAX(i1, i2);
-      ij = i*Nlevel + j;
-      ji = j*Nlevel + i;
+	xj  = table[m][0] * EV / (KBOLTZMANN * tg);
+	fac = exp(-xj) * sqrt(xj);
 
-    } else if (strstr(keyword, "END")) {
-      break;
-    } else {
-      sprintf(messageStr, "[%s] Unknown keyword: !%s!", atom->ID,keyword);
-      Error(ERROR_LEVEL_1, routineName, messageStr);
-    }
+	fxj = table[m][1] + table[m][2] * (1.0+xj) +
+	  (table[m][3] -xj*(table[m][1]+table[m][2]*(2.0+xj)))*fone(xj) +
+	  table[m][4]*xj*ftwo(xj);
 
-    if (nitem != Nitem) {
-      sprintf(messageStr, "\n Read %d, not %d items (keyword = %s)\n",
-	      nitem, Nitem, keyword);
-      Error(ERROR_LEVEL_2, routineName, messageStr);
-    }
-    /* --- Spline interpolation in temperature T for all spatial
-           locations. Linear if only 2 interpolation points given - - */
-
-    if (!strcmp(keyword, "OMEGA") || !strcmp(keyword, "CE") ||
-	!strcmp(keyword, "CI")    || !strcmp(keyword, "CP") ||
-	!strcmp(keyword, "CH0")   || !strcmp(keyword, "CH+")||
-	!strcmp(keyword, "CH") ) {
-
-      if (Nitem > 2) {
-	splineCoef(Nitem, T, coeff);
-	splineEval(1, &atmos.T[k], &C, hunt=TRUE);
-      } else
-	Linear(Nitem, T, coeff, 1, &atmos.T[k], &C, hunt=TRUE);
-    }
+	fxj = fxj * fac;
+	fac = 6.69E-7 / pow(table[m][0], 1.5);
+	cup += fac * fxj * CUBE(CM_TO_M);
+      }
+      if (cup < 0) cup = 0.0;
+
+      cup *= atmos.ne[k];
+      cdn = cup * atom->nstar[i][k]/atom->nstar[j][k];
 
-    if (!strcmp(keyword, "OMEGA")) {
+      atom->C[ij][k] += cdn;
+      atom->C[ji][k] += cup;
+      break;
 
-      /* --- Collisional excitation of ions --         -------------- */ 
+    case COLL_AR85_CEA:
 
-      //for (k = 0;  k < Nspace;  k++) {
-      Cdown = C0 * atmos.ne[k] * C /
-	(atom->g[j] * sqrt(atmos.T[k]));
-      atom->C[ij][k] += Cdown;
-      atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
-      // }
-    } else if (!strcmp(keyword, "CE")) {      
+      /* --- Autoionization --                         -------------- */
 
-      /* --- Collisional excitation of neutrals --     -------------- */ 
+      fac = ar85cea(i, j, k, atom);
+      cup = coeff[0]*fac*atmos.ne[k];
+      atom->C[ji][k] += cup;
+      break;
 
-      gij = atom->g[i] / atom->g[j];
-      //for (k = 0;  k < Nspace;  k++) {
-      Cdown = C * atmos.ne[k] * gij * sqrt(atmos.T[k]);
-      atom->C[ij][k] += Cdown;
-      atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
-      //}
-    } else if (!strcmp(keyword, "CI")) {      
+    case COLL_AR85_CHP:
 
-      /* --- Collisional ionization --                 -------------- */
-      
-      dE = atom->E[j] - atom->E[i];
-      //for (k = 0;  k < Nspace;  k++) {
-        Cup = C * atmos.ne[k] *
-	  exp(-dE/(KBOLTZMANN*atmos.T[k])) * sqrt(atmos.T[k]);
-	atom->C[ji][k] += Cup;
-	atom->C[ij][k] += Cup * atom->nstar[i][k]/atom->nstar[j][k];
-	//  }
-    } else if (!strcmp(keyword, "CP")) {
+      /* --- Charge transfer with ionized hydrogen, coeff holds
+             t1, t2, a, b, c, d --                     -------------- */
 
-      /* --- Collisions with protons --                -------------- */
+      if (atmos.T[k] >= coeff[0]  &&  atmos.T[k] <= coeff[1]) {
 
-      np = atmos.H->n[atmos.H->Nlevel-1];
-      // for (k = 0;  k < Nspace;  k++) {
-        Cdown = np[k] * C;
-	atom->C[ij][k] += Cdown;
-	atom->C[ji][k] += Cdown * atom->nstar[j][k]/atom->nstar[i][k];
-	//   }
-    } else if (!strcmp(keyword, "CH")) {
+	t4 = atmos.T[k] / 1.0E4;
+	cup = coeff[2] * 1e-9 * pow(t4,coeff[3]) * exp(-coeff[4]*t4) *
+	  exp(-coeff[5]*EV/KBOLTZMANN/atmos.T[k])*atmos.H->n[atmos.H->Nlevel-1][k] *
+	  CUBE(CM_TO_M);
+	atom->C[ji][k] += cup;
+      }
+      break;
 
-      /* --- Collisions with neutral hydrogen --       -------------- */
+    case COLL_AR85_CHH:
 
-      //   for (k = 0;  k < Nspace;  k++) {
-        Cup = atmos.H->n[0][k] * C;
-	atom->C[ji][k] += Cup;
-	atom->C[ij][k] += Cup * atom->nstar[i][k]/atom->nstar[j][k];
-	//  }
-    } else if (!strcmp(keyword, "CH0")) {
+      /* --- Charge transfer with neutral hydrogen --  -------------- */
 
-      /* --- Charge exchange with neutral hydrogen --  -------------- */
+      if (atmos.T[k] >= coeff[0]  &&  atmos.T[k] <= coeff[1]) {
 
-      //   for (k = 0;  k < Nspace;  k++)
-      atom->C[ij][k] += atmos.H->n[0][k] * C;
+	t4 = atmos.T[k] / 1.0E4;
+	cdn = coeff[2] * 1E-9 * pow(t4, coeff[3]) * (1.0 + coeff[4]*exp(coeff[5] * t4)) *
+	  atmos.H->n[0][k] * CUBE(CM_TO_M);
+	atom->C[ij][k] += cdn;
+      }
+      break;
 
-    } else if (!strcmp(keyword, "CH+")) {
+    case COLL_BURGESS:
 
-      /* --- Charge exchange with protons --           -------------- */
+      /* --- Electron impact ionzation following Burgess & Chidichimo 1982,
+	     MNRAS, 203, 1269-1280
+             --                                        -------------- */
 
-      np = atmos.H->n[atmos.H->Nlevel-1];
-      // for (k = 0;  k < Nspace;  k++)
-	atom->C[ji][k] += np[k] * C;
+      de = (atom->E[j] - atom->E[i]) / EV;
+      zz = atom->stage[i];
+      betab = 0.25 * ( sqrt( (100.0*zz +91.0) / (4.0*zz+3.0) ) -5.0 );
+      cbar = 2.3;
 
-    } else if (!strcmp(keyword, "SHULL82")) {
-      
-      acolsh = coeff[0];
-      tcolsh = coeff[1];
-      aradsh = coeff[2];
-      xradsh = coeff[3];
-      adish  = coeff[4];
-      bdish  = coeff[5];
-      t0sh   = coeff[6];
-      t1sh   = coeff[7];
-      
-      // for (k = 0;  k < Nspace;  k++) {
-
-	summrs = sumscl * summers(i, j, atmos.ne[k], atom) +
-	  (1.0 - sumscl);
-	tg = atmos.T[k];
-	
-	cdn = aradsh * pow(tg/1.E4, -xradsh) +
-	  summrs * adish /tg/sqrt(tg) * exp(-t0sh/tg) * 
-	  (1.0 + bdish * (exp(-t1sh/tg)));
-	
-	cup = acolsh * sqrt(tg) * exp( -tcolsh / tg) / 
-	  (1.0 + 0.1 * tg / tcolsh);
-	
-	/* --- Convert coefficient from cm^3 s^-1 to m^3 s^-1 -- ---- */
-
-	cdn *= atmos.ne[k] * CUBE(CM_TO_M);
-	cup *= atmos.ne[k] * CUBE(CM_TO_M);
-
-	/* --- 3-body recombination (high density limit) -- -------- */
-
-	cdn += cup * atom->nstar[i][k] / atom->nstar[j][k];
-	
-	atom->C[ij][k] += cdn;
-	atom->C[ji][k] += cup;
-	// }
-    } else if (!strcmp(keyword, "BADNELL")) {
+      dekt = de * EV / (KBOLTZMANN * atmos.T[k]);
+      dekt = MIN(500, dekt);
+      dekti = 1.0 / dekt;
+      wlog = log(1.0 + dekti);
+      wb = pow(wlog, betab / (1.0 + dekti));
+      cup = 2.1715E-8 * cbar * pow(13.6/de, 1.5) * sqrt(dekt) *
+	E1(dekt) * wb * atmos.ne[k] * CUBE(CM_TO_M);
 
-      /* --- Fit for dielectronic recombination from Badnell
+      /* --- Add fudge factor --                     -------------- */
 
-	     Bhavna Rathore Jan-14
+      cup *= coeff[0];
+      cdn = cup * atom->nstar[i][k]/atom->nstar[j][k];
 
-	     First line coefficients are the energies in K (ener in Chianti)
-	     Second line coefficients are the coefficients (coef in Chianti)
-             --                                        -------------- */
+      atom->C[ji][k] += cup;
+      atom->C[ij][k] += cdn;
+      break;
+    }
+  }
+}
+/* ------- end ---------------------------- collisionDepth.c -------- */
 
-      //   for (k = 0;  k < Nspace;  k++) {
-	summrs = sumscl*summers(i, j, atmos.ne[k], atom) + (1.0-sumscl);
-	tg = atmos.T[k];
+/* ------- begin -------------------------- collisionCached.c ------- */
 
-      	cdn = 0.0;
-	for (ii=0;  ii < Ncoef;  ii++) {
-	  cdn += badi[1][ii] * exp(-badi[0][ii] / tg);
-	}
-	cdn *= pow(tg, -1.5) ;
+static void collisionCached(struct Atom *atom, int k)
+{
+  register int ij;
+
+  int     Nlevel = atom->Nlevel;
+  long    Nspace = atmos.Nspace;
+  double  key[N_COLL_KEY], *ckey;
+  struct CollData *cd = atom->coll;
+
+  /* --- (Re)allocate the cache when the number of depths changes -- */
+
+  if (cd->Nspace != Nspace) {
+    if (cd->C != NULL) freeMatrix((void **) cd->C);
+    cd->C = matrix_double(SQ(Nlevel), Nspace);
+    cd->key = (double *) realloc(cd->key, N_COLL_KEY*Nspace*sizeof(double));
+    cd->cached = (bool_t *) realloc(cd->cached, Nspace*sizeof(bool_t));
+    memset(cd->cached, 0, Nspace*sizeof(bool_t));
+    cd->Nspace = Nspace;
+  }
 
-	/* --- Convert coefficient from cm^3 s^-1 to m^3 s^-1 -- ---- */
+  key[0] = atmos.T[k];
+  key[1] = atmos.ne[k];
+  key[2] = atom->ntotal[k];
+  key[3] = atom->nstar[0][k];
+  key[4] = atom->nstar[Nlevel-1][k];
+  key[5] = (cd->useH) ? atmos.H->n[0][k] : 0.0;
+  key[6] = (cd->useH) ? atmos.H->n[atmos.H->Nlevel-1][k] : 0.0;
+  ckey = cd->key + N_COLL_KEY*k;
+
+  if (cd->cached[k]  &&  !memcmp(key, ckey, sizeof(key))) {
+    for (ij = 0;  ij < SQ(Nlevel);  ij++) atom->C[ij][k] = cd->C[ij][k];
+  } else {
+    collisionDepth(atom, cd, k);
+    for (ij = 0;  ij < SQ(Nlevel);  ij++) cd->C[ij][k] = atom->C[ij][k];
+    memcpy(ckey, key, sizeof(key));
+    cd->cached[k] = TRUE;
+  }
+}
+/* ------- end ---------------------------- collisionCached.c ------- */
 
-	cdn *= atmos.ne[k] * summrs * CUBE(CM_TO_M);
-	cup  = cdn * atom->nstar[j][k]/atom->nstar[i][k];
+/* ------- begin -------------------------- CollisionRate.c --------- */
 
-	/* --- 3-body recombination (high density limit) -- --------- */
+void CollisionRate(struct Atom *atom, char **fp_atom)
+{
+  register int k;
 
-	cdn += cup * atom->nstar[i][k] / atom->nstar[j][k];
-	
-	atom->C[ij][k] += cdn;
-	atom->C[ji][k] += cup;
-	//  }
-      freeMatrix((void **) badi);
+  char labelStr[MAX_LINE_SIZE];
 
-    } else if (!strcmp(keyword, "AR85-CDI")) {
-      
-      /* --- Direct collionisional ionization --       -------------- */
+  getCPU(3, TIME_START, NULL);
 
-      // for (k = 0;  k < Nspace;  k++) {	
-	cup = 0.0;
-	tg  = atmos.T[k];
-	
-	for (m = 0;  m < Nrow;  m++) {
-	  
-	  xj  = cdi[m][0] * EV / (KBOLTZMANN * tg);
-	  fac = exp(-xj) * sqrt(xj);
-	  
-	  fxj = cdi[m][1] + cdi[m][2] * (1.0+xj) + 
-	    (cdi[m][3] -xj*(cdi[m][1]+cdi[m][2]*(2.0+xj)))*fone(xj) + 
-	    cdi[m][4]*xj*ftwo(xj);
-	  
-	  fxj = fxj * fac;
-	  fac = 6.69E-7 / pow(cdi[m][0], 1.5);
-	  cup += fac * fxj * CUBE(CM_TO_M);
-	}
-	if (cup < 0) cup = 0.0;
+  if (atom->coll == NULL) atom->coll = readCollisions(atom, fp_atom);
 
-	cup *= atmos.ne[k];
-	cdn = cup * atom->nstar[i][k]/atom->nstar[j][k];	  
-	
-	atom->C[ij][k] += cdn;
-	atom->C[ji][k] += cup;
-	//}
-      freeMatrix((void **) cdi);
+  if (atom->C == NULL)
+    atom->C = matrix_double(SQ(atom->Nlevel), atmos.Nspace);
 
-    } else if (!strcmp(keyword,"AR85-CEA") ) {
-          
-      /* --- Autoionization --                         -------------- */
+  for (k = 0;  k < atmos.Nspace;  k++) collisionCached(atom, k);
 
-      // for (k = 0;  k < Nspace;  k++) {
-	fac = ar85cea(i, j, k, atom);
-	cup = coeff[0]*fac*atmos.ne[k];
-	atom->C[ji][k] += cup;
-	//  }	  
-      
-    } else if (!strcmp(keyword, "AR85-CHP")) {
-      
-      /* --- Charge transfer with ionized hydrogen -- --------------- */
-
-      ar85t1 = coeff[0];
-      ar85t2 = coeff[1];
-      ar85a  = coeff[2];
-      ar85b  = coeff[3];
-      ar85c  = coeff[4];
-      ar85d  = coeff[5];
-      
-      // for (k = 0;  k < Nspace;  k++) {
-	if (atmos.T[k] >= ar85t1  &&  atmos.T[k] <= ar85t2) {
-
-	  t4 = atmos.T[k] / 1.0E4;
-	  cup = ar85a * 1e-9 * pow(t4,ar85b) * exp(-ar85c*t4) *
-	    exp(-ar85d*EV/KBOLTZMANN/atmos.T[k])*atmos.H->n[atmos.H->Nlevel-1][k] *
-	    CUBE(CM_TO_M);
-	  atom->C[ji][k] += cup;
-	}
-	//      }
-  } else if (!strcmp(keyword, "AR85-CHH")) {
-      
-      /* --- Charge transfer with neutral hydrogen --  -------------- */
-      
-      ar85t1 = coeff[0];
-      ar85t2 = coeff[1];
-      ar85a  = coeff[2];
-      ar85b  = coeff[3];
-      ar85c  = coeff[4];
-      ar85d  = coeff[5];
-      
-      // for (k = 0;  k < Nspace;  k++) {	
-	if (atmos.T[k] >= ar85t1  &&  atmos.T[k] <= ar85t2) {
+  sprintf(labelStr, "Collision Rate %2s", atom->ID);
+  getCPU(3, TIME_POLL, labelStr);
+}
+/* ------- end ---------------------------- CollisionRate.c --------- */
 
-	  t4 = atmos.T[k] / 1.0E4;
-	  cdn = ar85a * 1E-9 * pow(t4, ar85b) * (1.0 + ar85c*exp(ar85d * t4)) * 
-	    atmos.H->n[0][k] * CUBE(CM_TO_M);
-	  atom->C[ij][k] += cdn;
-	}
-	//}
-    } else if (!strcmp(keyword, "BURGESS")) {
-      
-      /* --- Electron impact ionzation following Burgess & Chidichimo 1982,
-	     MNRAS, 203, 1269-1280 
-             --                                        -------------- */
-      
-      de = (atom->E[j] - atom->E[i]) / EV;
-      zz = atom->stage[i];
-      betab = 0.25 * ( sqrt( (100.0*zz +91.0) / (4.0*zz+3.0) ) -5.0 );
-      cbar = 2.3;
-      
-      //      for (k = 0;  k < Nspace;  k++) {
-	dekt = de * EV / (KBOLTZMANN * atmos.T[k]);
-	dekt = MIN(500, dekt);
-	dekti = 1.0 / dekt;
-        wlog = log(1.0 + dekti);
-	wb = pow(wlog, betab / (1.0 + dekti));
-	cup = 2.1715E-8 * cbar * pow(13.6/de, 1.5) * sqrt(dekt) *
-          E1(dekt) * wb * atmos.ne[k] * CUBE(CM_TO_M);
-	
-        /* --- Add fudge factor --                     -------------- */
-
-	cup *= coeff[0];
-	cdn = cup * atom->nstar[i][k]/atom->nstar[j][k];
-	
-	atom->C[ji][k] += cup;
-	atom->C[ij][k] += cdn;
-	//  }
-    }
-  }
-  
-  if (status == EOF) {
-    sprintf(messageStr, "Reached end of datafile before all data was read");
-    Error(ERROR_LEVEL_1, routineName, messageStr);
-  }
-  /* --- Clean up --                                   -------------- */
+/* ------- begin -------------------------- CollisionRateOne.c ------ */
 
-  //  free(C);
-  free(T);
-  free(coeff);
-  
-  //fsetpos(fp_atom, &collpos);
+void CollisionRateOne(struct Atom *atom, char **fp_atom, int k)
+{
+  if (atom->coll == NULL) atom->coll = readCollisions(atom, fp_atom);
 
-  //sprintf(labelStr, "Collision Rate %2s", atom->ID);
-  // getCPU(3, TIME_POLL, labelStr);
+  collisionCached(atom, k);
 }
+/* ------- end ---------------------------- CollisionRateOne.c ------ */
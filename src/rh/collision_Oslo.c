@@ -75,8 +75,8 @@ void rowcol(int i, int *row, int *col);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin --------------------------------- rowcol.c --------- */
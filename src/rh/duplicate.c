@@ -31,7 +31,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- duplicateLevel.c -------- */
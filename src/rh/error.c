@@ -22,7 +22,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern CommandLine commandline;
+extern RH_TLS CommandLine commandline;
 
 
 /* ------- begin -------------------------- Error.c ----------------- */
@@ -26,7 +26,7 @@ double E1(double x);
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- E1.c -------------------- */
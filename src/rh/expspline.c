@@ -22,9 +22,9 @@
 
 /* --- Global variables --                             -------------- */
 
-static bool_t  ascend;
-static int     Ntable;
-static double *xtable, xmin, xmax, sigma, *M = NULL,
+static RH_TLS bool_t  ascend;
+static RH_TLS int     Ntable;
+static RH_TLS double *xtable, xmin, xmax, sigma, *M = NULL,
               *ytable, *sinhh = NULL;
 
 
@@ -33,7 +33,7 @@ static double *xtable, xmin, xmax, sigma, *M = NULL,
 void exp_splineCoef(int N, double *x, double *y, double tension)
 {
   register int j;
-  static double *u = NULL;
+  static RH_TLS double *u = NULL;
 
   double *q, p, h, sh, Aj, Cj, Dj, Dj1, Bj, Bj1;
 
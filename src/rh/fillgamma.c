@@ -33,10 +33,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- initGammaAtom.c --------- */
@@ -85,7 +85,7 @@ void addtoGamma(int nspect, double wmu, double *I, double *Psi)
   register int nact, n, k, m;
 
   int    i, j, ij, ji, jp, nt;
-  double twohnu3_c2, twohc, wlamu, *Ieff,
+  double twohnu3_c2, twohc, wlamu, *Ieff, **Gamma,
         *Stokes_Q, *Stokes_U, *Stokes_V, *eta_Q, *eta_U, *eta_V;
 
   Atom *atom;
@@ -159,7 +159,10 @@ void addtoGamma(int nspect, double wmu, double *I, double *Psi)
 	twohnu3_c2 = 0.0;
       }
 
-      if (input.Nthreads > 1) pthread_mutex_lock(&atom->Gamma_lock);
+      /* --- With several threads each one adds to its own copy of
+             Gamma, summed afterwards in solveSpectrum -- ----------- */
+
+      Gamma = (input.Nthreads > 1) ? atom->rhth[nt].Gamma : atom->Gamma;
       
       ij = i*atom->Nlevel + j;
       ji = j*atom->Nlevel + i;
@@ -167,14 +170,14 @@ void addtoGamma(int nspect, double wmu, double *I, double *Psi)
       for (k = 0;  k < atmos.Nspace;  k++) {
 	wlamu = atom->rhth[nt].Vij[n][k] * atom->rhth[nt].wla[n][k] * wmu;
 
-	atom->Gamma[ji][k] += Ieff[k] * wlamu;
-	atom->Gamma[ij][k] += (twohnu3_c2 + Ieff[k]) *
+	Gamma[ji][k] += Ieff[k] * wlamu;
+	Gamma[ij][k] += (twohnu3_c2 + Ieff[k]) *
 	  atom->rhth[nt].gij[n][k] * wlamu;
       }
       /* --- Cross-coupling terms, currently only for Stokes_I -- --- */
 
       for (k = 0;  k < atmos.Nspace;  k++) {
-	atom->Gamma[ij][k] -= atom->rhth[nt].chi_up[i][k] *
+	Gamma[ij][k] -= atom->rhth[nt].chi_up[i][k] *
 	  Psi[k]*atom->rhth[nt].Uji_down[j][k] * wmu;
       }
       /* --- If rt->i is also an upper level of another transition that
@@ -193,12 +196,11 @@ void addtoGamma(int nspect, double wmu, double *I, double *Psi)
 	}
 	if (jp == i) {
 	  for (k = 0;  k < atmos.Nspace;  k++) {
-	    atom->Gamma[ji][k] += atom->rhth[nt].chi_down[j][k] *
+	    Gamma[ji][k] += atom->rhth[nt].chi_down[j][k] *
 	      Psi[k]*atom->rhth[nt].Uji_down[i][k] * wmu;
 	  }
 	}
       }
-      if (input.Nthreads > 1) pthread_mutex_unlock(&atom->Gamma_lock); 
     }
   }
   /* --- Add the active molecular contributions --     -------------- */
@@ -377,7 +379,7 @@ void addtoRates(int nspect, int mu, bool_t to_obs, double wmu,
 {
   register int nact, n, k;
 
-  int    la, lamu, nt;
+  int    la, lamu, nt, kr;
   double twohnu3_c2, twohc, hc_4PI, Bijxhc_4PI, wlamu, *Rij, *Rji,
          up_rate, *Stokes_Q, *Stokes_U, *Stokes_V;
 
@@ -385,7 +387,6 @@ void addtoRates(int nspect, int mu, bool_t to_obs, double wmu,
   Atom *atom;
   AtomicLine *line;
   AtomicContinuum *continuum;
-  pthread_mutex_t *rate_lock;
 
   /* --- Calculate the radiative rates for atomic transitions.
 
@@ -418,11 +419,10 @@ void addtoRates(int nspect, int mu, bool_t to_obs, double wmu,
 	if (redistribute && !line->PRD)
 	  Rij = NULL;
 	else {
+	  kr = line - atom->line;
 	  Rij = line->Rij;
 	  Rji = line->Rji;
 	  twohnu3_c2 = line->Aji / line->Bji;
-
-	  rate_lock = &line->rate_lock;
 	}
 	break;
 
@@ -431,11 +431,10 @@ void addtoRates(int nspect, int mu, bool_t to_obs, double wmu,
 	  Rij = NULL;
 	else {
 	  continuum = as->art[nact][n].ptype.continuum;
+	  kr = atom->Nline + (continuum - atom->continuum);
 	  Rij = continuum->Rij;
 	  Rji = continuum->Rji;
 	  twohnu3_c2 = twohc / CUBE(spectrum.lambda[nspect]);
-
-	  rate_lock = &continuum->rate_lock;
 	}
 	break;
       
@@ -445,16 +444,19 @@ void addtoRates(int nspect, int mu, bool_t to_obs, double wmu,
       /* --- Convention: Rij is the rate for transition i -> j -- ----- */
 
       if (Rij != NULL) {
-	if (input.Nthreads > 1) pthread_mutex_lock(rate_lock);
 
+	/* --- Per-thread rates, summed afterwards in solveSpectrum - */
+
+	if (input.Nthreads > 1) {
+	  Rij = atom->rhth[nt].Rij[kr];
+	  Rji = atom->rhth[nt].Rji[kr];
+	}
 	for (k = 0;  k < atmos.Nspace;  k++) {
 	  wlamu =
 	    atom->rhth[nt].Vij[n][k] * atom->rhth[nt].wla[n][k] * wmu;
 	  Rij[k] += I[k] * wlamu;
 	  Rji[k] += atom->rhth[nt].gij[n][k] * (twohnu3_c2 + I[k]) * wlamu;
 	}
-
-	if (input.Nthreads > 1) pthread_mutex_unlock(rate_lock);
       }
     }
   }
@@ -58,7 +58,7 @@ double sumE1_xe(double xe, double xrad);
 /* --- Global variables --                             -------------- */
 
 extern enum Topology topology;
-extern Atmosphere atmos;
+extern RH_TLS Atmosphere atmos;
 
 
 /* ------- begin -------------------------- FixedRate.c ------------- */
@@ -16,7 +16,7 @@
 #include "rh.h"
 #include "error.h"
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 #if defined(SETNOTRAPS)
 
@@ -48,9 +48,9 @@ hrtime_t gethrtime(void);
 
 /* --- Global variables --                             -------------- */
 
-extern ProgramStats stats;
-extern CommandLine  commandline;
-extern char messageStr[];
+extern RH_TLS ProgramStats stats;
+extern RH_TLS CommandLine  commandline;
+extern RH_TLS char messageStr[];
 
 /* ------- begin -------------------------- getTime.c --------------- */
 
@@ -61,11 +61,11 @@ void getCPU(int level, enum CPUaction action, char *label)
   int Nblanck, Nspace, Ndot;
 
 #if defined(SunOS5)
-  static hrtime_t CPU[N_TIME_LEVELS];
+  static RH_TLS hrtime_t CPU[N_TIME_LEVELS];
   static double   scale = NANOSECOND;
   hrtime_t CPUtime;
 #else
-  static clock_t CPU[N_TIME_LEVELS];
+  static RH_TLS clock_t CPU[N_TIME_LEVELS];
   static double  scale = 1.0 / CLOCKS_PER_SEC;
   clock_t CPUtime;
 #endif
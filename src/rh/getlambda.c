@@ -34,9 +34,9 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char   messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input;
+extern RH_TLS char   messageStr[];
 
 
 /* ------- begin -------------------------- getLambda.c ------------- */
@@ -22,7 +22,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- getLine.c --------------- */
@@ -102,7 +102,7 @@ void UpperCase(char *string)
 
 char *substring(const char *string, int N0, int Nchar)
 {
-  static char destination[MAX_LINE_SIZE];
+  static RH_TLS char destination[MAX_LINE_SIZE];
   int length = strlen(string);
  
   /* --- Extract a substring of length Nchar from source string,
@@ -43,7 +43,7 @@ double PII(double adamp, double waveRatio, double q_emit, double q_abs)
 {
   register int  n;
 
-  static bool_t initialize = TRUE;
+  static RH_TLS bool_t initialize = TRUE;
   double theta, pii, a1, a2, b1, b2, c1;
 
   /* --- Use 8-point Gaussian quadrature --           --------------- */
@@ -52,7 +52,7 @@ double PII(double adamp, double waveRatio, double q_emit, double q_abs)
     {0.183434642495, 0.525532409916, 0.796666477413, 0.960289856497};
   static double wg[NGAUSS/2] =
     {0.362683783378, 0.313706645877, 0.222381034453, 0.101228536290};
-  static double sn[NGAUSS], cs[NGAUSS];
+  static RH_TLS double sn[NGAUSS], cs[NGAUSS];
 
   if (initialize) {
     for (n = 0;  n < NGAUSS;  n++) {
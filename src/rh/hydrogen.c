@@ -56,8 +56,8 @@ double bilinear(int Ncol, int Nrow, double *f, double x, double y);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- distribute_nH.c --------- */
@@ -344,9 +344,9 @@ bool_t Hminus_ff(double lambda, double *chi)
 {
   register int  k;
 
-  static bool_t  initialize=TRUE;
-  static int     index;
-  static double *theta_index;
+  static RH_TLS bool_t  initialize=TRUE;
+  static RH_TLS int     index;
+  static RH_TLS double *theta_index;
 
   /* --- H-minus Free-Free coefficients (in units of 1.0E-29 m^5/J)
 
@@ -556,9 +556,9 @@ bool_t H2minus_ff(double lambda, double *chi) {
 
   register int  k;
 
-  static  bool_t initialize=TRUE;
-  static   int   index;
-  static double *theta_index;
+  static RH_TLS bool_t initialize=TRUE;
+  static RH_TLS int   index;
+  static RH_TLS double *theta_index;
 
   /* --- H2-minus Free-Free absorption coefficients (in units of
          10E-29 m^5/J). Stimulated emission is included.
@@ -701,9 +701,9 @@ bool_t H2plus_ff(double lambda, double *chi)
 {
   register int  k;
 
-  static  bool_t initialize=TRUE;
-  static   int   index;
-  static double *temp_index;
+  static RH_TLS bool_t initialize=TRUE;
+  static RH_TLS int   index;
+  static RH_TLS double *temp_index;
 
   /* --- H2+ Free-Free scattering coefficients in units of 
          1.0E-49 m^-1 / (H atom/m^3) / (proton/M^3). Stimulated emission
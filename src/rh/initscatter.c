@@ -21,10 +21,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- initScatter.c ----------- */
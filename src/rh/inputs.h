@@ -59,6 +59,7 @@ typedef struct {
          Stokes_input[MAX_VALUE_LENGTH],
          KuruczData[MAX_VALUE_LENGTH],
          pfData[MAX_VALUE_LENGTH],
+         model_archive[MAX_VALUE_LENGTH],
          fudgeData[MAX_VALUE_LENGTH],
          atmos_output[MAX_VALUE_LENGTH],
          spectrum_output[MAX_VALUE_LENGTH],
@@ -77,17 +78,20 @@ typedef struct {
   bool_t magneto_optical, PRD_angle_dep, XRD, Eddington,
     backgr_pol, limit_memory, allow_passive_bb, NonICE,
     rlkscatter, xdr_endian, old_background, accelerate_mols,
-    prdh_limit_mem;
+    prdh_limit_mem, PRD_GII_single, formal_batch, Voigt_lookup,
+    profile_single, backgr_share_rays, backgr_single, reduced_grid;
   enum   solution startJ;
   enum   StokesMode StokesMode;
   enum   S_interpol S_interpolation;
   enum   S_interpol_stokes S_interpolation_stokes;
   enum   order_3D interpolate_3D;
   enum   ne_solution solve_ne;
+  enum   AccelMethod Ng_method;
   int    isum, Ngdelay, Ngorder, Ngperiod, NmaxIter,
     PRD_NmaxIter, PRD_Ngdelay, PRD_Ngorder, PRD_Ngperiod,
     NmaxScatter, Nthreads, NlambdaIter;
-  double iterLimit, PRDiterLimit, metallicity, eos_iter_limit, ng_start_limit;
+  double iterLimit, PRDiterLimit, metallicity, eos_iter_limit, ng_start_limit,
+    PRD_GII_memlimit, Voigt_accuracy;
 
   double crsw, crsw_ini;
   double prdswitch, prdsw;
@@ -105,6 +109,8 @@ int   getLine2(char *inputFile, char *commentChar, char *line,
 void  parse(int argc, char *argv[], int Noption, Option *theOptions);
 void  readInput();
 void  readValues(FILE *fp_keyword, int Nkeyword, Keyword *theKeywords);
+FILE *openModelFile(char *fileName);
+void  writeModelArchive(char *archiveName, int Nfile, char **fileNames);
 
 void  setAngleSet(char *value, void *pointer);
 void  setcharValue(char *value, void *pointer);
@@ -114,6 +120,7 @@ void  setdoubleValue(char *value, void *pointer);
 void  setstartValue(char *value, void *pointer);
 void  setnesolution(char *value, void *pointer);
 void  setPRDangle(char *value, void *pointer);
+void  setNgMethod(char *value, void *pointer);
 void  setStokesMode(char *value, void *pointer);
 void  setThreadValue(char *value, void *pointer);
 void  setInterpolate_3D(char *value, void *pointer);
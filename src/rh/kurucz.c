@@ -82,6 +82,7 @@ FORMAT(F11.4,F7.3,F6.2,F12.3,F5.2,1X,A10,F12.3,F5.2,1X,A10,
 #define MILLI               1.0E-03
 #define ANGSTROM_TO_NM      0.1
 #define MAX_GAUSS_DOPPLER   7.0
+#define RLK_WINDOW_MARGIN   1.1
 
 
 /* --- Function prototypes --                          -------------- */
@@ -100,29 +101,180 @@ void             free_BS(Barklemstruct *bs);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
+/* ------- begin -------------------------- setKuruczLine.c --------- */
+
+static void setKuruczLine(RLK_Line *rlk, RLK_Record *rec, int list_index,
+			  Barklemstruct *bs_SP, Barklemstruct *bs_PD,
+			  Barklemstruct *bs_DF)
+{
+  const double  C = 2.0*PI * (Q_ELECTRON/EPSILON_0) * 
+                             (Q_ELECTRON/M_ELECTRON) / CLIGHT;
+
+  char   labeli[RLK_LABEL_LENGTH+1], labelj[RLK_LABEL_LENGTH+1];
+  bool_t determined, useBarklem;
+  double lambda0;
+
+  /* --- Fill the line data from a parsed line of the list -- ------- */
+
+  initRLK(rlk);
+
+  rlk->pt_index = rec->pt_index;
+  rlk->stage    = rec->stage;
+  rlk->list_index = list_index;
+  rlk->line_index = rec->line_index;
+  rlk->Ei = rec->Ei;
+  rlk->Ej = rec->Ej;
+
+  memcpy(labeli, rec->labeli, RLK_LABEL_LENGTH);
+  memcpy(labelj, rec->labelj, RLK_LABEL_LENGTH);
+  labeli[RLK_LABEL_LENGTH] = '\0';
+  labelj[RLK_LABEL_LENGTH] = '\0';
+
+  rlk->gi = 2*rec->Ji + 1;
+  rlk->gj = 2*rec->Jj + 1;
+
+  lambda0 = (HPLANCK * CLIGHT) / (rlk->Ej - rlk->Ei);
+  rlk->Aji = C / SQ(lambda0) * POW10(rec->gf) / rlk->gj;
+  rlk->Bji = CUBE(lambda0) / (2.0 * HPLANCK * CLIGHT) * rlk->Aji;
+  rlk->Bij = (rlk->gj / rlk->gi) * rlk->Bji;
+
+  /* --- Store in nm --                                -------------- */
+
+  rlk->lambda0 = lambda0 / NM_TO_M;
+
+  /* --- Get quantum numbers for angular momentum and spin -- ------- */
+
+  determined = RLKdeterminate(labeli, labelj, rlk);
+  rlk->polarizable = (atmos.Stokes && determined);
+
+  /* --- Get "small" l values for Barklem tables --- */
+	
+  determined = RLKdeterminate_ac(labeli, labelj, rlk);
+	
+  /* --- Line broadening --                            -------------- */
+
+  if (rec->GStark != 0.0) 
+    rlk->GStark = POW10(rec->GStark) * CUBE(CM_TO_M);
+  else
+    rlk->GStark = 0.0;
+
+  if (rec->GvdWaals != 0.0)
+    rlk->GvdWaals = POW10(rec->GvdWaals) * CUBE(CM_TO_M);
+  else
+    rlk->GvdWaals = 0.0;
+
+  /* --- If possible use Barklem formalism --          -------------- */
+
+  useBarklem = FALSE;
+  if (determined) {
+    if ((rlk->li == S_ORBIT && rlk->lj == P_ORBIT) ||
+	(rlk->li == P_ORBIT && rlk->lj == S_ORBIT)) {
+      useBarklem = getBarklemcross_ac(bs_SP, rlk);
+    } else if ((rlk->li == P_ORBIT && rlk->lj == D_ORBIT) ||
+	       (rlk->li == D_ORBIT && rlk->lj == P_ORBIT)) {
+      useBarklem = getBarklemcross_ac(bs_PD, rlk);
+    } else if ((rlk->li == D_ORBIT && rlk->lj == F_ORBIT) ||
+	       (rlk->li == F_ORBIT && rlk->lj == D_ORBIT)) {
+      useBarklem = getBarklemcross_ac(bs_DF, rlk);
+    }
+  }
+  /* --- Else use good old Unsoeld --                  -------------- */
+
+  if (!useBarklem) {
+    getUnsoldcross(rlk);
+  }
+  /* --- Radiative broadening --                       -------------- */
+
+  if (rec->Grad != 0.0) {
+    rlk->Grad = POW10(rec->Grad);
+  } else {
+
+    /* --- Just take the Einstein Aji value, but only if either
+           Stark or vd Waals broadening is in effect -- ------------- */     
+
+    if (rec->GStark != 0.0  || rec->GvdWaals != 0.0)
+      rlk->Grad = rlk->Aji;
+    else {
+      rlk->Grad = 0.0;
+
+      /* --- In this case the line is not polarizable because
+	     there is no way to determine its damping -- ------------ */
+
+      rlk->polarizable = FALSE;
+    }
+  }
+  /* --- Isotope and hyperfine fractions and slpittings -- ---------- */
+
+  rlk->isotope = rec->isotope;
+  rlk->isotope_frac = POW10(rec->isotope_frac);
+  rlk->hyperfine_frac = POW10(rec->hyperfine_frac);
+  rlk->hfs_i = ((double) rec->hfs_i) * MILLI * KBOLTZMANN;
+  rlk->hfs_j = ((double) rec->hfs_j) * MILLI * KBOLTZMANN;
+
+  /* --- Effective Lande factors --                    -------------- */
+
+  rlk->gL_i = rec->gL_i * MILLI;
+  rlk->gL_j = rec->gL_j * MILLI;
+
+  rlk->iso_dl = 0.0;
+}
+/* ------- end ---------------------------- setKuruczLine.c --------- */
+
+/* ------- begin -------------------------- kuruczWindows.c --------- */
+
+static int kuruczWindows(double **lambda_min, double **lambda_max)
+{
+  register int nspect;
+
+  int    Nwindow = 0;
+  double dlamb_char;
+
+  /* --- Merged wavelength intervals within which Kurucz lines can
+         contribute to the background at the wavelengths of the
+         spectrum (see rlk_opacity), widened somewhat to be safe.
+         Returns 0 when the spectrum is not known yet -- ------------ */
+
+  *lambda_min = (double *) malloc(MAX(spectrum.Nspect, 1) * sizeof(double));
+  *lambda_max = (double *) malloc(MAX(spectrum.Nspect, 1) * sizeof(double));
+
+  for (nspect = 0;  nspect < spectrum.Nspect;  nspect++) {
+    dlamb_char = RLK_WINDOW_MARGIN * spectrum.lambda[nspect] * Q_WING *
+      (atmos.vmicro_char / CLIGHT);
+
+    if (Nwindow > 0  &&
+	spectrum.lambda[nspect] - dlamb_char <= (*lambda_max)[Nwindow-1]) {
+      (*lambda_max)[Nwindow-1] = spectrum.lambda[nspect] + dlamb_char;
+    } else {
+      (*lambda_min)[Nwindow] = spectrum.lambda[nspect] - dlamb_char;
+      (*lambda_max)[Nwindow] = spectrum.lambda[nspect] + dlamb_char;
+      Nwindow++;
+    }
+  }
+  return Nwindow;
+}
+/* ------- end ---------------------------- kuruczWindows.c --------- */
+
 /* ------- begin -------------------------- readKuruczLines.c ------- */
 
 void readKuruczLines(char *inputFile)
 {
   const char routineName[] = "readKuruczLines";
-  const double  C = 2.0*PI * (Q_ELECTRON/EPSILON_0) * 
-                             (Q_ELECTRON/M_ELECTRON) / CLIGHT;
 
   char   inputLine[RLK_RECORD_LENGTH+1], listName[MAX_LINE_SIZE],
-    filename[MAX_LINE_SIZE], Gvalues[18+1], elem_code[7],
-         labeli[RLK_LABEL_LENGTH+1], labelj[RLK_LABEL_LENGTH+1],
-    *commentChar = COMMENT_CHAR;
-  bool_t swap_levels, determined, useBarklem;
-  int    Nline, Nread, Nrequired, checkPoint, hfs_i, hfs_j, gL_i, gL_j,
-         iso_dl;
-  double lambda0, Ji, Jj, Grad=0, GStark=0, GvdWaals=0, pti,
-         Ei, Ej, gf, lambda_air;
+         filename[MAX_LINE_SIZE], *commentChar = COMMENT_CHAR;
+  int    Nline, Nread, Nrequired, checkPoint, Nwindow, nw, Nlist = 0,
+         list_index;
+  long   n, nfirst;
+  double *lambda_min, *lambda_max;
   RLK_Line *rlk;
+  RLK_Record rec;
+  RLK_Binary rb;
   Barklemstruct bs_SP, bs_PD, bs_DF;
   FILE  *fp_Kurucz, *fp_linelist;
 
@@ -134,19 +286,55 @@ void readKuruczLines(char *inputFile)
   readBarklemTable(PD, &bs_PD);
   readBarklemTable(DF, &bs_DF);
 
-  labeli[RLK_LABEL_LENGTH] = '\0';
-  labelj[RLK_LABEL_LENGTH] = '\0';
-
-  if ((fp_Kurucz = fopen(inputFile, "r")) == NULL) {
+  if ((fp_Kurucz = openModelFile(inputFile)) == NULL) {
     sprintf(messageStr, "Unable to open input file %s", inputFile);
     Error(ERROR_LEVEL_1, routineName, messageStr);
     return;
   }
+  Nwindow = kuruczWindows(&lambda_min, &lambda_max);
+  memset(&rec, 0, sizeof(RLK_Record));
+
   /* --- Go through each of the linelist files listed in input file - */  
 
   while (getLine(fp_Kurucz, commentChar, listName, FALSE) != EOF) {
     Nread = sscanf(listName, "%s", filename);
-    if ((fp_linelist = fopen(filename, "r")) == NULL) {
+    list_index = Nlist++;
+    if (atmos.Nrlk == 0) atmos.rlk_lines = NULL;
+
+    /* --- Binary line list (see rlkbinary.c): only the lines within
+           reach of the spectrum are taken --          -------------- */
+
+    if (openKuruczBinary(filename, &rb)) {
+      Nline = 0;
+      for (nw = 0;  nw < MAX(Nwindow, 1);  nw++) {
+	nfirst = (Nwindow > 0) ? locateKuruczBinary(&rb, lambda_min[nw]) : 0;
+	for (n = nfirst;  n < rb.Nline;  n++) {
+	  if (Nwindow > 0  &&  rb.record[n].lambda0 > lambda_max[nw]) break;
+	  Nline++;
+	}
+      }
+      atmos.rlk_lines = (RLK_Line *)
+	realloc(atmos.rlk_lines, (Nline + atmos.Nrlk) * sizeof(RLK_Line));
+
+      rlk = atmos.rlk_lines + atmos.Nrlk;
+      for (nw = 0;  nw < MAX(Nwindow, 1);  nw++) {
+	nfirst = (Nwindow > 0) ? locateKuruczBinary(&rb, lambda_min[nw]) : 0;
+	for (n = nfirst;  n < rb.Nline;  n++) {
+	  if (Nwindow > 0  &&  rb.record[n].lambda0 > lambda_max[nw]) break;
+	  setKuruczLine(rlk++, &rb.record[n], list_index,
+			&bs_SP, &bs_PD, &bs_DF);
+	}
+      }
+      sprintf(messageStr, "Read %d of %ld Kurucz lines from binary file %s\n",
+	      Nline, rb.Nline, listName);
+      Error(MESSAGE, routineName, messageStr);
+      atmos.Nrlk += Nline;
+
+      closeKuruczBinary(&rb);
+      continue;
+    }
+
+    if ((fp_linelist = openModelFile(filename)) == NULL) {
       sprintf(messageStr, "Unable to open input file %s", filename);
       Error(ERROR_LEVEL_1, routineName, messageStr);
     }
@@ -157,7 +345,6 @@ void readKuruczLines(char *inputFile)
       if (*inputLine != *commentChar) Nline++;
     rewind(fp_linelist);
 
-    if (atmos.Nrlk == 0) atmos.rlk_lines = NULL;
     atmos.rlk_lines = (RLK_Line *)
       realloc(atmos.rlk_lines, (Nline + atmos.Nrlk) * sizeof(RLK_Line));
 
@@ -166,164 +353,11 @@ void readKuruczLines(char *inputFile)
     rlk = atmos.rlk_lines + atmos.Nrlk;
     while (fgets(inputLine, RLK_RECORD_LENGTH+1, fp_linelist) != NULL) {
       if (*inputLine != *commentChar) {
-
-        initRLK(rlk);
-
-	Nread = sscanf(inputLine, "%lf %lf %s %lf",
-		       &lambda_air, &gf, (char *) &elem_code, &Ei);
-
-        /* --- Ionization stage and periodic table index -- --------- */
-
-        sscanf(elem_code, "%d.%d", &rlk->pt_index, &rlk->stage);
-
-	Nread += sscanf(inputLine+53, "%lf", &Ej);
-
-	Ei = fabs(Ei) * (HPLANCK * CLIGHT) / CM_TO_M;
-	Ej = fabs(Ej) * (HPLANCK * CLIGHT) / CM_TO_M;
-
-	/* --- Beware: the Kurucz linelist has upper and lower levels
-	       of a transition in random order. Therefore, we have to
-               check for the lowest energy of the two and use that as
-               lower level --                          -------------- */
-
-	if (Ej < Ei) {
-	  swap_levels = TRUE; 
-	  rlk->Ei = Ej;
-	  rlk->Ej = Ei;
-	  strncpy(labeli, inputLine+69, RLK_LABEL_LENGTH);
-	  strncpy(labelj, inputLine+41, RLK_LABEL_LENGTH);
-	} else {
-	  swap_levels = FALSE;
-	  rlk->Ei = Ei;
-          rlk->Ej = Ej;
-	  strncpy(labeli, inputLine+41, RLK_LABEL_LENGTH);
-	  strncpy(labelj, inputLine+69, RLK_LABEL_LENGTH);
-	}
-
-	Nread += sscanf(inputLine+35, "%lf", &Ji);
-	Nread += sscanf(inputLine+63, "%lf", &Jj);
-	if (swap_levels) SWAPDOUBLE(Ji, Jj);
-	rlk->gi = 2*Ji + 1;
-	rlk->gj = 2*Jj + 1;
-
-	lambda0 = (HPLANCK * CLIGHT) / (rlk->Ej - rlk->Ei);
-	rlk->Aji = C / SQ(lambda0) * POW10(gf) / rlk->gj;
-	rlk->Bji = CUBE(lambda0) / (2.0 * HPLANCK * CLIGHT) * rlk->Aji;
-	rlk->Bij = (rlk->gj / rlk->gi) * rlk->Bji;
-
-        /* --- Store in nm --                          -------------- */
-
-	rlk->lambda0 = lambda0 / NM_TO_M;
-
-	/* --- Get quantum numbers for angular momentum and spin -- - */
-
-        determined = RLKdeterminate(labeli, labelj, rlk);
-        rlk->polarizable = (atmos.Stokes && determined);
-
-	
-	/* --- Get "small" l values for Barklem tables --- */
-	
-	determined = RLKdeterminate_ac(labeli, labelj, rlk);
-	
-	
-        /* --- Line broadening --                      -------------- */
-
-	strncpy(Gvalues, inputLine+79, 18);
-	Nread += sscanf(Gvalues, "%lf %lf %lf", &Grad, &GStark, &GvdWaals);
-
-	if (GStark != 0.0) 
-	  rlk->GStark = POW10(GStark) * CUBE(CM_TO_M);
-	else
-	  rlk->GStark = 0.0;
-
-	if (GvdWaals != 0.0)
-	  rlk->GvdWaals = POW10(GvdWaals) * CUBE(CM_TO_M);
-	else
-	  rlk->GvdWaals = 0.0;
-
-        /* --- If possible use Barklem formalism --    -------------- */
-
-	useBarklem = FALSE;
-	if (determined) {
-	  if ((rlk->li == S_ORBIT && rlk->lj == P_ORBIT) ||
-              (rlk->li == P_ORBIT && rlk->lj == S_ORBIT)) {
-	    useBarklem = getBarklemcross_ac(&bs_SP, rlk);
-	  } else if ((rlk->li == P_ORBIT && rlk->lj == D_ORBIT) ||
-		     (rlk->li == D_ORBIT && rlk->lj == P_ORBIT)) {
-	    useBarklem = getBarklemcross_ac(&bs_PD, rlk);
-	  } else if ((rlk->li == D_ORBIT && rlk->lj == F_ORBIT) ||
-		     (rlk->li == F_ORBIT && rlk->lj == D_ORBIT)) {
-	    useBarklem = getBarklemcross_ac(&bs_DF, rlk);
-	  }
-	}
-	/* --- Else use good old Unsoeld --            -------------- */
-
-        if (!useBarklem) {
-	  getUnsoldcross(rlk);
-	}
-	/* --- Radiative broadening --                 -------------- */
-
-	if (Grad != 0.0) {
-	  rlk->Grad = POW10(Grad);
-	} else {
-
-	  /* --- Just take the Einstein Aji value, but only if either
-                 Stark or vd Waals broadening is in effect -- ------- */     
-
-	  if (GStark != 0.0  || GvdWaals != 0.0)
-	    rlk->Grad = rlk->Aji;
-	  else {
-	    rlk->Grad = 0.0;
-
-            /* --- In this case the line is not polarizable because
-                   there is no way to determine its damping -- ------ */
-
-	    rlk->polarizable = FALSE;
-	  }
-	}
-	/* --- Isotope and hyperfine fractions and slpittings -- ---- */
-
-	Nread += sscanf(inputLine+106, "%d", &rlk->isotope);
-	Nread += sscanf(inputLine+108, "%lf", &rlk->isotope_frac);
-	rlk->isotope_frac = POW10(rlk->isotope_frac);
-	Nread += sscanf(inputLine+117, "%lf", &rlk->hyperfine_frac);
-	rlk->hyperfine_frac = POW10(rlk->hyperfine_frac);
-	Nread += sscanf(inputLine+123, "%5d%5d", &hfs_i, &hfs_j);
-	rlk->hfs_i = ((double) hfs_i) * MILLI * KBOLTZMANN;
-	rlk->hfs_j = ((double) hfs_j) * MILLI * KBOLTZMANN;
-
-	/* --- Effective Lande factors --              -------------- */
-
-	Nread += sscanf(inputLine+143, "%5d%5d", &gL_i, &gL_j);
-	rlk->gL_i = gL_i * MILLI;
-	rlk->gL_j = gL_j * MILLI;
-	if (swap_levels) {
-	  SWAPDOUBLE(rlk->hfs_i, rlk->hfs_j);
-	  SWAPDOUBLE(rlk->gL_i, rlk->gL_j);
-	}
-
-	/*      Nread += sscanf(inputLine+154, "%d", &iso_dl); */
-	iso_dl = 0;
-	rlk->iso_dl = iso_dl * MILLI * ANGSTROM_TO_NM;
-
+	Nread = readKuruczRecord(inputLine, &rec);
 	checkNread(Nread, Nrequired=17, routineName, checkPoint=1);
-	/*
-	printf("  Line: %f (vacuum), %f (air)\n"
-	       " gi, gj: %f, %f\n"
-	       " Ei, Ej: %e, %e\n"
-	       " Aji: %e\n"
-               " Grad, GStark, GvdWaals: %e, %e, %e\n"
-               " VdWaals: %d\n"
-	       " hyperfine_frac, isotope_frac: %f, %f\n"
-	       " cross, alpha: %e, %e\n\n",
-	       rlk->lambda0, lambda_air,
-	       rlk->gi, rlk->gj, rlk->Ei, rlk->Ej, rlk->Aji,
-	       rlk->Grad, rlk->GStark, rlk->GvdWaals,
-               rlk->vdwaals,
-	       rlk->hyperfine_frac, rlk->isotope_frac,
-	       rlk->cross, rlk->alpha);
-	*/
-	rlk++;
+
+	rec.line_index = rlk - (atmos.rlk_lines + atmos.Nrlk);
+	setKuruczLine(rlk++, &rec, list_index, &bs_SP, &bs_PD, &bs_DF);
       }
     }
     fclose(fp_linelist);
@@ -335,6 +369,8 @@ void readKuruczLines(char *inputFile)
   }
 
   fclose(fp_Kurucz);
+  free(lambda_min);
+  free(lambda_max);
 
   free_BS(&bs_SP);
   free_BS(&bs_PD);
@@ -346,17 +382,21 @@ void readKuruczLines(char *inputFile)
  
 int rlk_ascend(const void *v1, const void *v2)
 {
-  double lambda1 = ((RLK_Line *) v1)->lambda0,
-         lambda2 = ((RLK_Line *) v2)->lambda0;
+  RLK_Line *rlk1 = (RLK_Line *) v1, *rlk2 = (RLK_Line *) v2;
 
-  /* --- Used for sorting transitions by wavelength -- -------------- */
+  /* --- Used for sorting transitions by wavelength. Lines of equal
+         wavelength keep the order of the line lists, so that the
+         order does not depend on the sorting algorithm, nor on
+         whether the lines came from an ASCII or a binary list -- --- */
 
-  if (lambda1 < lambda2)
+  if (rlk1->lambda0 < rlk2->lambda0)
     return -1;
-  else if (lambda1 > lambda2)
+  else if (rlk1->lambda0 > rlk2->lambda0)
     return 1;
+  else if (rlk1->list_index != rlk2->list_index)
+    return rlk1->list_index - rlk2->list_index;
   else
-    return 0;
+    return rlk1->line_index - rlk2->line_index;
 }
 /* ------- end ---------------------------- rlk_ascend.c ------------ */
 
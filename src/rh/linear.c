@@ -56,7 +56,7 @@ double BiLinear(int Na, double *a_table, double a,
 		int Nb, double *b_table, double b,
 		double **f, bool_t hunt)
 {
-  static int i = 0, j = 0;
+  static RH_TLS int i = 0, j = 0;
 
   double fa, fb;
 
@@ -31,8 +31,8 @@ void LUbacksubst(int N, double **A, int *index, double *b);
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
-extern MPI_t mpi;
+extern RH_TLS char messageStr[];
+extern RH_TLS MPI_t mpi;
 
 
 /* ------- begin -------------------------- SolveLinearEq.c --------- */
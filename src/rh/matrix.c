@@ -26,7 +26,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern char   messageStr[];
+extern RH_TLS char   messageStr[];
 
 
 /* ------- begin -------------------------- matrix_char.c ----------- */
@@ -23,8 +23,8 @@
 
 /* --- Global variables --                             -------------- */
 
-extern CommandLine commandline;
-extern char messageStr[];
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- MaxChange.c ------------- */
@@ -61,9 +61,9 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
-extern InputData input;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
+extern RH_TLS InputData input;
 
 
 /* ------- begin -------------------------- Metal_bf.c -------------- */
@@ -157,9 +157,9 @@ flags passive_bb(double lambda, int nspect, int mu, bool_t to_obs,
   const char routineName[] = "passive_bb";
   register int k, kr, l, m, nc;
 
-  static bool_t initialize = TRUE;
-  static int Nlist;
-  static struct Linelist *linelist[N_MAX_OVERLAP];
+  static RH_TLS bool_t initialize = TRUE;
+  static RH_TLS int Nlist;
+  static RH_TLS struct Linelist *linelist[N_MAX_OVERLAP];
 
   bool_t   add_to_list, linepresent;
   int      i, j, entry;
@@ -175,7 +175,9 @@ flags passive_bb(double lambda, int nspect, int mu, bool_t to_obs,
  
    Note: A list of lines is maintained to prevent recalculation of
          the damping parameter of the lines for successive wavelengths
-         and angles.
+         and angles. The list is emptied by calling the routine with
+         lambda==0.0, after which it no longer points to the lines
+         of the atoms.
          --                                            -------------- */
 
   backgrflags.hasline     = FALSE;
@@ -186,6 +188,15 @@ flags passive_bb(double lambda, int nspect, int mu, bool_t to_obs,
     Nlist = 0;
     initialize = FALSE;
   }
+  if (lambda == 0.0) {
+    for (l = 0;  l < Nlist;  l++) {
+      if (linelist[l]->adamp) free(linelist[l]->adamp);
+      free(linelist[l]);
+      linelist[l] = NULL;
+    }
+    Nlist = 0;
+    return backgrflags;
+  }
 
   hc     = HPLANCK * CLIGHT;
   fourPI = 4.0 * PI;
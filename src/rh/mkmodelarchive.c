@@ -0,0 +1,56 @@
+/* ------- file: -------------------------- mkmodelarchive.c -------- */
+
+/* --- Pack input data files (model atoms and molecules, the atoms and
+       molecules input files, Barklem tables, abundances, partition
+       functions, Kurucz line lists) into a model archive that is
+       memory mapped at startup (see modelarchive.c).
+
+       Build with "make mkmodelarchive" in this directory, run from
+       the directory the code is run in as
+
+         mkmodelarchive <archive> <file> [file ...]
+
+       with the file names exactly as they appear in the input files,
+       and set keyword MODEL_ARCHIVE to the archive.
+       --                                              -------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rh.h"
+#include "atom.h"
+#include "atmos.h"
+#include "error.h"
+#include "inputs.h"
+
+
+/* --- Function prototypes --                          -------------- */
+
+
+/* --- Global variables --                             -------------- */
+
+RH_TLS CommandLine commandline;
+RH_TLS InputData input;
+RH_TLS char messageStr[MAX_MESSAGE_LENGTH];
+
+
+/* ------- begin -------------------------- mkmodelarchive.c -------- */
+
+int main(int argc, char *argv[])
+{
+  commandline.quiet   = FALSE;
+  commandline.logfile = stderr;
+
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <archive> <file> [file ...]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  writeModelArchive(argv[1], argc - 2, argv + 2);
+
+  sprintf(messageStr, "Wrote %d files to model archive %s\n",
+	  argc - 2, argv[1]);
+  Error(MESSAGE, "mkmodelarchive", messageStr);
+
+  return EXIT_SUCCESS;
+}
+/* ------- end ---------------------------- mkmodelarchive.c -------- */
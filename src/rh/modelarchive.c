@@ -0,0 +1,285 @@
+/* ------- file: -------------------------- modelarchive.c ---------- */
+
+/* --- Archive of input data files.
+
+       At startup every instance of the code opens the atoms and
+       molecules input files, each model atom and molecule, the
+       Barklem tables, the abundances and partition functions and the
+       Kurucz line lists. With many processes this amounts to a storm
+       of small file opens on a shared file system. These files can be
+       packed once with mkmodelarchive (see mkmodelarchive.c) into a
+       single archive named with keyword MODEL_ARCHIVE, which is memory
+       mapped read-only, once per process, and shared by all processes
+       on a node. Files in the archive are found by the name with which
+       they were packed, so these should be given exactly as they appear
+       in the input files. Files that are not in the archive are read
+       from disk as before.
+
+       Layout of the archive: a ModelArchiveHeader, Nfile
+       ModelArchiveEntry structures sorted by name, and the contents of
+       the files, each followed by a NUL character and starting at a
+       multiple of 8 bytes.
+       --                                              -------------- */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rh.h"
+#include "atom.h"
+#include "atmos.h"
+#include "inputs.h"
+#include "error.h"
+#include "readAtomFile.h"
+
+
+#define MODEL_ARCHIVE_MAGIC    "RHMODARC"
+#define MODEL_ARCHIVE_VERSION  1
+
+typedef struct {
+  char   magic[8];
+  int    version, entry_size, Nfile;
+  long   size;
+} ModelArchiveHeader;
+
+typedef struct {
+  char   name[MAX_VALUE_LENGTH];
+  long   offset, size;
+} ModelArchiveEntry;
+
+typedef struct ModelArchive {
+  char   name[MAX_VALUE_LENGTH];
+  void  *map;
+  size_t size;
+  int    Nfile;
+  ModelArchiveEntry *entry;
+  struct ModelArchive *next;
+} ModelArchive;
+
+
+/* --- Function prototypes --                          -------------- */
+
+
+/* --- Global variables --                             -------------- */
+
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
+
+/* --- Archives are mapped once for the whole process, and stay
+       mapped until it exits --                        -------------- */
+
+static ModelArchive   *archives = NULL;
+static pthread_mutex_t archive_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* ------- begin -------------------------- entry_ascend.c ---------- */
+
+static int entry_ascend(const void *v1, const void *v2)
+{
+  return strcmp(((ModelArchiveEntry *) v1)->name,
+		((ModelArchiveEntry *) v2)->name);
+}
+/* ------- end ---------------------------- entry_ascend.c ---------- */
+
+/* ------- begin -------------------------- mapModelArchive.c ------- */
+
+static ModelArchive *mapModelArchive(char *archiveName)
+{
+  const char routineName[] = "mapModelArchive";
+
+  int    fd;
+  struct stat st;
+  ModelArchive *archive;
+  ModelArchiveHeader *header;
+
+  /* --- Return the archive archiveName, mapping it on first use.
+         Has to be called with archive_lock held --    -------------- */
+
+  for (archive = archives;  archive != NULL;  archive = archive->next)
+    if (!strcmp(archive->name, archiveName)) return archive;
+
+  if ((fd = open(archiveName, O_RDONLY)) < 0 || fstat(fd, &st) ||
+      st.st_size < (off_t) sizeof(ModelArchiveHeader)) {
+    sprintf(messageStr, "Unable to open model archive %s", archiveName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  archive = (ModelArchive *) malloc(sizeof(ModelArchive));
+  strcpy(archive->name, archiveName);
+  archive->size = st.st_size;
+  archive->map  = mmap(NULL, archive->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (archive->map == MAP_FAILED) {
+    sprintf(messageStr, "Unable to map model archive %s", archiveName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  header = (ModelArchiveHeader *) archive->map;
+  if (memcmp(header->magic, MODEL_ARCHIVE_MAGIC, sizeof(header->magic)) ||
+      header->version != MODEL_ARCHIVE_VERSION ||
+      header->entry_size != sizeof(ModelArchiveEntry) ||
+      header->size != (long) archive->size) {
+    sprintf(messageStr,
+	    "File %s is not a model archive for this version of the code,\n"
+	    " pack the input files again with mkmodelarchive", archiveName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  archive->Nfile = header->Nfile;
+  archive->entry = (ModelArchiveEntry *)
+    ((char *) archive->map + sizeof(ModelArchiveHeader));
+
+  archive->next = archives;
+  archives = archive;
+
+  sprintf(messageStr, " -- mapped %d files from model archive %s\n",
+	  archive->Nfile, archiveName);
+  Error(MESSAGE, routineName, messageStr);
+
+  return archive;
+}
+/* ------- end ---------------------------- mapModelArchive.c ------- */
+
+/* ------- begin -------------------------- getModelFile.c ---------- */
+
+char *getModelFile(char *fileName, size_t *size)
+{
+  ModelArchive *archive;
+  ModelArchiveEntry key, *entry;
+
+  /* --- Contents of fileName in the model archive, or NULL when
+         there is no archive or the file is not in it -- ------------ */
+
+  if (input.model_archive[0] == '\0' ||
+      !strcmp(input.model_archive, "none") ||
+      strlen(fileName) >= MAX_VALUE_LENGTH) return NULL;
+
+  pthread_mutex_lock(&archive_lock);
+  archive = mapModelArchive(input.model_archive);
+  pthread_mutex_unlock(&archive_lock);
+
+  strcpy(key.name, fileName);
+  entry = (ModelArchiveEntry *) bsearch(&key, archive->entry, archive->Nfile,
+					sizeof(ModelArchiveEntry),
+					entry_ascend);
+  if (entry == NULL) return NULL;
+
+  *size = entry->size;
+  return (char *) archive->map + entry->offset;
+}
+/* ------- end ---------------------------- getModelFile.c ---------- */
+
+/* ------- begin -------------------------- openModelFile.c --------- */
+
+FILE *openModelFile(char *fileName)
+{
+  char  *data;
+  size_t size;
+
+  /* --- Open input file fileName for reading, from the model archive
+         if it is there. Returns NULL if the file cannot be opened -- */
+
+  if ((data = getModelFile(fileName, &size)) != NULL  &&  size > 0)
+    return fmemopen(data, size, "r");
+  else
+    return fopen(fileName, "r");
+}
+/* ------- end ---------------------------- openModelFile.c --------- */
+
+/* ------- begin -------------------------- writeModelArchive.c ----- */
+
+void writeModelArchive(char *archiveName, int Nfile, char **fileNames)
+{
+  const char routineName[] = "writeModelArchive";
+  register int n;
+
+  char  *tmpName, *buffer;
+  long   offset;
+  FILE  *fp_archive, *fp_in;
+  ModelArchiveHeader header;
+  ModelArchiveEntry *entry;
+
+  /* --- Pack the files fileNames into archive archiveName, under the
+         names as given. The archive is written under a temporary name
+         and renamed when complete, so that readers never see a
+         partial file --                               -------------- */
+
+  entry = (ModelArchiveEntry *) calloc(Nfile, sizeof(ModelArchiveEntry));
+  for (n = 0;  n < Nfile;  n++) {
+    if (strlen(fileNames[n]) >= MAX_VALUE_LENGTH) {
+      sprintf(messageStr, "File name too long: %s", fileNames[n]);
+      Error(ERROR_LEVEL_2, routineName, messageStr);
+    }
+    strcpy(entry[n].name, fileNames[n]);
+  }
+  qsort(entry, Nfile, sizeof(ModelArchiveEntry), entry_ascend);
+
+  for (n = 1;  n < Nfile;  n++) {
+    if (!strcmp(entry[n].name, entry[n-1].name)) {
+      sprintf(messageStr, "File %s is given twice", entry[n].name);
+      Error(ERROR_LEVEL_2, routineName, messageStr);
+    }
+  }
+  /* --- Sizes and offsets of the files --             -------------- */
+
+  offset = sizeof(ModelArchiveHeader) + Nfile * sizeof(ModelArchiveEntry);
+  for (n = 0;  n < Nfile;  n++) {
+    if ((fp_in = fopen(entry[n].name, "r")) == NULL) {
+      sprintf(messageStr, "Unable to open input file %s", entry[n].name);
+      Error(ERROR_LEVEL_2, routineName, messageStr);
+    }
+    fseek(fp_in, 0, SEEK_END);
+    entry[n].size = ftell(fp_in);
+    fclose(fp_in);
+
+    /* --- Keep the contents aligned for binary files --  ----------- */
+
+    offset = (offset + sizeof(double) - 1) & ~((long) sizeof(double) - 1);
+    entry[n].offset = offset;
+    offset += entry[n].size + 1;
+  }
+  memset(&header, 0, sizeof(ModelArchiveHeader));
+  memcpy(header.magic, MODEL_ARCHIVE_MAGIC, sizeof(header.magic));
+  header.version    = MODEL_ARCHIVE_VERSION;
+  header.entry_size = sizeof(ModelArchiveEntry);
+  header.Nfile      = Nfile;
+  header.size       = offset;
+
+  tmpName = (char *) malloc(strlen(archiveName) + 16);
+  sprintf(tmpName, "%s.%d", archiveName, (int) getpid());
+  if ((fp_archive = fopen(tmpName, "wb")) == NULL) {
+    sprintf(messageStr, "Unable to open output file %s", tmpName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  fwrite(&header, sizeof(ModelArchiveHeader), 1, fp_archive);
+  fwrite(entry, sizeof(ModelArchiveEntry), Nfile, fp_archive);
+
+  for (n = 0;  n < Nfile;  n++) {
+    buffer = (char *) calloc(entry[n].size + 1, sizeof(char));
+    fp_in  = fopen(entry[n].name, "r");
+    if (fread(buffer, sizeof(char), entry[n].size, fp_in) !=
+	(size_t) entry[n].size) {
+      sprintf(messageStr, "Unable to read input file %s", entry[n].name);
+      Error(ERROR_LEVEL_2, routineName, messageStr);
+    }
+    fclose(fp_in);
+    fseek(fp_archive, entry[n].offset, SEEK_SET);
+    fwrite(buffer, sizeof(char), entry[n].size + 1, fp_archive);
+    free(buffer);
+  }
+  if (ferror(fp_archive)) {
+    sprintf(messageStr, "Unable to write to output file %s", tmpName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  fclose(fp_archive);
+
+  if (rename(tmpName, archiveName)) {
+    sprintf(messageStr, "Unable to rename %s to %s", tmpName, archiveName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  free(tmpName);
+  free(entry);
+}
+/* ------- end ---------------------------- writeModelArchive.c ----- */
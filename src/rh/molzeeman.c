@@ -28,7 +28,7 @@ double MolLande_b(double Lambda, double S, double N, double J);
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- MolZeemanStr.c ---------- */
@@ -22,7 +22,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
+extern RH_TLS Atmosphere atmos;
 
 
 /* ------- begin -------------------------- neMetals.c -------------- */
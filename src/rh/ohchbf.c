@@ -41,8 +41,8 @@ double bilinear(int Ncol, int Nrow, double *f, double x, double y);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- OH_bf_opac.c ------------ */
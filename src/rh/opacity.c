@@ -53,10 +53,10 @@ double MolProfile(MolecularLine *mrt, int k, int mu, bool_t to_obs,
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- Opacity.c --------------- */
@@ -71,7 +71,7 @@ void Opacity(int nspect, int mu, bool_t to_obs, bool_t initialize)
     *n_i, *n_j, Bijxhc_4PI, wlambda, chi_l, *chi_Q, *chi_U, *chi_V,
      eta_l, *eta_Q, *eta_U, *eta_V, *chip_Q, *chip_U, *chip_V,
     *phi_Q, *phi_U, *phi_V, *psi_Q, *psi_U, *psi_V;
-  bool_t  solveStokes;
+  bool_t  solveStokes, stored;
   double lag, rho_int, *rho_tmp, sign;
 
   
@@ -96,6 +96,11 @@ void Opacity(int nspect, int mu, bool_t to_obs, bool_t initialize)
   as = &spectrum.as[nspect];
   nt = nspect % input.Nthreads;
 
+  /* --- Line profiles are read with readProfile when they are not
+         kept in line->phi (see profile.c) --          -------------- */
+
+  stored = (input.limit_memory || input.profile_single);
+
   /* --- If polarized transition is present and we solve for polarized
          radiation we need to fill all four Stokes components -- ---- */
 
@@ -154,7 +159,7 @@ void Opacity(int nspect, int mu, bool_t to_obs, bool_t initialize)
 
         /* --- Required size of temporary profile array -- ---------- */
 
-	if (input.limit_memory) {
+	if (stored) {
 	  if (solveStokes)
 	    Nrecphi = (input.magneto_optical) ? 7 : 4;
 	  else
@@ -167,7 +172,7 @@ void Opacity(int nspect, int mu, bool_t to_obs, bool_t initialize)
 	if (atmos.moving || solveStokes) {
 	  lamu = 2*(atmos.Nrays*la + mu) + to_obs;
 
-	  if (input.limit_memory) {
+	  if (stored) {
 	    readProfile(line, lamu, phi);
 	    if (solveStokes) {
 	      phi_Q = phi + atmos.Nspace;
@@ -196,7 +201,7 @@ void Opacity(int nspect, int mu, bool_t to_obs, bool_t initialize)
 	    }
 	  }
 	} else {
-	  if (input.limit_memory)
+	  if (stored)
 	    readProfile(line, la, phi);
 	  else
 	    phi = line->phi[la];
@@ -348,7 +353,7 @@ void Opacity(int nspect, int mu, bool_t to_obs, bool_t initialize)
 	  }
 	}
       }
-      if (as->art[nact][n].type == ATOMIC_LINE && input.limit_memory)
+      if (as->art[nact][n].type == ATOMIC_LINE && stored)
 	free(phi);
     }
   }
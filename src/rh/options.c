@@ -28,8 +28,8 @@
 
 /* --- Global variables --                             -------------- */
 
-extern CommandLine commandline;
-extern char messageStr[];
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
 
 
 
@@ -39,7 +39,7 @@ extern char messageStr[];
 void setOptions(int argc, char *argv[], int iproc, int quiet)
 {
   const  char routineName[] = "setOptions";
-  static char logfileName[MAX_LINE_SIZE], wavetable[MAX_LINE_SIZE];
+  static RH_TLS char logfileName[MAX_LINE_SIZE], wavetable[MAX_LINE_SIZE];
     
   int Noption;
   
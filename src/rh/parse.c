@@ -21,7 +21,7 @@ void ShowUsage(char *programName, int Noption, Option *theOptions);
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- parse.c ----------------- */
@@ -38,7 +38,7 @@ void   Paschen(double L, double S, double *E0, double B,
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 /* ------- begin -------------------------- Paschen_Back.c ---------- */
 
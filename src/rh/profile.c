@@ -19,7 +19,9 @@
  Note: If the option input.limit_memory is set profiles are written
        to file for each line seperately. This prevents huge memory
        allocations in the case of multi-dimensional geometry, at the
-       cost of more I/O overhead.
+       cost of more I/O overhead. With input.profile_single they are
+       instead kept in memory in single precision, which halves the
+       memory without the I/O.
 
        Naming convention for the profile functions (see for instance
        J. Stenflo 1994, in "Solar Magnetic Fields", p. 108 & 115):
@@ -58,9 +60,9 @@ void freeZeeman(ZeemanMultiplet *zm);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- Profile.c --------------- */
@@ -71,11 +73,14 @@ void Profile(AtomicLine *line)
   register int la, k, mu, n, to_obs, nz;
 
   char    filename[MAX_LINE_SIZE];
-  int     lamu, Nlamu, NrecStokes;
-  double *adamp = NULL, **v, **v_los, *vB, *sv, *vbroad, Larmor, H, F,
-          wlamu, vk, phi_pi, phi_sm, phi_sp, phi_delta, phi_sigma,
-          psi_pi, psi_sm, psi_sp, psi_delta, psi_sigma, sign, sin2_gamma,
-         *phi, *phi_Q, *phi_U, *phi_V, *psi_Q, *psi_U, *psi_V;
+  int     lamu, Nlamu, NrecStokes = 1;
+  double *adamp = NULL, **v, **v_los, *vB, *sv, *vbroad, Larmor, *H, *F,
+          wlamu, *vk, *phi_pi, *phi_sm, *phi_sp, phi_delta, phi_sigma,
+         *psi_pi, *psi_sm, *psi_sp, psi_delta, psi_sigma, sign, sin2_gamma,
+         *phi, *phi_Q, *phi_U, *phi_V, *psi_Q, *psi_U, *psi_V, *voigt;
+
+  bool_t  stored;
+  enum VoigtAlgorithm algorithm_pol, algorithm;
 
   Atom *atom = line->atom;
   ZeemanMultiplet *zm;
@@ -129,18 +134,14 @@ void Profile(AtomicLine *line)
     Error(MESSAGE, routineName, messageStr);
   }
 
-  /* --- Initialize permanent storage for line profiles -- ---------- */
+  /* --- Initialize permanent storage for line profiles. With
+         input.limit_memory or input.profile_single the profiles are
+         computed in a temporary array and stored per wavelength with
+         writeProfile (see readj.c) --                 -------------- */
 
-  if (input.limit_memory) {
-    sprintf(filename, (atom->ID[1] == ' ') ?
-	    "profile.%.1s_%d-%d.dat" : "profile.%.2s_%d-%d.dat", atom->ID,
-	    line->j, line->i);
-    if ((line->fd_profile =
-	 open(filename, O_RDWR | O_CREAT, PERMISSIONS)) == -1) {
-      sprintf(messageStr, "Unable to open profile file %s", filename);
-      Error(ERROR_LEVEL_2, routineName, messageStr);
-    }
+  stored = (input.limit_memory || input.profile_single);
 
+  if (stored) {
     if (line->polarizable && (input.StokesMode > FIELD_FREE)) {
       NrecStokes = (input.magneto_optical) ? 7 : 4;
       phi = (double *) calloc(NrecStokes*atmos.Nspace, sizeof(double));
@@ -160,6 +161,26 @@ void Profile(AtomicLine *line)
       NrecStokes = 1;
       phi = (double *) calloc(atmos.Nspace, sizeof(double));
     }
+    /* --- Profiles are either kept in memory in single precision,
+           or written to a file per line --           -------------- */
+
+    if (input.profile_single) {
+      Nlamu = (atmos.moving ||
+	       (line->polarizable && (input.StokesMode > FIELD_FREE))) ?
+	2*atmos.Nrays*line->Nlambda : line->Nlambda;
+      line->phi_single = (float *)
+	realloc(line->phi_single,
+		(size_t) NrecStokes*Nlamu*atmos.Nspace * sizeof(float));
+    } else if (line->fd_profile < 0) {
+      sprintf(filename, (atom->ID[1] == ' ') ?
+	      "profile.%.1s_%d-%d.dat" : "profile.%.2s_%d-%d.dat", atom->ID,
+	      line->j, line->i);
+      if ((line->fd_profile =
+	   open(filename, O_RDWR | O_CREAT, PERMISSIONS)) == -1) {
+	sprintf(messageStr, "Unable to open profile file %s", filename);
+	Error(ERROR_LEVEL_2, routineName, messageStr);
+      }
+    }
   } else {
     if (atmos.moving || 
 	(line->polarizable && (input.StokesMode > FIELD_FREE))) {
@@ -210,6 +231,29 @@ void Profile(AtomicLine *line)
     }
   }
 
+  /* --- The Voigt and Faraday-Voigt functions are evaluated for all
+         depths at once. Either with Humlicek's (polarized) and
+         Armstrong's (unpolarized) approximations or with the lookup
+         table (see voigt.c) --                        -------------- */
+
+  if (input.Voigt_lookup) {
+    VoigtLookupAccuracy(input.Voigt_accuracy);
+    algorithm_pol = algorithm = LOOKUP;
+  } else {
+    algorithm_pol = HUMLICEK;
+    algorithm     = ARMSTRONG;
+  }
+  voigt = (double *) malloc(9*atmos.Nspace * sizeof(double));
+  vk = voigt;
+  H  = voigt + atmos.Nspace;
+  F  = voigt + 2*atmos.Nspace;
+  phi_pi = voigt + 3*atmos.Nspace;
+  phi_sm = voigt + 4*atmos.Nspace;
+  phi_sp = voigt + 5*atmos.Nspace;
+  psi_pi = voigt + 6*atmos.Nspace;
+  psi_sm = voigt + 7*atmos.Nspace;
+  psi_sp = voigt + 8*atmos.Nspace;
+
   /* --- Calculate the absorption profile and store for each line -- */
   if (atmos.moving ||
       (line->polarizable && (input.StokesMode > FIELD_FREE))) {
@@ -241,7 +285,7 @@ void Profile(AtomicLine *line)
 	     option. In the normal case the call matrix_double
 	     initializes the whole array to zero -- ------------- */
 
-	  if (input.limit_memory) {
+	  if (stored) {
 	    for (k = 0;  k< NrecStokes*atmos.Nspace;  k++) phi[k] = 0.0;
 	  } else {
 	    phi = line->phi[lamu];
@@ -259,47 +303,56 @@ void Profile(AtomicLine *line)
 	  }
 
 	  if (line->polarizable && (input.StokesMode > FIELD_FREE)) {
-	    for (k = 0;  k < atmos.Nspace;  k++) {
-	      sin2_gamma = 1.0 - SQ(atmos.cos_gamma[mu][k]);
-
-	      /* --- For the sign conventions to the phi and psi
-		 contributions depending on the direction along the ray
-
-		 See:
-		 -- A. van Ballegooijen: "Radiation in Strong Magnetic
-		    Fields", in Numerical Radiative Transfer, W. Kalkofen
-		    1987, p. 285 --                    -------------- */
-            
-              /* --- Sum over isotopes --              -------------- */
-
-	      for (n = 0;  n < line->Ncomponent;  n++) {
-		vk = v[k][n] + sign * v_los[mu][k];
-
-		phi_sm = phi_pi = phi_sp = 0.0;
-		psi_sm = psi_pi = psi_sp = 0.0;
-
-                /* --- Sum over Zeeman sub-levels --   -------------- */
-
-		for (nz = 0;  nz < zm->Ncomponent;  nz++) {
-		  H = Voigt(adamp[k], vk - zm->shift[nz]*vB[k],
-			    &F, HUMLICEK);
-
-		  switch (zm->q[nz]) {
-		  case -1:
-		    phi_sm += zm->strength[nz] * H;
-		    psi_sm += zm->strength[nz] * F;
-		    break;
-		  case  0:
-		    phi_pi += zm->strength[nz] * H;
-		    psi_pi += zm->strength[nz] * F;
-		    break;
-		  case  1:
-		    phi_sp += zm->strength[nz] * H;
-		    psi_sp += zm->strength[nz] * F;
+
+	    /* --- For the sign conventions to the phi and psi
+	       contributions depending on the direction along the ray
+
+	       See:
+	       -- A. van Ballegooijen: "Radiation in Strong Magnetic
+	          Fields", in Numerical Radiative Transfer, W. Kalkofen
+	          1987, p. 285 --                      -------------- */
+
+            /* --- Sum over isotopes --                -------------- */
+
+	    for (n = 0;  n < line->Ncomponent;  n++) {
+	      for (k = 0;  k < atmos.Nspace;  k++) {
+		phi_sm[k] = phi_pi[k] = phi_sp[k] = 0.0;
+		psi_sm[k] = psi_pi[k] = psi_sp[k] = 0.0;
+	      }
+	      /* --- Sum over Zeeman sub-levels --     -------------- */
+
+	      for (nz = 0;  nz < zm->Ncomponent;  nz++) {
+		for (k = 0;  k < atmos.Nspace;  k++)
+		  vk[k] = v[k][n] + sign * v_los[mu][k] -
+		    zm->shift[nz]*vB[k];
+		VoigtArray(atmos.Nspace, adamp, vk, H, F, algorithm_pol);
+
+		switch (zm->q[nz]) {
+		case -1:
+		  for (k = 0;  k < atmos.Nspace;  k++) {
+		    phi_sm[k] += zm->strength[nz] * H[k];
+		    psi_sm[k] += zm->strength[nz] * F[k];
+		  }
+		  break;
+		case  0:
+		  for (k = 0;  k < atmos.Nspace;  k++) {
+		    phi_pi[k] += zm->strength[nz] * H[k];
+		    psi_pi[k] += zm->strength[nz] * F[k];
+		  }
+		  break;
+		case  1:
+		  for (k = 0;  k < atmos.Nspace;  k++) {
+		    phi_sp[k] += zm->strength[nz] * H[k];
+		    psi_sp[k] += zm->strength[nz] * F[k];
 		  }
 		}
-		phi_sigma = (phi_sp + phi_sm) * line->c_fraction[n];
-		phi_delta = 0.5*phi_pi * line->c_fraction[n] - 0.25*phi_sigma;
+	      }
+	      for (k = 0;  k < atmos.Nspace;  k++) {
+		sin2_gamma = 1.0 - SQ(atmos.cos_gamma[mu][k]);
+
+		phi_sigma = (phi_sp[k] + phi_sm[k]) * line->c_fraction[n];
+		phi_delta = 0.5*phi_pi[k] * line->c_fraction[n] -
+		  0.25*phi_sigma;
 
 		phi[k]   += (phi_delta*sin2_gamma + 0.5*phi_sigma) * sv[k];
 		phi_Q[k] += sign *
@@ -307,38 +360,42 @@ void Profile(AtomicLine *line)
 		phi_U[k] +=
 		  phi_delta * sin2_gamma * atmos.sin_2chi[mu][k] * sv[k];
 		phi_V[k] += sign *
-		  0.5*(phi_sp - phi_sm) * atmos.cos_gamma[mu][k] * sv[k];
+		  0.5*(phi_sp[k] - phi_sm[k]) * atmos.cos_gamma[mu][k] * sv[k];
 
 		if (input.magneto_optical) {
-		  psi_sigma = (psi_sp + psi_sm) * line->c_fraction[n];
-		  psi_delta = 0.5*psi_pi * line->c_fraction[n] -
+		  psi_sigma = (psi_sp[k] + psi_sm[k]) * line->c_fraction[n];
+		  psi_delta = 0.5*psi_pi[k] * line->c_fraction[n] -
 		    0.25*psi_sigma;
 
 		  psi_Q[k] += sign *
 		    psi_delta * sin2_gamma * atmos.cos_2chi[mu][k] * sv[k];
 		  psi_U[k] +=
 		    psi_delta * sin2_gamma * atmos.sin_2chi[mu][k] * sv[k];
-		  psi_V[k] += sign *
-		    0.5 * (psi_sp - psi_sm) * atmos.cos_gamma[mu][k] * sv[k];
+		  psi_V[k] += sign * 0.5 * (psi_sp[k] - psi_sm[k]) *
+		    atmos.cos_gamma[mu][k] * sv[k];
 		}
 	      }
-              /* --- Ensure proper normalization of the profile -- -- */
-  
-	      line->wphi[k] += wlamu * phi[k];
 	    }
+	    /* --- Ensure proper normalization of the profile -- ---- */
+
+	    for (k = 0;  k < atmos.Nspace;  k++)
+	      line->wphi[k] += wlamu * phi[k];
 	  } else {
 	    /* --- Field-free case --                  -------------- */
-            for (k = 0;  k < atmos.Nspace;  k++) {
-	      for (n = 0;  n < line->Ncomponent;  n++) {
-		vk = v[k][n] + sign * v_los[mu][k];
-	    
-		phi[k] += Voigt(adamp[k], vk, NULL, ARMSTRONG) *
-		  line->c_fraction[n] / (SQRTPI * atom->vbroad[k]);
-	      }
-	      line->wphi[k] += phi[k] * wlamu;
+
+	    for (n = 0;  n < line->Ncomponent;  n++) {
+	      for (k = 0;  k < atmos.Nspace;  k++)
+		vk[k] = v[k][n] + sign * v_los[mu][k];
+	      VoigtArray(atmos.Nspace, adamp, vk, H, NULL, algorithm);
+
+	      for (k = 0;  k < atmos.Nspace;  k++)
+		phi[k] += H[k] * line->c_fraction[n] /
+		  (SQRTPI * atom->vbroad[k]);
 	    }
+	    for (k = 0;  k < atmos.Nspace;  k++)
+	      line->wphi[k] += phi[k] * wlamu;
 	  }
-	  if (input.limit_memory) writeProfile(line, lamu, phi);
+	  if (stored) writeProfile(line, lamu, phi);
 	}
       }
     }
@@ -348,21 +405,23 @@ void Profile(AtomicLine *line)
 
     for (la = 0;  la < line->Nlambda;  la++) {
       wlamu = getwlambda_line(line, la);
-      if (input.limit_memory)
+      if (stored)
 	for (k = 0;  k < atmos.Nspace;  k++) phi[k] = 0.0;
       else
 	phi = line->phi[la];
       
-      for (k = 0;  k < atmos.Nspace;  k++) {
-	for (n = 0;  n < line->Ncomponent;  n++) {
-	  vk = (line->lambda[la] - line->lambda0 - line->c_shift[n]) *
+      for (n = 0;  n < line->Ncomponent;  n++) {
+	for (k = 0;  k < atmos.Nspace;  k++)
+	  vk[k] = (line->lambda[la] - line->lambda0 - line->c_shift[n]) *
 	    CLIGHT / (line->lambda0 * atom->vbroad[k]);
-	  phi[k] += Voigt(adamp[k], vk, NULL, ARMSTRONG) *
-	    line->c_fraction[n] / (SQRTPI * atom->vbroad[k]);
-	}
-	line->wphi[k] += phi[k] * wlamu;
+	VoigtArray(atmos.Nspace, adamp, vk, H, NULL, algorithm);
+
+	for (k = 0;  k < atmos.Nspace;  k++)
+	  phi[k] += H[k] * line->c_fraction[n] / (SQRTPI * atom->vbroad[k]);
       }
-      if (input.limit_memory) writeProfile(line, la, phi);
+      for (k = 0;  k < atmos.Nspace;  k++)
+	line->wphi[k] += phi[k] * wlamu;
+      if (stored) writeProfile(line, la, phi);
     }
   }
   /* --- Store the inverse of the profile normalization -- ---------- */
@@ -372,7 +431,8 @@ void Profile(AtomicLine *line)
   /* --- Clean up --                                     ------------ */
 
   free(adamp);
-  if (input.limit_memory) free(phi);
+  free(voigt);
+  if (stored) free(phi);
 
 
   if(atmos.moving || (line->polarizable && (input.StokesMode > FIELD_FREE))){
@@ -26,9 +26,9 @@ bool_t xdr_radrate(XDR *xdrs, Atom *atom);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- writeRadRate.c - -------- */
@@ -74,16 +74,30 @@ char** readAtomFile(char* const fname_in, const char com, int remove_empty)
 {
   static std::string const nu = "\0";
   std::string const fname = string(fname_in);  
-  bool exists = file_exists_bool(fname);
-  if(!exists) fprintf(stderr,"error: readAtomFile: cannot open file [%s]\n", fname.c_str());
+
+  // --- Take the file from the model archive if it is there,
+  // --- otherwise from disk
+
+  size_t size = 0;
+  char const* data = getModelFile(fname_in, &size);
+  std::istringstream sin;
+  std::ifstream fin;
+  std::istream *in = &sin;
+  
+  if(data) sin.str(std::string(data, size));
+  else{
+    bool exists = file_exists_bool(fname);
+    if(!exists) fprintf(stderr,"error: readAtomFile: cannot open file [%s]\n", fname.c_str());
+    fin.open(fname.c_str(), std::ios::in | std::ios::binary);
+    in = &fin;
+  }
   
-  std::ifstream in(fname.c_str(), std::ios::in | std::ios::binary);
   std::vector<std::string> res;
   std::string line, com1(" ");
   com1.assign(1, com);
   
-  if(in){
-    while(std::getline(in, line)){
+  if(*in){
+    while(std::getline(*in, line)){
       if(remove_empty) if((line == "") || (line == " ")) continue;
       if(line[0] != com) res.push_back(cleanLine(line,com1,false)+nu);
     }
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 char** readAtomFile(char* const fname_in, const char com, int remove_empty);
+char*  getModelFile(char *fileName, size_t *size);
     
 #ifdef __cplusplus
 }
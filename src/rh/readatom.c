@@ -29,6 +29,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "rh.h"
 #include "atom.h"
@@ -52,11 +53,11 @@ char *getAtomID(char *atom_file);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern CommandLine commandline;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- readAtom.c -------------- */
@@ -549,7 +550,7 @@ void readAtom(Atom *atom, char *atom_file, bool_t active)
 
     /* --- Allocate space for thread dependent quantities -- -------- */
 
-    atom->rhth = (rhthread *) malloc(input.Nthreads * sizeof(rhthread));
+    atom->rhth = (rhthread *) calloc(input.Nthreads, sizeof(rhthread));
 
     /* --- Store the offset to allow pointing back to the start of the
            collisional data in the atomic input file, and allocate
@@ -615,6 +616,7 @@ void initAtom(Atom *atom)
   atom->abundance = atom->weight = 0.0;
   atom->g = atom->E = atom->vbroad = NULL;
   atom->C = NULL;
+  atom->coll = NULL;
   atom->n = atom->nstar = NULL;
   atom->ntotal = NULL;
   atom->Gamma = NULL;
@@ -644,6 +646,7 @@ void initAtomicLine(AtomicLine *line)
   line->vdWaals = UNSOLD;
   line->i = line->j = line->Nlambda = line->Nblue = 0;
   line->Ncomponent = 1;
+  line->fd_profile = -1;
   line->Nxrd = 0;
   line->lambda0 = line->isotope_frac = line->g_Lande_eff = 0.0;
   line->lambda = NULL;
@@ -657,7 +660,11 @@ void initAtomicLine(AtomicLine *line)
   line->qwing = line->qcore = 0.0;
   line->c_shift = line->c_fraction = NULL;
   line->rho_prd = NULL;
+  line->phi_single = NULL;
   line->fp_GII = NULL;
+  line->GII.single = FALSE;
+  line->GII.N = line->GII.Nalloc = line->GII.pos = 0;
+  line->GII.data = NULL;
   line->Ng_prd = NULL;
   line->atom = NULL;
   line->xrd = NULL;
@@ -693,17 +700,21 @@ void initAtomicContinuum(AtomicContinuum *continuum)
 
 void freeAtom(Atom *atom)
 {
-  register int kr;
+  register int kr, i;
 
   /* --- Free allocated memory for atomic data structure -- --------- */
 
-  if (atom->label != NULL)       freeMatrix((void **) atom->label);
+  if (atom->label != NULL) {
+    for (i = 0;  i < atom->Nlevel;  i++) free(atom->label[i]);
+    free(atom->label);
+  }
   if (atom->popsinFile != NULL)  free(atom->popsinFile);
   if (atom->popsoutFile != NULL) free(atom->popsoutFile);
   if (atom->stage != NULL)       free(atom->stage);
   if (atom->g != NULL)           free(atom->g);
   if (atom->E != NULL)           free(atom->E);
   if (atom->C != NULL)           freeMatrix((void **) atom->C);
+  freeCollisions(atom);
   if (atom->vbroad != NULL)      free(atom->vbroad);
 
   /* --- Be careful here because atom->n points to atom->nstar in
@@ -756,7 +767,10 @@ void freeAtomicLine(AtomicLine *line)
   if (line->wphi != NULL)    free(line->wphi);
   if (line->Qelast != NULL)  free(line->Qelast);
   if (line->rho_prd != NULL) freeMatrix((void **) line->rho_prd);
-  if (line->fp_GII != NULL)  free(line->fp_GII);
+  if (line->fd_profile >= 0)  close(line->fd_profile);
+  if (line->phi_single != NULL) free(line->phi_single);
+  if (line->fp_GII != NULL)   fclose(line->fp_GII);
+  if (line->GII.data != NULL) free(line->GII.data);
 }
 /* ------- end ---------------------------- freeAtomicLine.c -------- */
 
@@ -794,7 +808,7 @@ void readAtomicModels(void)
 
   /* --- Open input file for atomic models --          -------------- */
 
-  if ((fp_atoms = fopen(input.atoms_input, "r")) == NULL) {
+  if ((fp_atoms = openModelFile(input.atoms_input)) == NULL) {
     sprintf(messageStr, "Unable to open input file %s",
 	    input.atoms_input);
     Error(ERROR_LEVEL_2, routineName, messageStr);
@@ -904,13 +918,13 @@ char *getAtomID(char *atom_file)
 {
   const char routineName[] = "getAtomID";
   register int n;
-  static char atomID[ATOM_ID_WIDTH + 1];
+  static RH_TLS char atomID[ATOM_ID_WIDTH + 1];
 
   char   inputLine[MAX_LINE_SIZE];
   bool_t exit_on_EOF;
   FILE  *fp_atom;
 
-  if ((fp_atom = fopen(atom_file, "r")) == NULL) {
+  if ((fp_atom = openModelFile(atom_file)) == NULL) {
     sprintf(messageStr, "Unable to open inputfile %s", atom_file);
     Error(ERROR_LEVEL_2, routineName, messageStr);
   }
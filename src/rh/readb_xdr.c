@@ -37,8 +37,8 @@
 
 /* --- Global variables --                             -------------- */
 
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- readB.c ----------------- */
@@ -26,12 +26,12 @@
 
 extern enum Topology topology;
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern CommandLine commandline;
-extern ProgramStats stats;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
+extern RH_TLS ProgramStats stats;
+extern RH_TLS char messageStr[];
 
 
 /* --- Function prototypes --                          -------------- */
@@ -42,7 +42,7 @@ extern char messageStr[];
 void readInput()
 {
   const char routineName[] = "readInput";
-  static char atom_input[MAX_VALUE_LENGTH], molecule_input[MAX_VALUE_LENGTH];
+  static RH_TLS char atom_input[MAX_VALUE_LENGTH], molecule_input[MAX_VALUE_LENGTH];
 
   int   Nkeyword;
   FILE *fp_keyword;
@@ -84,6 +84,8 @@ void readInput()
      setintValue},
     {"NG_MOLECULES", "FALSE", FALSE, KEYWORD_DEFAULT, &input.accelerate_mols,
      setboolValue},
+    {"NG_METHOD", "NG", FALSE, KEYWORD_DEFAULT, &input.Ng_method,
+     setNgMethod},
     {"PRD_N_MAX_ITER", "3", FALSE, KEYWORD_OPTIONAL, &input.PRD_NmaxIter,
      setintValue},
     {"PRD_ITER_LIMIT", "1.0E-2", FALSE, KEYWORD_OPTIONAL, &input.PRDiterLimit,
@@ -121,6 +123,8 @@ void readInput()
      setboolValue},
     {"KURUCZ_PF_DATA", "Atoms/pf_Kurucz.input", FALSE,
      KEYWORD_REQUIRED, &input.pfData, setcharValue},
+    {"MODEL_ARCHIVE", "none", FALSE, KEYWORD_OPTIONAL, &input.model_archive,
+     setcharValue},
     {"SOLVE_NE", "NONE", FALSE, KEYWORD_DEFAULT, &input.solve_ne,
      setnesolution},
     {"OPACITY_FUDGE", "none", FALSE, KEYWORD_OPTIONAL, &input.fudgeData,
@@ -181,6 +185,10 @@ void readInput()
      setboolValue},
     {"N_THREADS", "0", FALSE, KEYWORD_OPTIONAL, &input.Nthreads,
      setThreadValue},
+    {"FORMAL_BATCH", "FALSE", FALSE, KEYWORD_DEFAULT, &input.formal_batch,
+     setboolValue},
+    {"REDUCED_GRID", "FALSE", FALSE, KEYWORD_DEFAULT, &input.reduced_grid,
+     setboolValue},
     {"COLLRAD_SWITCH",     "0.0", FALSE, KEYWORD_OPTIONAL, &input.crsw,
      setdoubleValue},
     {"COLLRAD_SWITCH_INI", "1.0", FALSE, KEYWORD_OPTIONAL, &input.crsw_ini,
@@ -191,6 +199,20 @@ void readInput()
      setdoubleValue},   
     {"LIMIT_MEMORY", "FALSE", FALSE, KEYWORD_DEFAULT, &input.limit_memory,
      setboolValue},
+    {"PROFILE_SINGLE", "FALSE", FALSE, KEYWORD_DEFAULT,
+     &input.profile_single, setboolValue},
+    {"BACKGROUND_SHARE_RAYS", "FALSE", FALSE, KEYWORD_DEFAULT,
+     &input.backgr_share_rays, setboolValue},
+    {"BACKGROUND_SINGLE", "FALSE", FALSE, KEYWORD_DEFAULT,
+     &input.backgr_single, setboolValue},
+    {"PRD_GII_MEM_LIMIT", "0.0", FALSE, KEYWORD_DEFAULT,
+     &input.PRD_GII_memlimit, setdoubleValue},
+    {"PRD_GII_SINGLE", "FALSE", FALSE, KEYWORD_DEFAULT,
+     &input.PRD_GII_single, setboolValue},
+    {"VOIGT_LOOKUP", "FALSE", FALSE, KEYWORD_DEFAULT, &input.Voigt_lookup,
+     setboolValue},
+    {"VOIGT_ACCURACY", "1.0E-06", FALSE, KEYWORD_DEFAULT,
+     &input.Voigt_accuracy, setdoubleValue},
     {"ALLOW_PASSIVE_BB", "TRUE", FALSE, KEYWORD_DEFAULT,
      &input.allow_passive_bb, setboolValue}
   };
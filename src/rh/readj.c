@@ -36,10 +36,10 @@ size_t pread_rh(int fd, const void *buf, size_t count, off_t offset);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- readJlambda.c ----------- */
@@ -346,6 +346,7 @@ int writeBackground(int nspect, int mu, bool_t to_obs,
 void readProfile(AtomicLine *line, int lamu, double *phi)
 {
   const char routineName[] = "readProfile";
+  register int n;
 
   int    Nrecphi, NrecSkip;
   bool_t result = TRUE;
@@ -368,6 +369,17 @@ void readProfile(AtomicLine *line, int lamu, double *phi)
   } else
     Nrecphi = 1;
   
+  /* --- Profiles kept in memory in single precision -- ------------ */
+
+  if (input.profile_single) {
+    float *phi_single = line->phi_single +
+      (size_t) NrecSkip * atmos.Nspace * lamu;
+
+    for (n = 0;  n < Nrecphi * atmos.Nspace;  n++)
+      phi[n] = (double) phi_single[n];
+    return;
+  }
+
   recordsize = Nrecphi * atmos.Nspace * sizeof(double);
   offset     = NrecSkip * atmos.Nspace * sizeof(double) * lamu;
 
@@ -383,6 +395,7 @@ void readProfile(AtomicLine *line, int lamu, double *phi)
 void writeProfile(AtomicLine *line, int lamu, double *phi)
 {
   const char routineName[] = "writeProfile";
+  register int n;
 
   int    Nrecphi;
   bool_t result = TRUE;
@@ -397,6 +410,15 @@ void writeProfile(AtomicLine *line, int lamu, double *phi)
   } else
     Nrecphi = 1;
 
+  if (input.profile_single) {
+    float *phi_single = line->phi_single +
+      (size_t) Nrecphi * atmos.Nspace * lamu;
+
+    for (n = 0;  n < Nrecphi * atmos.Nspace;  n++)
+      phi_single[n] = (float) phi[n];
+    return;
+  }
+
   recordsize = Nrecphi * atmos.Nspace * sizeof(double);
   offset     = recordsize * lamu;
 
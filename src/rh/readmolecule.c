@@ -56,9 +56,9 @@ char *getMoleculeID(char *molecule_file);
 
 /* --- Global variables --                             -------------- */
 
-extern InputData input;
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS InputData input;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- readMolecule.c ---------- */
@@ -81,7 +81,7 @@ void readMolecule(Molecule *molecule, char *fileName, bool_t active)
 
   /* --- Open the data file for current molecule --    -------------- */
 
-  if ((fp_molecule = fopen(fileName, "r")) == NULL) {
+  if ((fp_molecule = openModelFile(fileName)) == NULL) {
     sprintf(messageStr, "Unable to open inputfile %s", fileName);
     Error(ERROR_LEVEL_2, routineName, messageStr);
   } else {
@@ -590,7 +590,7 @@ void readMolecularLines(struct Molecule *molecule, char *line_data)
 
   /* --- Open the data file --                         -------------- */
  
-  if ((fp_lines = fopen(line_data, "r")) == NULL) {
+  if ((fp_lines = openModelFile(line_data)) == NULL) {
     sprintf(messageStr, "Unable to open inputfile %s", line_data);
     Error(ERROR_LEVEL_2, routineName, messageStr);
   } else {
@@ -902,7 +902,7 @@ void readMolecularModels(void)
 
   /* --- Open input file for molecular models --       -------------- */
 
-  if ((fp_molecules = fopen(input.molecules_input, "r")) == NULL) {
+  if ((fp_molecules = openModelFile(input.molecules_input)) == NULL) {
     sprintf(messageStr, "Unable to open input file %s",
 	    input.molecules_input);
     Error(ERROR_LEVEL_2, routineName, messageStr);
@@ -1030,13 +1030,13 @@ char *getMoleculeID(char *molecule_file)
 {
   const char routineName[] = "getMoleculeID";
   register int n;
-  static char moleculeID[MOLECULE_ID_WIDTH + 1];
+  static RH_TLS char moleculeID[MOLECULE_ID_WIDTH + 1];
 
   char   inputLine[MAX_LINE_SIZE];
   bool_t exit_on_EOF;
   FILE  *fp_molecule;
 
-  if ((fp_molecule = fopen(molecule_file, "r")) == NULL) {
+  if ((fp_molecule = openModelFile(molecule_file)) == NULL) {
     sprintf(messageStr, "Unable to open inputfile %s", molecule_file);
     Error(ERROR_LEVEL_2, routineName, messageStr);
   }
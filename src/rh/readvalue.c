@@ -59,9 +59,9 @@
 
 /* --- Global variables --                             -------------- */
 
-extern InputData input;
-extern CommandLine commandline;
-extern char messageStr[];
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- readValues.c ------------ */
@@ -360,6 +360,27 @@ void setInterpolate_3D(char *value, void *pointer)
 }
 /* ------- end ---------------------------- setInterpolate_3D.c ----- */
 
+/* ------- begin -------------------------- setNgMethod.c ----------- */
+
+void setNgMethod(char *value, void *pointer)
+{
+  const char routineName[] = "setNgMethod";
+
+  enum AccelMethod method = NG_ACCELERATION;
+
+  if (!strcmp(value, "NG"))
+    method = NG_ACCELERATION;
+  else if (!strcmp(value, "ANDERSON"))
+    method = ANDERSON;
+  else {
+    sprintf(messageStr,
+	    "\n  Invalid value for keyword NG_METHOD: %s", value);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  memcpy(pointer, &method, sizeof(enum AccelMethod));
+}
+/* ------- end ---------------------------- setNgMethod.c ----------- */
+
 /* ------- begin -------------------------- set_S_Interpolation.c --- */
 
 void set_S_Interpolation(char *value, void *pointer)
@@ -26,11 +26,11 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern CommandLine commandline;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- Redistribute.c ---------- */
@@ -28,13 +28,21 @@ enum solution       {UNKNOWN=-1, LTE_POPULATIONS, ZERO_RADIATION,
 enum StokesMode     {NO_STOKES, FIELD_FREE, POLARIZATION_FREE, FULL_STOKES};
 enum PRDangle       {PRD_ANGLE_INDEP, PRD_ANGLE_APPROX, PRD_ANGLE_DEP};
 enum VoigtAlgorithm {ARMSTRONG, RYBICKI, HUI_ETAL, HUMLICEK, LOOKUP};
+enum AccelMethod    {NG_ACCELERATION, ANDERSON};
 
 
 #define  MAX_LINE_SIZE      512
 #define  MAX_MESSAGE_LENGTH 512
 #define  MAX_KEYWORD_SIZE   32
-#define PRD_FILE_TEMPLATE1  "scratch/PRD_%.1s_%d-%d_p%d.dat"
-#define PRD_FILE_TEMPLATE   "scratch/PRD_%s_%d-%d_p%d.dat"
+#define PRD_FILE_TEMPLATE1  "scratch/PRD_%.1s_%d-%d_p%d_c%d.dat"
+#define PRD_FILE_TEMPLATE   "scratch/PRD_%s_%d-%d_p%d_c%d.dat"
+
+/* --- The global state of the code (atmos, spectrum, input, ...) and
+       the scratch statics of the lower level routines are kept per
+       thread, so that several instances of the code can run
+       concurrently in one process (see rh_1d/rhf1d.c) --  ----------- */
+
+#define RH_TLS  __thread
 
 #define  LG10  2.30258509299404568402
 
@@ -126,6 +134,10 @@ double cubeconvol(int Nx, int Ny, double *f, double x, double y);
 
 void   GaussLeg(double x1, double x2, double *x, double *w, int n);
 double Voigt(double a, double v, double *F, enum VoigtAlgorithm algorithm);
+void   VoigtArray(int N, double *a, double *v, double *H, double *F,
+		  enum VoigtAlgorithm algorithm);
+void   VoigtLookupArray(int N, double *a, double *v, double *H, double *F);
+void   VoigtLookupAccuracy(double accuracy);
 double gammln(double xx);
      
 void   w2(double dtau, double *w);
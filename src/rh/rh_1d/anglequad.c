@@ -23,7 +23,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
+extern RH_TLS Atmosphere atmos;
 
 
 /* ------- begin -------------------------- getAngleQuad.c ---------- */
@@ -128,101 +128,172 @@
 
 /* --- Function prototypes --                          -------------- */
 
+void freeZeeman(ZeemanMultiplet *zm);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
-extern BackgroundData bgdat;
-extern rhinfo io;
-extern rhbgmem *bmem;
-extern MPI_t mpi;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
+extern RH_TLS BackgroundData bgdat;
+extern RH_TLS rhinfo io;
+extern RH_TLS rhbgmem *bmem;
+extern RH_TLS MPI_t mpi;
 
 /* --- Routines to keep the background opacities in memory 
    Author: Jaime de la Cruz Rodriguez (ISP-SU 2015)
+
+   With BACKGROUND_SHARE_RAYS = TRUE a wavelength whose background
+   does not depend on direction keeps a single record, and the
+   2*Nrays records are only allocated once a wavelength is stored per
+   ray. With BACKGROUND_SINGLE = TRUE the records are kept in single
+   precision.
    ---*/
-void allocateBack(int nspect){
-  int nstokes = 1, recsize = atmos.Nrays * 2;  
-    
-	  
-  /* --- Stokes Wavelength --- */
-  if(atmos.backgrflags[nspect].ispolarized) nstokes = 4;
-    
-  
-    
-  /* --- Background opacity --- */
-  bmem[nspect].chi_b = matrix_double(recsize, atmos.Nspace*nstokes);
-  
-  /* --- Background emissivity --- */
-  bmem[nspect].eta_b = matrix_double(recsize, atmos.Nspace*nstokes);
-  
-  /* --- Background scattering opacity --- */
-  bmem[nspect].sca_b = matrix_double(recsize, atmos.Nspace);
-  
-  /* --- off-diagonal elements of propagation matrix K ? --- */
-  
-  if (atmos.backgrflags[nspect].ispolarized && input.magneto_optical)
-    bmem[nspect].chip_b = matrix_double(recsize, 3 * atmos.Nspace);
-    
-    
-  bmem[nspect].allocated = true;
+
+static void **allocateRecords(void **old, int Nold, int Nrec, int Ncol)
+{
+  void **records;
+  size_t size = (input.backgr_single) ? sizeof(float) : sizeof(double);
+
+  if (input.backgr_single)
+    records = (void **) matrix_float(Nrec, Ncol);
+  else
+    records = (void **) matrix_double(Nrec, Ncol);
+
+  /* --- Keep the records that were already stored -- -------------- */
+
+  if (old != NULL) {
+    if (Nold > 0) memcpy(records[0], old[0], Nold * Ncol * size);
+    freeMatrix(old);
+  }
+  return records;
 }
 
+void allocateBack(int nspect, int Nrec, int nstokes){
+  rhbgmem *bm = &bmem[nspect];
+  int Nold = 0;
 
+  /* --- Grow, never shrink, the storage of this wavelength.
+         Stored records remain valid if the layout is unchanged --- */
+
+  if (bm->allocated) {
+    Nrec    = MAX(Nrec, bm->Nrec);
+    Nold    = (nstokes <= bm->nstokes) ? bm->Nrec : 0;
+    nstokes = MAX(nstokes, bm->nstokes);
+  }
+
+  if (input.backgr_single) {
+    bm->chi_s = (float **) allocateRecords((void **) bm->chi_s, Nold,
+					   Nrec, atmos.Nspace*nstokes);
+    bm->eta_s = (float **) allocateRecords((void **) bm->eta_s, Nold,
+					   Nrec, atmos.Nspace*nstokes);
+    bm->sca_s = (float **) allocateRecords((void **) bm->sca_s, Nold,
+					   Nrec, atmos.Nspace);
+    if (nstokes == 4 && input.magneto_optical)
+      bm->chip_s = (float **) allocateRecords((void **) bm->chip_s,
+					      (bm->chip_s) ? Nold : 0,
+					      Nrec, 3 * atmos.Nspace);
+  } else {
+    bm->chi_b = (double **) allocateRecords((void **) bm->chi_b, Nold,
+					    Nrec, atmos.Nspace*nstokes);
+    bm->eta_b = (double **) allocateRecords((void **) bm->eta_b, Nold,
+					    Nrec, atmos.Nspace*nstokes);
+    bm->sca_b = (double **) allocateRecords((void **) bm->sca_b, Nold,
+					    Nrec, atmos.Nspace);
+    if (nstokes == 4 && input.magneto_optical)
+      bm->chip_b = (double **) allocateRecords((void **) bm->chip_b,
+					       (bm->chip_b) ? Nold : 0,
+					       Nrec, 3 * atmos.Nspace);
+  }
+  bm->Nrec    = Nrec;
+  bm->nstokes = nstokes;
+  bm->allocated = true;
+}
+
+static void storeRecord(double **rec_b, float **rec_s, long recnum,
+			double *data, int N)
+{
+  register int k;
+  float *rec;
+
+  if (input.backgr_single) {
+    rec = rec_s[recnum];
+    for (k = 0;  k < N;  k++) rec[k] = (float) data[k];
+  } else
+    memcpy(rec_b[recnum], data, N * sizeof(double));
+}
+
+static void fetchRecord(double **rec_b, float **rec_s, long recnum,
+			double *data, int N)
+{
+  register int k;
+  float *rec;
+
+  if (input.backgr_single) {
+    rec = rec_s[recnum];
+    for (k = 0;  k < N;  k++) data[k] = (double) rec[k];
+  } else
+    memcpy(data, rec_b[recnum], N * sizeof(double));
+}
 
 int writeBackground_j(int la, int mu, bool_t to_obs,
 		      double *chi_c, double *eta_c, double *sca_c,
 		      double *chip_c){
 
   const char routineName[] = "writeBackground_j";
-  long recnum =  2*mu + to_obs, reclen = atmos.Nspace*sizeof(double);
-  int nstokes = 1;
-
-  if(!bmem[la].allocated)
-    allocateBack(la);
+  long recnum =  2*mu + to_obs;
+  int nstokes = 1, Nrec, Nspace = atmos.Nspace;
+  rhbgmem *bm = &bmem[la];
 
-  
   if(atmos.backgrflags[la].ispolarized)
     nstokes = 4;
 
+  /* --- Record 0 is written first. It is the only one when the
+         background of this wavelength is angle-independent -- ---- */
+
+  Nrec = (input.backgr_share_rays && recnum == 0) ? 1 : 2*atmos.Nrays;
+  if (!bm->allocated || Nrec > bm->Nrec || nstokes > bm->nstokes)
+    allocateBack(la, Nrec, nstokes);
+  bm->shared = (recnum == 0);
+
   
   /* --- Copy data to allocated arrays --- */
   
-  memcpy(&bmem[la].chi_b[recnum][0], &chi_c[0], nstokes*reclen);
-  memcpy(&bmem[la].eta_b[recnum][0], &eta_c[0], nstokes*reclen);
-  memcpy(&bmem[la].sca_b[recnum][0], &sca_c[0], reclen);
+  storeRecord(bm->chi_b, bm->chi_s, recnum, chi_c, nstokes*Nspace);
+  storeRecord(bm->eta_b, bm->eta_s, recnum, eta_c, nstokes*Nspace);
+  storeRecord(bm->sca_b, bm->sca_s, recnum, sca_c, Nspace);
 
 
   if (atmos.backgrflags[la].ispolarized && input.magneto_optical && chip_c != NULL)
-    memcpy(&bmem[la].chip_b[recnum][0], chip_c, reclen*3);
+    storeRecord(bm->chip_b, bm->chip_s, recnum, chip_c, 3*Nspace);
 
 
 }
 int readBackground_j(int la, int mu, bool_t to_obs){
 
   const char routineName[] = "readBackground_j";
-  long recnum, reclen;
-  int nstokes = 1;
+  long recnum;
+  int nstokes = 1, Nspace = atmos.Nspace;
   ActiveSet *as = &spectrum.as[la];
+  rhbgmem *bm = &bmem[la];
 
 
-  reclen = atmos.Nspace*sizeof(double);
   recnum = 2*mu + to_obs;
+  if (input.backgr_share_rays && bm->shared) recnum = 0;
   
   if(atmos.backgrflags[la].ispolarized && input.StokesMode == FULL_STOKES) nstokes = 4;
 
   /* --- Copy data to allocated arrays --- */
   
-  memcpy(as->chi_c, &bmem[la].chi_b[recnum][0], nstokes*reclen);
-  memcpy(as->eta_c, &bmem[la].eta_b[recnum][0], nstokes*reclen);
-  memcpy(as->sca_c, &bmem[la].sca_b[recnum][0], reclen);
+  fetchRecord(bm->chi_b, bm->chi_s, recnum, as->chi_c, nstokes*Nspace);
+  fetchRecord(bm->eta_b, bm->eta_s, recnum, as->eta_c, nstokes*Nspace);
+  fetchRecord(bm->sca_b, bm->sca_s, recnum, as->sca_c, Nspace);
   
   if (atmos.backgrflags[la].ispolarized &&
       input.magneto_optical && as->chip_c != NULL &&
       input.StokesMode == FULL_STOKES){
-    memcpy(&as->chip_c[0], &bmem[la].chip_b[recnum][0], reclen*3);
+    fetchRecord(bm->chip_b, bm->chip_s, recnum, as->chip_c, 3*Nspace);
   }
     
 }
@@ -244,7 +315,7 @@ void init_Background_j(){
     /* --- Read wavelength-dependent fudge factors to compensate for
        missing UV backround line haze --           -------------- */
     
-    if ((fp_fudge = fopen(input.fudgeData, "r")) == NULL) {
+    if ((fp_fudge = openModelFile(input.fudgeData)) == NULL) {
       sprintf(messageStr, "Unable to open input file %s", input.fudgeData);
       Error(ERROR_LEVEL_2, routineName, messageStr);
     }
@@ -309,13 +380,54 @@ void init_Background_j(){
   
 }
 
+/* --- Release what init_Background_j and the stored records took -- */
+
+void free_Background_j(void)
+{
+  int n, nspect;
+  rhbgmem *bm;
+  RLK_Line *rlk;
+
+  if (bgdat.do_fudge) {
+    free(bgdat.lambda_fudge);
+    freeMatrix((void **) bgdat.fudge);
+  }
+  free(atmos.backgrflags);
+  free(atmos.backgrrecno);
+
+  for (n = 0;  n < atmos.Nrlk;  n++) {
+    rlk = &atmos.rlk_lines[n];
+    if (rlk->zm != NULL) {
+      freeZeeman(rlk->zm);
+      free(rlk->zm);
+    }
+  }
+  if (atmos.rlk_lines != NULL) free(atmos.rlk_lines);
+
+  if (bmem != NULL) {
+    for (nspect = 0;  nspect < spectrum.Nspect;  nspect++) {
+      bm = &bmem[nspect];
+      if (bm->chi_b != NULL)  freeMatrix((void **) bm->chi_b);
+      if (bm->eta_b != NULL)  freeMatrix((void **) bm->eta_b);
+      if (bm->sca_b != NULL)  freeMatrix((void **) bm->sca_b);
+      if (bm->chip_b != NULL) freeMatrix((void **) bm->chip_b);
+      if (bm->chi_s != NULL)  freeMatrix((void **) bm->chi_s);
+      if (bm->eta_s != NULL)  freeMatrix((void **) bm->eta_s);
+      if (bm->sca_s != NULL)  freeMatrix((void **) bm->sca_s);
+      if (bm->chip_s != NULL) freeMatrix((void **) bm->chip_s);
+    }
+    free(bmem);
+    bmem = NULL;
+  }
+}
+
 
 void Background_j(bool_t write_analyze_output, bool_t equilibria_only)
 {
   const char routineName[] = "Background_j";
   register int k, nspect, n, mu, to_obs;
   
-  static int ne_iter = 0;
+  static RH_TLS int ne_iter = 0;
   bool_t  do_fudge;
   int     index, Nfudge, NrecStokes;
   double *chi, *eta, *scatt, wavelength, *thomson, *chi_ai, *eta_ai, *sca_ai,
@@ -751,11 +863,13 @@ void Background_j(bool_t write_analyze_output, bool_t equilibria_only)
  
   getCPU(3, TIME_POLL, "Background Opacity");
 
-  /* --- Free the temporary space allocated in the ff routines -- --- */
+  /* --- Free the temporary space allocated in the ff routines, and
+         the damping parameters kept by passive_bb -- -------------- */
 
   Hminus_ff(0.0, NULL);
   H2minus_ff(0.0, NULL);
   H2plus_ff(0.0, NULL);
+  passive_bb(0.0, 0, 0, FALSE, NULL, NULL, NULL);
 
   free(chi);    free(eta);  free(scatt);  free(Bnu);  free(thomson);
   free(chi_c);  free(eta_c);  free(sca_c);
@@ -42,10 +42,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Geometry geometry;
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern char messageStr[];
+extern RH_TLS Geometry geometry;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS char messageStr[];
 
 
 /* --- Identity matrix ---- */
@@ -753,3 +753,420 @@ void Piecewise_Bezier3(int nspect, int mu, bool_t to_obs,
 
 
 
+
+/* --------------------------------------------------------------- */
+
+/* --- Batched versions of the solvers above. BEZIER_NLANES
+       wavelengths are integrated along the same ray at once, with the
+       wavelength as innermost (SIMD) index. Opacities and source
+       functions are stored as structure of arrays:
+
+          chi[k*BEZIER_NLANES + l]
+          S[(n*Ndep + k)*BEZIER_NLANES + l]
+          K[(k*16 + j*4 + i)*BEZIER_NLANES + l]    (polarized only)
+
+       and the intensity is returned in the same layout as S. All
+       lanes must be filled; nspect[l] gives the wavelength index of
+       lane l (used for the boundary conditions). --- */
+
+#define NL BEZIER_NLANES
+#define CHI(k, l)     chi[(k)*NL + (l)]
+#define SRC(n, k, l)  S[((n)*Ndep + (k))*NL + (l)]
+#define INT(n, k, l)  I[((n)*Ndep + (k))*NL + (l)]
+#define KMAT(k, j, i, l)  K[((k)*16 + (j)*4 + (i))*NL + (l)]
+
+/* --------------------------------------------------------------- */
+
+static void upwindIntensity(int *nspect, int mu, bool_t to_obs,
+			    double *dtau_uw, double I_upw[4][NL],
+			    const char *routineName)
+{
+  register int n, l;
+
+  int    Ndep = geometry.Ndep;
+  double Bnu[2];
+
+  for (n = 0;  n < 4;  n++)
+    for (l = 0;  l < NL;  l++) I_upw[n][l] = 0.0;
+
+  if (to_obs) {
+    switch (geometry.vboundary[BOTTOM]) {
+    case ZERO:
+      break;
+    case THERMALIZED:
+      for (l = 0;  l < NL;  l++) {
+	Planck(2, &atmos.T[Ndep-2], spectrum.lambda[nspect[l]], Bnu);
+	I_upw[0][l] = Bnu[1] - (Bnu[0] - Bnu[1]) / dtau_uw[l];
+      }
+      break;
+    case IRRADIATED:
+      for (l = 0;  l < NL;  l++) I_upw[0][l] = geometry.Ibottom[nspect[l]][mu];
+      break;
+    default:
+      sprintf(messageStr, "Boundary condition not implemented: %d",
+	      geometry.vboundary[BOTTOM]);
+      Error(ERROR_LEVEL_2, routineName, messageStr);
+    }
+  } else {
+    switch (geometry.vboundary[TOP]) {
+    case ZERO:
+      break;
+    case THERMALIZED:
+      for (l = 0;  l < NL;  l++) {
+	Planck(2, &atmos.T[0], spectrum.lambda[nspect[l]], Bnu);
+	I_upw[0][l] = Bnu[0] - (Bnu[1] - Bnu[0]) / dtau_uw[l];
+      }
+      break;
+    case IRRADIATED:
+      for (l = 0;  l < NL;  l++) I_upw[0][l] = geometry.Itop[nspect[l]][mu];
+      break;
+    default:
+      sprintf(messageStr, "Boundary condition not implemented: %d",
+	      geometry.vboundary[TOP]);
+      Error(ERROR_LEVEL_2, routineName, messageStr);
+    }
+  }
+}
+
+/* --------------------------------------------------------------- */
+
+void PiecewiseStokesBezier3_batch(int *nspect, int mu, bool_t to_obs,
+				  double *chi, double *S, double *K, double *I)
+{
+  /* ---
+     Cubic DELO-Bezier solver for polarized light, BEZIER_NLANES
+     wavelengths at a time. Same scheme as PiecewiseStokesBezier3.
+     --- */
+  
+  static const char routineName[] = "PiecewiseStokesBezier3_batch";
+  static const int siz_mat = 16*NL*sizeof(double), siz_vec = 4*NL*sizeof(double);
+  
+  register int k, n, m, i, j, l;
+  
+  int    Ndep = geometry.Ndep, k_start, k_end, dk, k_last, p, r;
+  double dsup, dsdn, dsdn2, c1, c2, tmp, maxel;
+  double dtau_uw[NL], dtau_dw[NL], dchi_up[NL], dchi_c[NL], dchi_dn[NL],
+    dt03[NL], eps[NL], alpha[NL], beta[NL], gamma[NL], theta[NL];
+  double Ku[4][4][NL], K0[4][4][NL], Kd[4][4][NL], dKu[4][4][NL], dK0[4][4][NL];
+  double Su[4][NL], S0[4][NL], Sd[4][NL], dSu[4][NL], dS0[4][NL], I_upw[4][NL];
+  double A[4][4][NL], Ma[4][4][NL], Mb[4][4][NL], Mc[4][4][NL], Md[4][4][NL],
+    V0[4][NL];
+  const double imu = 1.0 / geometry.muz[mu];
+  double *z = geometry.height;
+  
+  if (to_obs) {
+    dk      = -1;
+    k_start = Ndep-1;
+    k_end   = 0;
+  } else {
+    dk      = 1;
+    k_start = 0;
+    k_end   = Ndep-1;
+  }
+  for (l = 0;  l < NL;  l++)
+    dtau_uw[l] = 0.5 * imu * (CHI(k_start, l) + CHI(k_start+dk, l)) *
+      fabs(z[k_start] - z[k_start+dk]);
+  
+  /* --- Boundary conditions --                        -------------- */
+
+  upwindIntensity(nspect, mu, to_obs, dtau_uw, I_upw, routineName);
+  for (n = 0;  n < 4;  n++)
+    for (l = 0;  l < NL;  l++) INT(n, k_start, l) = I_upw[n][l];
+  
+  k=k_start+dk;
+  dsup = fabs(z[k] - z[k-dk]) * imu;
+  dsdn = fabs(z[k+dk] - z[k]) * imu;
+
+  for (l = 0;  l < NL;  l++) {
+    dchi_up[l] = (CHI(k, l) - CHI(k-dk, l)) / dsup;
+    dchi_c[l]  = cent_deriv(dsup, dsdn, CHI(k-dk, l), CHI(k, l), CHI(k+dk, l));
+
+    c2 = CHI(k, l)    - (dsup*0.3333333333333333333333333) * dchi_c[l];
+    c1 = CHI(k-dk, l) + (dsup*0.3333333333333333333333333) * dchi_up[l];
+    dtau_uw[l] = 0.25 * dsup * (CHI(k, l) + CHI(k-dk, l) + c1 + c2);
+  }
+
+  /* --- Ku, K0, Su, S0 and side derivatives in the first interval - */
+
+  for (n = 0;  n < 4;  n++) {
+    for (l = 0;  l < NL;  l++) {
+      Su[n][l]  = SRC(n, k_start, l);
+      S0[n][l]  = SRC(n, k_start+dk, l);
+      dSu[n][l] = (S0[n][l] - Su[n][l]) / dtau_uw[l];
+    }
+    for (m = 0;  m < 4;  m++)
+      for (l = 0;  l < NL;  l++) {
+	Ku[n][m][l]  = KMAT(k_start, n, m, l);
+	K0[n][m][l]  = KMAT(k_start+dk, n, m, l);
+	dKu[n][m][l] = (K0[n][m][l] - Ku[n][m][l]) / dtau_uw[l];
+      }
+  }
+
+  /* --- Solve transfer along ray --                   -------------- */
+  
+  k_last = k_end  + dk;
+
+  for (k = k_start+dk; k != k_last;  k += dk) {      
+
+    if (k != k_end) {
+      dsdn = fabs(z[k+dk] - z[k]) * imu;
+      
+      if (fabs(k-k_end) > 1) {
+	dsdn2 = fabs(z[k+2*dk] - z[k+dk]) * imu;
+	for (l = 0;  l < NL;  l++)
+	  dchi_dn[l] = cent_deriv(dsdn, dsdn2, CHI(k, l), CHI(k+dk, l),
+				  CHI(k+2*dk, l));
+      } else {
+	for (l = 0;  l < NL;  l++)
+	  dchi_dn[l] = (CHI(k+dk, l) - CHI(k, l)) / dsdn;
+      }
+      for (l = 0;  l < NL;  l++) {
+	c1 = (CHI(k+dk, l) - (dsdn*0.333333333333333333333333333) * dchi_dn[l]);
+	c2 = (CHI(k, l)    + (dsdn*0.333333333333333333333333333) * dchi_c[l]);
+	dtau_dw[l] = 0.25 * dsdn * (CHI(k, l) + CHI(k+dk, l) + c1 + c2);
+      }
+
+      for (n = 0;  n < 4;  n++) {
+	for (l = 0;  l < NL;  l++) {
+	  Sd[n][l]  = SRC(n, k+dk, l);
+	  dS0[n][l] = cent_deriv(dtau_uw[l], dtau_dw[l],
+				 Su[n][l], S0[n][l], Sd[n][l]);
+	}
+	for (m = 0;  m < 4;  m++)
+	  for (l = 0;  l < NL;  l++) {
+	    Kd[n][m][l]  = KMAT(k+dk, n, m, l);
+	    dK0[n][m][l] = cent_deriv(dtau_uw[l], dtau_dw[l],
+				      Ku[n][m][l], K0[n][m][l], Kd[n][m][l]);
+	  }
+      }
+    } else {
+
+      /* --- Last interval, linear derivatives at the central point - */
+
+      for (n = 0;  n < 4;  n++) {
+	for (l = 0;  l < NL;  l++)
+	  dS0[n][l] = (S0[n][l] - Su[n][l]) / dtau_uw[l];
+	for (m = 0;  m < 4;  m++)
+	  for (l = 0;  l < NL;  l++)
+	    dK0[n][m][l] = (K0[n][m][l] - Ku[n][m][l]) / dtau_uw[l];
+      }
+    }
+
+    /* --- Bezier3 coeffs. ---- */
+
+    for (l = 0;  l < NL;  l++) {
+      dt03[l] = dtau_uw[l] * 0.3333333333333333333333333333333;
+      Bezier3_coeffs(fabs(dtau_uw[l]), &alpha[l], &beta[l], &gamma[l],
+		     &theta[l], &eps[l]);
+    }
+
+    /* --- Ku # Ku and K0 # K0, see m4m --- */
+
+    for (j = 0;  j < 4;  j++)
+      for (i = 0;  i < 4;  i++) {
+	for (l = 0;  l < NL;  l++) Ma[j][i][l] = A[j][i][l] = 0.0;
+	for (m = 0;  m < 4;  m++)
+	  for (l = 0;  l < NL;  l++) {
+	    Ma[j][i][l] += Ku[m][i][l] * Ku[j][m][l];
+	    A[j][i][l]  += K0[m][i][l] * K0[j][m][l];
+	  }
+      }
+
+    /* --- Build the linear system of equations to get the intensity --- */
+
+    for (j = 0;  j < 4;  j++) {
+      for (i = 0;  i < 4;  i++) {
+	for (l = 0;  l < NL;  l++) {
+	  Md[j][i][l] = ident[j][i] + beta[l] * K0[j][i][l] + theta[l] *
+	    (dt03[l] * (A[j][i][l] - dK0[j][i][l] + K0[j][i][l]) + K0[j][i][l]);
+	  
+	  Ma[j][i][l] = eps[l] * ident[j][i] - alpha[l] * Ku[j][i][l] + gamma[l] *
+	    (dt03[l] * (Ma[j][i][l] - dKu[j][i][l] + Ku[j][i][l]) - Ku[j][i][l]);
+	  
+	  Mb[j][i][l] = alpha[l] * ident[j][i] +
+	    gamma[l] * (ident[j][i] - dt03[l] * Ku[j][i][l]);
+	  Mc[j][i][l] = beta[l] * ident[j][i] +
+	    theta[l] * (ident[j][i] + dt03[l] * K0[j][i][l]);
+	}
+      }
+    }
+
+    for (i = 0;  i < 4;  i++) {
+      for (l = 0;  l < NL;  l++) V0[i][l] = 0.0;
+      for (j = 0;  j < 4;  j++)
+	for (l = 0;  l < NL;  l++)
+	  V0[i][l] += Ma[i][j][l] * INT(j, k-dk, l) + Mb[i][j][l] * Su[j][l] +
+	    Mc[i][j][l] * S0[j][l];
+      for (l = 0;  l < NL;  l++)
+	V0[i][l] += dt03[l] * (gamma[l] * dSu[i][l] - theta[l] * dS0[i][l]);
+    }
+
+    /* --- Solve linear system to get the intensity, Gaussian
+           elimination with partial pivoting per lane as in
+           solveLinearFast --- */
+
+    for (i = 0;  i < 4;  i++) {
+      for (l = 0;  l < NL;  l++) {
+	maxel = fabs(Md[i][i][l]);
+	p = i;
+	for (r = i+1;  r < 4;  r++) {
+	  if ((tmp = fabs(Md[r][i][l])) > maxel) {
+	    maxel = tmp;
+	    p = r;
+	  }
+	}
+	if (p != i) {
+	  for (r = i;  r < 4;  r++) swap(Md[p][r][l], Md[i][r][l], tmp);
+	  swap(V0[p][l], V0[i][l], tmp);
+	}
+      }
+      for (r = i+1;  r < 4;  r++) {
+	for (l = 0;  l < NL;  l++) {
+	  tmp = -Md[r][i][l] / Md[i][i][l];
+	  for (j = i+1;  j < 4;  j++) Md[r][j][l] += tmp * Md[i][j][l];
+	  V0[r][l] += tmp * V0[i][l];
+	}
+      }
+    }
+    for (i = 3;  i >= 0;  i--) {
+      for (l = 0;  l < NL;  l++) {
+	V0[i][l] /= Md[i][i][l];
+	for (r = i-1;  r >= 0;  r--) V0[r][l] -= Md[r][i][l] * V0[i][l];
+      }
+    }
+
+    for (i = 0;  i < 4;  i++)
+      for (l = 0;  l < NL;  l++) INT(i, k, l) = V0[i][l];
+
+    /* --- Shift values for next depth --- */
+      
+    memcpy(Su,   S0, siz_vec);
+    memcpy(S0,   Sd, siz_vec);
+    memcpy(dSu, dS0, siz_vec);
+      
+    memcpy(Ku,   K0, siz_mat);
+    memcpy(K0,   Kd, siz_mat);
+    memcpy(dKu, dK0, siz_mat);
+
+    dsup = dsdn;
+    for (l = 0;  l < NL;  l++) {
+      dtau_uw[l] = dtau_dw[l];
+      dchi_up[l] = dchi_c[l];
+      dchi_c[l]  = dchi_dn[l];
+    }
+  }
+}
+
+/* --------------------------------------------------------------- */
+
+void Piecewise_Bezier3_batch(int *nspect, int mu, bool_t to_obs,
+			     double *chi, double *S, double *I)
+{
+  /* ---
+     Cubic Bezier solver for unpolarized light, BEZIER_NLANES
+     wavelengths at a time. Same scheme as Piecewise_Bezier3.
+     --- */
+  
+  static const char routineName[] = "Piecewise_Bezier3_batch";
+
+  register int k, l;
+
+  int    k_start, k_end, dk, Ndep = geometry.Ndep;
+  double dsup, dsdn, dsdn2, c1, c2, dt03, eps, alpha, beta, gamma, theta;
+  double dtau_uw[NL], dtau_dw[NL], dS_up[NL], dS_c[NL], dchi_up[NL],
+    dchi_c[NL], dchi_dn[NL], I_upw[4][NL];
+  const double zmu = 1.0 / geometry.muz[mu];
+  double *z = geometry.height;
+
+  if (to_obs) {
+    dk      = -1;
+    k_start = Ndep-1;
+    k_end   = 0;
+  } else {
+    dk      = 1;
+    k_start = 0;
+    k_end   = Ndep-1;
+  }
+  for (l = 0;  l < NL;  l++)
+    dtau_uw[l] = 0.5 * zmu * (CHI(k_start, l) + CHI(k_start+dk, l)) *
+      fabs(z[k_start] - z[k_start+dk]);
+
+  /* --- Boundary conditions --                        -------------- */
+
+  upwindIntensity(nspect, mu, to_obs, dtau_uw, I_upw, routineName);
+  for (l = 0;  l < NL;  l++) INT(0, k_start, l) = I_upw[0][l];
+
+  k=k_start+dk;
+  dsup = fabs(z[k] - z[k-dk]) * zmu;
+  dsdn = fabs(z[k+dk] - z[k]) * zmu;
+
+  for (l = 0;  l < NL;  l++) {
+    dchi_up[l] = (CHI(k, l) - CHI(k-dk, l)) / dsup;
+    dchi_c[l]  = cent_deriv(dsup, dsdn, CHI(k-dk, l), CHI(k, l), CHI(k+dk, l));
+
+    c1 = (CHI(k, l)    - (dsup*0.333333333333333333) * dchi_c[l]);
+    c2 = (CHI(k-dk, l) + (dsup*0.333333333333333333) * dchi_up[l]);
+    dtau_uw[l] = dsup * (CHI(k, l) + CHI(k-dk, l) + c1 + c2) * 0.25;
+
+    dS_up[l] = (SRC(0, k, l) - SRC(0, k-dk, l)) / dtau_uw[l];
+  }
+
+  /* --- Solve transfer along ray --                   -------------- */
+
+  for (k = k_start+dk;  k != k_end+dk;  k += dk) {
+
+    if (k != k_end) {
+      dsdn = fabs(z[k+dk] - z[k]) * zmu;
+
+      if (fabs(k-k_end) > 1) {
+	dsdn2 = fabs(z[k+2*dk] - z[k+dk]) * zmu;
+	for (l = 0;  l < NL;  l++)
+	  dchi_dn[l] = cent_deriv(dsdn, dsdn2, CHI(k, l), CHI(k+dk, l),
+				  CHI(k+2*dk, l));
+      } else {
+	for (l = 0;  l < NL;  l++)
+	  dchi_dn[l] = (CHI(k+dk, l) - CHI(k, l)) / dsdn;
+      }
+      for (l = 0;  l < NL;  l++) {
+	c1 = (CHI(k, l)    + (dsdn*0.3333333333333333333) * dchi_c[l]);
+	c2 = (CHI(k+dk, l) - (dsdn*0.3333333333333333333) * dchi_dn[l]);
+	dtau_dw[l] = dsdn * (CHI(k, l) + CHI(k+dk, l) + c1 + c2) * 0.25;
+
+	dS_c[l] = cent_deriv(dtau_uw[l], dtau_dw[l],
+			     SRC(0, k-dk, l), SRC(0, k, l), SRC(0, k+dk, l));
+      }
+    } else {
+      for (l = 0;  l < NL;  l++)
+	dS_c[l] = (SRC(0, k, l) - SRC(0, k-dk, l)) / dtau_uw[l];
+    }
+
+    for (l = 0;  l < NL;  l++) {
+      dt03 = dtau_uw[l]*0.33333333333333333333333;
+      Bezier3_coeffs(dtau_uw[l], &alpha, &beta, &gamma, &theta, &eps);
+
+      c1 = (SRC(0, k, l)    - dt03 * dS_c[l]);
+      c2 = (SRC(0, k-dk, l) + dt03 * dS_up[l]);
+
+      INT(0, k, l) = INT(0, k-dk, l)*eps + beta*SRC(0, k, l) +
+	alpha*SRC(0, k-dk, l) + theta * c1 + gamma * c2;
+    }
+
+    /* --- Re-use downwind quantities for next upwind position -- --- */
+
+    dsup = dsdn;
+    for (l = 0;  l < NL;  l++) {
+      dchi_up[l] = dchi_c[l];
+      dchi_c[l]  = dchi_dn[l];
+      dtau_uw[l] = dtau_dw[l];
+      dS_up[l]   = dS_c[l];
+    }
+  }
+}
+
+#undef NL
+#undef CHI
+#undef SRC
+#undef INT
+#undef KMAT
+
+/* -------------------------------------------------------------------------- */
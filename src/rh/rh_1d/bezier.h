@@ -12,6 +12,11 @@
 #ifndef BEZIER_H
 #define BEZIER_H
 
+/* --- Number of wavelengths integrated together by the batched
+       solvers. 8 doubles fill an AVX-512 register, two AVX2 ones --- */
+
+#define BEZIER_NLANES 8
+
 
 /* ----- Prototypes auxiliary functions --- */
 double sign(const double val);
@@ -42,6 +47,12 @@ void PiecewiseStokesBezier3(int nspect, int mu, bool_t to_obs,
 void Piecewise_Bezier3(int nspect, int mu, bool_t to_obs,
 		       double *chi, double *S, double *I, double *Psi);
 
+void PiecewiseStokesBezier3_batch(int *nspect, int mu, bool_t to_obs,
+				  double *chi, double *S, double *K, double *I);
+
+void Piecewise_Bezier3_batch(int *nspect, int mu, bool_t to_obs,
+			     double *chi, double *S, double *I);
+
 /* -------------------------------------------------------------------------- */
 
 
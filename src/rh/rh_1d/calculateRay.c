@@ -14,15 +14,15 @@
 
 extern enum Topology topology;
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern Geometry geometry;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS Geometry geometry;
+extern RH_TLS char messageStr[];
 //extern NCDF_Atmos_file infile;
 //extern MPI_data mpi;
 //extern IO_data io; 
-extern rhinfo io;
+extern RH_TLS rhinfo io;
 
 
 extern void Bproject_los(void);
@@ -30,9 +30,9 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- MULTIatmos.c ------------ */
@@ -45,10 +45,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
-extern Geometry geometry;
-extern Atmosphere atmos;
-extern Spectrum spectrum;
+extern RH_TLS char messageStr[];
+extern RH_TLS Geometry geometry;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
 
 
 /* ------- begin -------------------------- Feautrier.c ------------- */
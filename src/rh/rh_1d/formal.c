@@ -33,11 +33,11 @@ void loadBackground(int la, int mu, bool_t to_obs);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Geometry geometry;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Geometry geometry;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- Formal.c ---------------- */
@@ -419,3 +419,186 @@ double Formal(int nspect, bool_t eval_operator, bool_t redistribute, int iter)
   return dJmax;
 }   
 /* ------- end ---------------------------- Formal.c ---------------- */
+
+/* ------- begin -------------------------- batchClass.c ------------ */
+
+static int batchClass(int nspect)
+{
+  bool_t   boundbound, polarized_as, polarized_c, PRD_angle_dep,
+           solveStokes, angle_dep;
+  ActiveSet *as;
+
+  /* --- Returns the batched solver that reproduces what Formal does
+         for wavelength nspect: 0 for Piecewise_Bezier3, 1 for
+         PiecewiseStokesBezier3, and -1 if Formal itself is needed
+         (Feautrier, other interpolations, background polarization) */
+
+  as = &spectrum.as[nspect];
+
+  boundbound    = containsBoundBound(as);
+  PRD_angle_dep = (containsPRDline(as) &&
+		   input.PRD_angle_dep != PRD_ANGLE_INDEP);
+  polarized_as  = containsPolarized(as);
+  polarized_c   = atmos.backgrflags[nspect].ispolarized;
+  solveStokes   = (input.StokesMode == FULL_STOKES &&
+		   (polarized_as || polarized_c || input.backgr_pol));
+  angle_dep     = (polarized_as || polarized_c || PRD_angle_dep != PRD_ANGLE_INDEP ||
+		   (input.backgr_pol && input.StokesMode == FULL_STOKES) ||
+		   (atmos.moving &&
+		    (boundbound || atmos.backgrflags[nspect].hasline)));
+
+  if (!angle_dep || input.backgr_pol) return -1;
+
+  if (solveStokes)
+    return (input.S_interpolation_stokes == DELO_BEZIER3) ? 1 : -1;
+  else
+    return (input.S_interpolation == BEZIER3) ? 0 : -1;
+}
+/* ------- end ---------------------------- batchClass.c ------------ */
+
+/* ------- begin -------------------------- solveBatch.c ------------ */
+
+static void solveBatch(int Nl, int *lane, bool_t solveStokes,
+		       double *chi, double *S, double *K, double *I)
+{
+  register int k, n, l, mu;
+
+  int     ns, Nspace = atmos.Nspace, Nlanes = BEZIER_NLANES;
+  double *Jdag, chi_k, KK[4][4];
+  bool_t  to_obs, initialize, polarized_as, polarized_c;
+  ActiveSet *as;
+
+  Jdag = (input.limit_memory) ?
+    (double *) malloc(Nspace * sizeof(double)) : NULL;
+
+  /* --- Unused lanes repeat the last wavelength --    -------------- */
+
+  for (l = Nl;  l < Nlanes;  l++) lane[l] = lane[Nl-1];
+
+  for (mu = 0;  mu < atmos.Nrays;  mu++) {
+
+    /* --- Gather opacity and source function of each wavelength.
+           The active set scratch space is shared between wavelengths,
+           so each is set up, copied and released in turn -- ------- */
+
+    for (l = 0;  l < Nl;  l++) {
+      ns = lane[l];
+      as = &spectrum.as[ns];
+      polarized_as = containsPolarized(as);
+      polarized_c  = atmos.backgrflags[ns].ispolarized;
+
+      /* --- As in Formal, direction-independent background and
+             opacities only exist for the first ray -- ------------- */
+
+      alloc_as(ns, FALSE);
+      if (atmos.backgrflags[ns].hasline)
+	readBackground_j(ns, mu, to_obs=TRUE);
+      else
+	readBackground_j(ns, 0, to_obs=FALSE);
+
+      if (containsBoundBound(as))
+	Opacity(ns, mu, to_obs=TRUE, initialize=TRUE);
+      else
+	Opacity(ns, 0, to_obs=FALSE, initialize=TRUE);
+
+      if (input.limit_memory)
+	readJlambda(ns, Jdag);
+      else
+	Jdag = spectrum.J[ns];
+
+      for (k = 0;  k < Nspace;  k++) {
+	chi_k = as->chi[k] + as->chi_c[k];
+	chi[k*Nlanes + l] = chi_k;
+	S[k*Nlanes + l] =
+	  (as->eta[k] + as->eta_c[k] + as->sca_c[k]*Jdag[k]) / chi_k;
+      }
+      if (solveStokes) {
+	for (n = 1;  n < 4;  n++) {
+	  for (k = 0;  k < Nspace;  k++) {
+	    S[(n*Nspace + k)*Nlanes + l] =
+	      (((polarized_as) ? as->eta[n*Nspace + k] : 0.0) +
+	       ((polarized_c) ? as->eta_c[n*Nspace + k] : 0.0)) /
+	      chi[k*Nlanes + l];
+	  }
+	}
+	for (k = 0;  k < Nspace;  k++) {
+	  StokesK(ns, k, chi[k*Nlanes + l], KK);
+	  for (n = 0;  n < 16;  n++)
+	    K[(k*16 + n)*Nlanes + l] = KK[n/4][n%4];
+	}
+      }
+      free_as(ns, FALSE);
+    }
+    for (l = Nl;  l < Nlanes;  l++) {
+      for (k = 0;  k < Nspace;  k++) chi[k*Nlanes + l] = chi[k*Nlanes + Nl-1];
+      for (k = 0;  k < 4*Nspace;  k++) S[k*Nlanes + l] = S[k*Nlanes + Nl-1];
+      if (solveStokes)
+	for (k = 0;  k < 16*Nspace;  k++) K[k*Nlanes + l] = K[k*Nlanes + Nl-1];
+    }
+
+    /* --- Only the emergent intensity is needed --    -------------- */
+
+    if (solveStokes)
+      PiecewiseStokesBezier3_batch(lane, mu, to_obs=TRUE, chi, S, K, I);
+    else
+      Piecewise_Bezier3_batch(lane, mu, to_obs=TRUE, chi, S, I);
+
+    for (l = 0;  l < Nl;  l++) {
+      ns = lane[l];
+      spectrum.I[ns][mu] = I[l];
+      if (solveStokes) {
+	spectrum.Stokes_Q[ns][mu] = I[Nspace*Nlanes + l];
+	spectrum.Stokes_U[ns][mu] = I[2*Nspace*Nlanes + l];
+	spectrum.Stokes_V[ns][mu] = I[3*Nspace*Nlanes + l];
+      }
+    }
+  }
+  if (input.limit_memory) free(Jdag);
+}
+/* ------- end ---------------------------- solveBatch.c ------------ */
+
+/* ------- begin -------------------------- FormalBatch.c ----------- */
+
+double FormalBatch(int Nlam, int *nspect, int iter)
+{
+  register int nb;
+
+  int     cls, Nl, lane[BEZIER_NLANES], Nspace = atmos.Nspace;
+  double *chi, *S, *K, *I, dJ, dJmax = 0.0;
+
+  /* --- Formal solution for the emergent intensity of Nlam
+         wavelengths when neither the mean intensity nor the rates are
+         updated (final ray of rhf1d). Wavelengths handled by the
+         same Bezier solver are integrated BEZIER_NLANES at a time;
+         the others go through Formal --               -------------- */
+
+  chi = (double *) malloc(BEZIER_NLANES * Nspace * sizeof(double));
+  S   = (double *) calloc(4*BEZIER_NLANES * Nspace, sizeof(double));
+  K   = (double *) malloc(16*BEZIER_NLANES * Nspace * sizeof(double));
+  I   = (double *) malloc(4*BEZIER_NLANES * Nspace * sizeof(double));
+
+  for (cls = 0;  cls <= 1;  cls++) {
+    Nl = 0;
+    for (nb = 0;  nb < Nlam;  nb++) {
+      if (batchClass(nspect[nb]) != cls) continue;
+
+      lane[Nl++] = nspect[nb];
+      if (Nl == BEZIER_NLANES) {
+	solveBatch(Nl, lane, (bool_t) cls, chi, S, K, I);
+	Nl = 0;
+      }
+    }
+    if (Nl > 0) solveBatch(Nl, lane, (bool_t) cls, chi, S, K, I);
+  }
+
+  for (nb = 0;  nb < Nlam;  nb++) {
+    if (batchClass(nspect[nb]) < 0) {
+      dJ = Formal(nspect[nb], FALSE, FALSE, iter);
+      dJmax = MAX(dJmax, dJ);
+    }
+  }
+  free(chi);  free(S);  free(K);  free(I);
+
+  return dJmax;
+}
+/* ------- end ---------------------------- FormalBatch.c ----------- */
@@ -35,10 +35,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Geometry geometry;
-extern char   messageStr[];
-extern MPI_t mpi;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Geometry geometry;
+extern RH_TLS char   messageStr[];
+extern RH_TLS MPI_t mpi;
 
 
 /* ------- begin -------------------------- Hydrostatic.c ----------- */
@@ -44,9 +44,10 @@
 #include "xdr.h"
 #include "initial_j.h"
 #include "pesc.h"
+#include "rhf1d.h"
 //#include "mtime.h"
 
-#define IMU_FILE_TEMPLATE "scratch/Imu_p%d.dat"
+#define IMU_FILE_TEMPLATE "scratch/Imu_p%d_c%d.dat"
 
 /* --- Function prototypes --                          -------------- */
 #define min(a,b) (((a)<(b))?(a):(b))
@@ -54,11 +55,12 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern CommandLine commandline;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
+extern RH_TLS MPI_t mpi;
 
 extern enum Topology topology;
 
@@ -133,7 +135,7 @@ void initSolution_alloc2(int myrank) {
   long int idx, lc, lak, onc, omin, lamuk, Nlam;
   double *lambda,fac,lambda_prv,lambda_gas,lambda_nxt,dl,dl1,frac,lag;
   double q0,q_emit,qN, waveratio=1.0, t0=0, t1=0;
-  static bool_t firsttime = true, firstl, lastl;
+  bool_t firstl, lastl;
   static const double vsign[2] = {-1.0, 1.0};
 
   for (nact = 0;  nact < atmos.Nactiveatom;  nact++) {
@@ -478,12 +480,15 @@ void initSolution_alloc2(int myrank) {
 
 
 
-  /* Things to be done only for the first task */
-  if (firsttime) {
+  /* Things to be done only for the first task of this instance.
+     The allocations themselves tell whether they were done already,
+     so that several instances can share a thread */
+  {
     /* --- Need storage for angle-dependent specific intensities for
        angle-dependent PRD --                        -------------- */
 
-    if (atmos.NPRDactive > 0 && input.PRD_angle_dep == PRD_ANGLE_DEP) {
+    if (atmos.NPRDactive > 0 && input.PRD_angle_dep == PRD_ANGLE_DEP &&
+	spectrum.PRDindex == NULL) {
       oflag = 0;
       if (input.startJ == OLD_J) {
 	if (spectrum.updateJ) {
@@ -498,7 +503,7 @@ void initSolution_alloc2(int myrank) {
 	oflag |= (O_RDWR | O_CREAT);
       }
       /* Imu file name, this may not work very well in the mpi version... */
-      sprintf(file_imu, IMU_FILE_TEMPLATE, myrank);
+      sprintf(file_imu, IMU_FILE_TEMPLATE, myrank, mpi.instance);
       
       if ((spectrum.fd_Imu = open(file_imu, oflag, PERMISSIONS)) == -1) {
 	sprintf(messageStr, "Unable to open %s file %s with permission %s",
@@ -524,7 +529,8 @@ void initSolution_alloc2(int myrank) {
       atom = atmos.activeatoms[nact];
       
       /* --- Allocate memory for the rate equation matrix -- ---------- */
-      atom->Gamma = matrix_double(SQ(atom->Nlevel), atmos.Nspace);
+      if (atom->Gamma == NULL)
+	atom->Gamma = matrix_double(SQ(atom->Nlevel), atmos.Nspace);
     }
 
 
@@ -532,10 +538,9 @@ void initSolution_alloc2(int myrank) {
       molecule = atmos.activemols[nact];
       
       /* --- Allocate memory for the rate equation matrix -- ---------- */
-      molecule->Gamma = matrix_double(SQ(molecule->Nv), atmos.Nspace);
+      if (molecule->Gamma == NULL)
+	molecule->Gamma = matrix_double(SQ(molecule->Nv), atmos.Nspace);
     }
-
-    firsttime = false;
   } /* End of first task condition */
 
 
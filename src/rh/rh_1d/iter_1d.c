@@ -26,10 +26,10 @@
 
 extern int Nlambda;
 extern double *Bp, *epsilon, *phi, *wlamb, wphi, *chi, *Sny, **Iemerge;
-extern char    messageStr[];
+extern RH_TLS char    messageStr[];
 extern struct  Ng *NgS;
 
-extern Geometry geometry;
+extern RH_TLS Geometry geometry;
 
 
 /* ------- begin -------------------------- Iterate.c --------------- */
@@ -23,25 +23,53 @@
 #include "statistics.h"
 #include "inputs.h"
 #include "rhf1d.h"
+#include "bezier.h"
 
 typedef struct {
-  bool_t eval_operator, redistribute;
-  int    nspect, iter;
-  double dJ;
+  bool_t eval_operator, redistribute, batch, active_only;
+  int    nspect, iter, first;
+  double dJ, **Jgas;
+  rhcontext *ctx;
 } threadinfo;
 
+/* --- Worker threads of the formal solution. They are started by the
+       first threaded call of solveSpectrum and kept until the instance
+       is freed, so that the thread-local tables and scratch space they
+       build (Voigt lookup table, spline and line list buffers, ...)
+       are made only once per instance --             -------------- */
+
+typedef struct {
+  struct FormalPool *pool;
+  int    n;
+} workerinfo;
+
+struct FormalPool {
+  bool_t      quit;
+  int         Nthreads, Nworker, Nbusy;
+  long        generation;
+  pthread_mutex_t lock;
+  pthread_cond_t  start, done;
+  pthread_t  *thread_id;
+  workerinfo *wi;
+  threadinfo *ti;
+  rhcontext  *ctx;
+};
+
 /* --- Function prototypes --                          -------------- */
 
 void *Formal_pthread(void *argument);
+FormalPool *newFormalPool(int Nthreads);
+void runFormalPool(FormalPool *pool, threadinfo *ti);
 
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
-extern MPI_t mpi;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
+extern RH_TLS MPI_t mpi;
+extern RH_TLS FormalPool *formal_pool;
 
 
 /* ------- begin -------------------------- Iterate.c --------------- */
@@ -51,8 +79,9 @@ void Iterate_j(int NmaxIter, double iterLimit, double *dpopmax_out)
   const char routineName[] = "Iterate";
   register int niter, nact;
 
-  bool_t    eval_operator, write_analyze_output, equilibria_only, old_ne_flag = FALSE;
-  int       Ngorder, nsum = 0;
+  bool_t    eval_operator, write_analyze_output, equilibria_only, old_ne_flag = FALSE,
+            coupled;
+  int       Ngorder, nsum = 0, N2;
   double    dpopsmax, PRDiterlimit, cswitch;
   Atom     *atom;
   Molecule *molecule;
@@ -61,23 +90,46 @@ void Iterate_j(int NmaxIter, double iterLimit, double *dpopmax_out)
   getCPU(1, TIME_START, NULL);
   
   /* --- Initialize structures for Ng acceleration of population
-         convergence --                                  ------------ */
+         convergence. With Anderson mixing the populations of active
+         hydrogen and the electron density share one accelerator, and
+         atmos.ng_ne only keeps track of the change in ne -- -------- */
+
+  coupled = (input.Ng_method == ANDERSON && input.solve_ne >= ITERATION_EOS &&
+	     atmos.atoms[0].active);
 
   for (nact = 0;  nact < atmos.Nactiveatom;  nact++) {
     atom = atmos.activeatoms[nact];
-    atom->Ng_n = NgInit(atom->Nlevel*atmos.Nspace, input.Ngdelay,
-			input.Ngorder, input.Ngperiod, atom->n[0]);
+    if (input.Ng_method == ANDERSON) {
+      N2 = (coupled && nact == 0) ? atmos.Nspace : 0;
+      atom->Ng_n = AndersonInit(atom->Nlevel*atmos.Nspace, N2,
+				input.Ngdelay, input.Ngorder,
+				atom->n[0], atmos.ne);
+    } else
+      atom->Ng_n = NgInit(atom->Nlevel*atmos.Nspace, input.Ngdelay,
+			  input.Ngorder, input.Ngperiod, atom->n[0]);
   }
   for (nact = 0;  nact < atmos.Nactivemol;  nact++) {
     molecule = atmos.activemols[nact];
     //Ngorder  = (input.accelerate_mols) ? input.Ngorder : 0;
 
-    molecule->Ng_nv = NgInit(molecule->Nv*atmos.Nspace, input.Ngdelay,
-			     input.Ngorder, input.Ngperiod, molecule->nv[0]);
+    if (input.Ng_method == ANDERSON)
+      molecule->Ng_nv = AndersonInit(molecule->Nv*atmos.Nspace, 0,
+				     input.Ngdelay, input.Ngorder,
+				     molecule->nv[0], NULL);
+    else
+      molecule->Ng_nv = NgInit(molecule->Nv*atmos.Nspace, input.Ngdelay,
+			       input.Ngorder, input.Ngperiod, molecule->nv[0]);
   }
   
-  if(input.solve_ne >= ITERATION_EOS)
-    atmos.ng_ne = NgInit(atmos.Nspace, input.Ngdelay, input.Ngorder,input.Ngperiod, atmos.ne );
+  if(input.solve_ne >= ITERATION_EOS) {
+    if (coupled)
+      atmos.ng_ne = NgInit(atmos.Nspace, input.Ngdelay, 0, input.Ngperiod, atmos.ne);
+    else if (input.Ng_method == ANDERSON)
+      atmos.ng_ne = AndersonInit(atmos.Nspace, 0, input.Ngdelay, input.Ngorder,
+				 atmos.ne, NULL);
+    else
+      atmos.ng_ne = NgInit(atmos.Nspace, input.Ngdelay, input.Ngorder,input.Ngperiod, atmos.ne );
+  }
 
   
   /* --- Start of the main iteration loop --             ------------ */
@@ -112,7 +164,8 @@ void Iterate_j(int NmaxIter, double iterLimit, double *dpopmax_out)
 
     /* --- Solve statistical equilibrium equations --  -------------- */
     
-    if(((niter+1) == input.Ngdelay) && (dpopsmax > input.ng_start_limit)){
+    if (input.Ng_method == NG_ACCELERATION &&
+	((niter+1) == input.Ngdelay) && (dpopsmax > input.ng_start_limit)){
       nsum = 1;
       if(input.solve_ne >= ITERATION_EOS && atmos.ne_flag) nsum = 4;
       
@@ -195,12 +248,19 @@ void Iterate_j(int NmaxIter, double iterLimit, double *dpopmax_out)
   
   for (nact = 0;  nact < atmos.Nactiveatom;  nact++) {
     atom = atmos.activeatoms[nact];
+    if (atom->Ng_n->method == ANDERSON) {
+      sprintf(messageStr, " %s: %d Anderson restarts\n",
+	      atom->ID, atom->Ng_n->Nrestart);
+      Error(MESSAGE, routineName, messageStr);
+    }
     freeMatrix((void **) atom->Gamma);
+    atom->Gamma = NULL;
     NgFree(atom->Ng_n);
   } 
   for (nact = 0;  nact < atmos.Nactivemol;  nact++) {
     molecule = atmos.activemols[nact];
     freeMatrix((void **) molecule->Gamma);
+    molecule->Gamma = NULL;
     NgFree(molecule->Ng_nv);
   }
   if(input.solve_ne >= ITERATION_EOS){
@@ -212,20 +272,86 @@ void Iterate_j(int NmaxIter, double iterLimit, double *dpopmax_out)
 }
 /* ------- end ---------------------------- Iterate.c --------------- */
 
+/* ------- begin -------------------------- allocThreadRates.c ------ */
+
+static void allocThreadRates(int Nthreads)
+{
+  register int nact, nt;
+
+  Atom *atom;
+
+  /* --- Zeroed per-thread copies of Gamma and the radiative rates of
+         the active atoms, filled by addtoGamma and addtoRates -- --- */
+
+  for (nact = 0;  nact < atmos.Nactiveatom;  nact++) {
+    atom = atmos.activeatoms[nact];
+    for (nt = 0;  nt < Nthreads;  nt++) {
+      atom->rhth[nt].Gamma = matrix_double(SQ(atom->Nlevel), atmos.Nspace);
+      atom->rhth[nt].Rij =
+	matrix_double(atom->Nline + atom->Ncont, atmos.Nspace);
+      atom->rhth[nt].Rji =
+	matrix_double(atom->Nline + atom->Ncont, atmos.Nspace);
+    }
+  }
+}
+/* ------- end ---------------------------- allocThreadRates.c ------ */
+
+/* ------- begin -------------------------- sumThreadRates.c -------- */
+
+static void sumThreadRates(int Nthreads, bool_t eval_operator)
+{
+  register int nact, nt, kr, k;
+
+  double *Rij, *Rji, *Rij_t, *Rji_t;
+  Atom *atom;
+
+  for (nact = 0;  nact < atmos.Nactiveatom;  nact++) {
+    atom = atmos.activeatoms[nact];
+    for (nt = 0;  nt < Nthreads;  nt++) {
+      if (eval_operator) {
+	for (k = 0;  k < SQ(atom->Nlevel)*atmos.Nspace;  k++)
+	  atom->Gamma[0][k] += atom->rhth[nt].Gamma[0][k];
+      }
+      for (kr = 0;  kr < atom->Nline + atom->Ncont;  kr++) {
+	if (kr < atom->Nline) {
+	  Rij = atom->line[kr].Rij;
+	  Rji = atom->line[kr].Rji;
+	} else {
+	  Rij = atom->continuum[kr - atom->Nline].Rij;
+	  Rji = atom->continuum[kr - atom->Nline].Rji;
+	}
+	Rij_t = atom->rhth[nt].Rij[kr];
+	Rji_t = atom->rhth[nt].Rji[kr];
+	for (k = 0;  k < atmos.Nspace;  k++) {
+	  Rij[k] += Rij_t[k];
+	  Rji[k] += Rji_t[k];
+	}
+      }
+      freeMatrix((void **) atom->rhth[nt].Gamma);
+      freeMatrix((void **) atom->rhth[nt].Rij);
+      freeMatrix((void **) atom->rhth[nt].Rji);
+      atom->rhth[nt].Gamma = NULL;
+      atom->rhth[nt].Rij = atom->rhth[nt].Rji = NULL;
+    }
+  }
+}
+/* ------- end ---------------------------- sumThreadRates.c -------- */
+
 /* ------- begin -------------------------- solveSpectrum.c --------- */
 
 double solveSpectrum(bool_t eval_operator, bool_t redistribute, int iter, bool_t synth_all)
 {
   register int nspect, n, nt, k;
 
-  int         Nthreads, lambda_max;
+  int         Nthreads, lambda_max, Nl, lane[BEZIER_NLANES];
+  bool_t      parallel, private_Jgas, batch, active_only;
   double      dJ, dJmax;
-  pthread_t  *thread_id;
   threadinfo *ti;
 
   /* --- Administers the formal solution for each wavelength. When
          input.Nthreads > 1 the solutions are performed concurrently
-         in Nthreads threads. These are POSIX style threads.
+         in Nthreads threads. These are POSIX style threads, kept in
+         a pool for the lifetime of the instance (see newFormalPool).
 
     See: - David R. Butenhof, Programming with POSIX threads,
            Addison & Wesley.
@@ -233,11 +359,29 @@ double solveSpectrum(bool_t eval_operator, bool_t redistribute, int iter, bool_t
          - Multithreaded Programming Guide, http://sun.docs.com
            (search for POSIX threads).
 
+         Thread nt solves wavelengths nt, nt + Nthreads, ..., so that
+         the scratch space atom->rhth[nspect % Nthreads] is never
+         shared. The radiative rates, Gamma and the gas-frame J are
+         accumulated per thread and summed, in thread order, once
+         all threads are done.
+
          When solveSpectrum is called with redistribute == TRUE only
          wavelengths that have an active PRD line are solved. The
          redistribute key is passed to the addtoRates routine via
          Formal so that only the radiative rates of PRD lines are
          updated. These are needed for the emission profile ratio \rho.
+
+         With FORMAL_BATCH, when only the emergent intensity is needed
+         (J is not updated and no operator or rates are evaluated),
+         wavelengths are handed to FormalBatch BEZIER_NLANES at a time.
+
+         With REDUCED_GRID the iteration (synth_all == FALSE) only
+         solves wavelengths with active transitions, which are all
+         that enter the radiative rates. J at the other wavelengths
+         (observed points outside the active transitions) is then
+         only updated by the lambda iterations of the background
+         scattering before and after the main iteration, and the
+         emergent ray is still computed on the full grid.
          --                                            -------------- */
 
   getCPU(3, TIME_START, NULL);
@@ -255,10 +399,79 @@ double solveSpectrum(bool_t eval_operator, bool_t redistribute, int iter, bool_t
 
   }
 
-  
+  batch = (input.formal_batch && !spectrum.updateJ &&
+	   !eval_operator && !redistribute);
+  active_only = (input.reduced_grid && !synth_all);
+
+  if (input.Nthreads > 1) {
+    Nthreads = input.Nthreads;
+    allocThreadRates(Nthreads);
+
+    /* --- J, J20 and the Imu are read from and written to files
+           with limit_memory and angle-dependent PRD, keep those in
+           one thread --                               -------------- */
+
+    parallel = !(input.limit_memory ||
+		 (atmos.NPRDactive > 0 && input.PRD_angle_dep == PRD_ANGLE_DEP));
+    private_Jgas = (parallel && spectrum.updateJ && atmos.NPRDactive > 0 &&
+		    input.PRD_angle_dep == PRD_ANGLE_APPROX);
+
+    ti = (threadinfo *) calloc(Nthreads, sizeof(threadinfo));
+    for (n = 0;  n < Nthreads;  n++) {
+      ti[n].eval_operator = eval_operator;
+      ti[n].redistribute  = redistribute;
+      ti[n].batch = batch;
+      ti[n].active_only = active_only;
+      ti[n].iter  = iter;
+      ti[n].first = n;
+      ti[n].Jgas  = (private_Jgas) ?
+	d2dim(-1, spectrum.nJlam, 0, atmos.Nspace-1) : NULL;
+    }
+
+    if (parallel) {
+      if (formal_pool != NULL && formal_pool->Nthreads != Nthreads) {
+	freeFormalPool(formal_pool);
+	formal_pool = NULL;
+      }
+      if (formal_pool == NULL) formal_pool = newFormalPool(Nthreads);
+    }
+    if (parallel && formal_pool->Nworker > 0) {
+      runFormalPool(formal_pool, ti);
+    } else {
+      for (n = 0;  n < Nthreads;  n++) Formal_pthread(&ti[n]);
+    }
+
+    /* --- Gather the results of the threads --         -------------- */
+    
+    for (n = 0;  n < Nthreads;  n++) {
+      if (ti[n].dJ > dJmax) {
+	dJmax = ti[n].dJ;
+	lambda_max = ti[n].nspect;
+      }
+      if (ti[n].Jgas != NULL) {
+	for (k = 0;  k < (spectrum.nJlam+2)*atmos.Nspace;  k++)
+	  spectrum.Jgas[-1][k] += ti[n].Jgas[-1][k];
+	del_d2dim(ti[n].Jgas, -1, 0);
+      }
+    }
+    free(ti);
+    
+    sumThreadRates(Nthreads, eval_operator);
+    
+  } else if (batch) {
+    for (nspect = 0;  nspect < spectrum.Nspect;  nspect += BEZIER_NLANES) {
+      Nl = MIN(BEZIER_NLANES, spectrum.Nspect - nspect);
+      for (n = 0;  n < Nl;  n++) lane[n] = nspect + n;
+
+      dJ = FormalBatch(Nl, lane, iter);
+      if (dJ > dJmax) dJmax = dJ;
+    }
+  } else {
+    
     /* --- Else call the solution for wavelengths sequentially -- --- */
       
     for (nspect = 0;  nspect < spectrum.Nspect;  nspect++) {
+      if (active_only && !containsActive(&spectrum.as[nspect])) continue;
       if (!redistribute ||
 	  (redistribute && containsPRDline(&spectrum.as[nspect]))) {
 	  dJ = Formal(nspect, eval_operator, redistribute, iter);
@@ -268,7 +481,7 @@ double solveSpectrum(bool_t eval_operator, bool_t redistribute, int iter, bool_t
 	}
       }
     }
-  
+  }
 
   sprintf(messageStr, " Spectrum max delta J = %6.4E (lambda#: %d)\n",
 	  dJmax, lambda_max);
@@ -281,16 +494,173 @@ double solveSpectrum(bool_t eval_operator, bool_t redistribute, int iter, bool_t
 }
 /* ------- end ---------------------------- solveSpectrum.c --------- */
 
+/* ------- begin -------------------------- FormalWorker.c ---------- */
+
+static void *FormalWorker(void *argument)
+{
+  register int n;
+
+  workerinfo *wi = (workerinfo *) argument;
+  FormalPool *pool = wi->pool;
+  long generation = 0;
+
+  /* --- Main loop of a worker thread of the pool. It waits for the
+         next call of runFormalPool and solves threadinfo n,
+         n + Nworker, ..., until the pool is freed -- -------------- */
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->generation == generation && !pool->quit)
+      pthread_cond_wait(&pool->start, &pool->lock);
+    if (pool->quit) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    generation = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    for (n = wi->n;  n < pool->Nthreads;  n += pool->Nworker)
+      Formal_pthread(&pool->ti[n]);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->Nbusy == 0) pthread_cond_signal(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return (NULL);
+}
+/* ------- end ---------------------------- FormalWorker.c ---------- */
+
+/* ------- begin -------------------------- newFormalPool.c --------- */
+
+FormalPool *newFormalPool(int Nthreads)
+{
+  const char routineName[] = "newFormalPool";
+  register int n;
+
+  FormalPool *pool;
+
+  /* --- Start Nthreads worker threads. If fewer can be started the
+         work of the missing ones is shared by the others, and with
+         none at all solveSpectrum runs the threadinfo sequentially. */
+
+  pool = (FormalPool *) calloc(1, sizeof(FormalPool));
+  pool->Nthreads  = Nthreads;
+  pool->thread_id = (pthread_t *) malloc(Nthreads * sizeof(pthread_t));
+  pool->wi = (workerinfo *) malloc(Nthreads * sizeof(workerinfo));
+  pool->ctx = rh_snapshot_context(NULL);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  for (n = 0;  n < Nthreads;  n++) {
+    pool->wi[n].pool = pool;
+    pool->wi[n].n = n;
+    if (pthread_create(&pool->thread_id[n], &input.thread_attr,
+		       FormalWorker, &pool->wi[n])) break;
+  }
+  pool->Nworker = n;
+
+  if (pool->Nworker < Nthreads) {
+    sprintf(messageStr, "Could only start %d of %d threads",
+	    pool->Nworker, Nthreads);
+    Error(WARNING, routineName, messageStr);
+  }
+  return pool;
+}
+/* ------- end ---------------------------- newFormalPool.c --------- */
+
+/* ------- begin -------------------------- runFormalPool.c --------- */
+
+void runFormalPool(FormalPool *pool, threadinfo *ti)
+{
+  register int n;
+
+  /* --- Hand threadinfo ti[0..Nthreads-1] to the workers, which take
+         over the current state of the calling thread, and wait until
+         all of them are done --                       -------------- */
+
+  rh_snapshot_context(pool->ctx);
+  for (n = 0;  n < pool->Nthreads;  n++) ti[n].ctx = pool->ctx;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->ti = ti;
+  pool->Nbusy = pool->Nworker;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+
+  while (pool->Nbusy > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+/* ------- end ---------------------------- runFormalPool.c --------- */
+
+/* ------- begin -------------------------- freeFormalPool.c -------- */
+
+void freeFormalPool(FormalPool *pool)
+{
+  register int n;
+
+  if (pool == NULL) return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = TRUE;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (n = 0;  n < pool->Nworker;  n++)
+    pthread_join(pool->thread_id[n], NULL);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  rh_free_snapshot(pool->ctx);
+  free(pool->thread_id);
+  free(pool->wi);
+  free(pool);
+}
+/* ------- end ---------------------------- freeFormalPool.c -------- */
+
 /* ------- begin -------------------------- Formal_pthread.c -------- */
 
 void *Formal_pthread(void *argument)
 {
   threadinfo *ti = (threadinfo *) argument;
+  int    nspect, Nl, lane[BEZIER_NLANES];
+  double dJ;
   
-  /* --- Threads wrapper around Formal --              -------------- */
+  /* --- Threads wrapper around Formal. A new thread starts with
+         empty globals and first takes over those of its parent -- - */
+
+  if (ti->ctx != NULL) rh_load_context(ti->ctx);
+  if (ti->Jgas != NULL) spectrum.Jgas = ti->Jgas;
+
+  ti->dJ = 0.0;
+  ti->nspect = 0;
 
-  ti->dJ = Formal(ti->nspect, ti->eval_operator, ti->redistribute, (int)ti->iter);
+  if (ti->batch) {
+    nspect = ti->first;
+    while (nspect < spectrum.Nspect) {
+      for (Nl = 0;  Nl < BEZIER_NLANES && nspect < spectrum.Nspect;
+	   nspect += input.Nthreads)
+	lane[Nl++] = nspect;
 
+      dJ = FormalBatch(Nl, lane, ti->iter);
+      if (dJ > ti->dJ) ti->dJ = dJ;
+    }
+    return (NULL);
+  }
+  
+  for (nspect = ti->first;  nspect < spectrum.Nspect;
+       nspect += input.Nthreads) {
+    if (ti->active_only && !containsActive(&spectrum.as[nspect])) continue;
+    if (!ti->redistribute || containsPRDline(&spectrum.as[nspect])) {
+      dJ = Formal(nspect, ti->eval_operator, ti->redistribute, ti->iter);
+      if (dJ > ti->dJ) {
+	ti->dJ = dJ;
+	ti->nspect = nspect;
+      }
+    }
+  }
   return (NULL);
 }
 /* ------- end ---------------------------- Formal_pthread.c -------- */
@@ -43,15 +43,15 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern CommandLine commandline;
-extern char messageStr[];
-extern Geometry geometry;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
+extern RH_TLS Geometry geometry;
 
 extern enum Topology topology;
-extern rhbgmem *bmem;
+extern RH_TLS rhbgmem *bmem;
 int readBackground_j(int la, int mu, bool_t to_obs);
 extern double VoigtArmstrong(double, double);
 
@@ -44,11 +44,11 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Geometry geometry;
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern char messageStr[];
-extern MPI_t mpi;
+extern RH_TLS Geometry geometry;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS char messageStr[];
+extern RH_TLS MPI_t mpi;
 
 #define swap(a,b,c) (c=a,a=b,b=c)
 
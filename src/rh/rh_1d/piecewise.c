@@ -35,10 +35,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Geometry geometry;
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern char messageStr[];
+extern RH_TLS Geometry geometry;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS char messageStr[];
 
 /* --------------------------------------------------------------- */
 #define min(a,b) (((a)<(b))?(a):(b))
@@ -19,8 +19,8 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Geometry geometry;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Geometry geometry;
 
 
 /* ------- begin -------------------------- vproject.c -------------- */
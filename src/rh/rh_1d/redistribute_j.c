@@ -26,13 +26,13 @@ double MaxChange_j(struct Ng *Ngs, char *text, bool_t quiet);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern CommandLine commandline;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
 //extern MPI_data mpi;
-extern char messageStr[];
-extern MPI_t mpi;
+extern RH_TLS char messageStr[];
+extern RH_TLS MPI_t mpi;
 
 /* ------- begin -------------------------- Redistribute.c ---------- */
 
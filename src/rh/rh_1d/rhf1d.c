@@ -35,6 +35,7 @@
 #include "geometry.h"
 #include "spectrum.h"
 #include "background.h"
+#include "accelerate.h"
 #include "math.h"
 #include "statistics.h"
 #include "error.h"
@@ -56,28 +57,263 @@
 
 enum Topology topology = ONE_D_PLANE;
 
-Atmosphere atmos;
-Geometry geometry;
-Spectrum spectrum;
-ProgramStats stats;
-InputData input;
-CommandLine commandline;
-char messageStr[MAX_MESSAGE_LENGTH];
-rhinfo io;
-BackgroundData bgdat;
-rhbgmem *bmem; // To store background opac in mem
-crhpop *save_popp;
-MPI_t mpi;
+/* --- The globals are thread-local. rhf1d copies the state of the
+       calling instance into them on entry and back on exit, so each
+       thread can run its own instance of the code --  -------------- */
+
+RH_TLS Atmosphere atmos;
+RH_TLS Geometry geometry;
+RH_TLS Spectrum spectrum;
+RH_TLS ProgramStats stats;
+RH_TLS InputData input;
+RH_TLS CommandLine commandline;
+RH_TLS char messageStr[MAX_MESSAGE_LENGTH];
+RH_TLS rhinfo io;
+RH_TLS BackgroundData bgdat;
+RH_TLS rhbgmem *bmem; // To store background opac in mem
+RH_TLS FormalPool *formal_pool; // worker threads of solveSpectrum
+RH_TLS crhpop *save_popp;
+RH_TLS MPI_t mpi;
 
 #define min(a,b) (((a)<(b))?(a):(b))
 #define max(a,b) (((a)>(b))?(a):(b))
 
+
+/* --- State of one instance of the code, including what used to be
+       kept in static variables of rhf1d --            -------------- */
+
+struct rhcontext {
+  int id;
+  bool_t firsttime;
+  Atmosphere atmos;
+  Geometry geometry;
+  Spectrum spectrum;
+  ProgramStats stats;
+  InputData input;
+  CommandLine commandline;
+  rhinfo io;
+  BackgroundData bgdat;
+  rhbgmem *bmem;
+  FormalPool *formal_pool;
+  MPI_t mpi;
+  int save_Nrays;
+  double save_muz, save_mux, save_muy, save_wmu;
+  enum StokesMode oldMode;
+};
+
+static int ncontext = 0;
+
+static void freeInstance(void);
+
+rhcontext *rh_new_context(void)
+{
+  rhcontext *ctx = (rhcontext*)calloc(1, sizeof(rhcontext));
+
+  ctx->id = __sync_fetch_and_add(&ncontext, 1);
+  ctx->firsttime = TRUE;
+  
+  return ctx;
+}
+
+void rh_free_context(rhcontext *ctx)
+{
+  /* --- Stops the worker threads and frees the models and buffers of
+         the instance. The globals of the calling thread are cleared
+         afterwards, so that nothing points to the freed memory -- -- */
+  
+  freeFormalPool(ctx->formal_pool);
+  ctx->formal_pool = NULL;
+
+  if (!ctx->firsttime) {
+    rh_load_context(ctx);
+    freeInstance();
+
+    memset(&atmos, 0, sizeof(Atmosphere));
+    memset(&geometry, 0, sizeof(Geometry));
+    memset(&spectrum, 0, sizeof(Spectrum));
+    memset(&bgdat, 0, sizeof(BackgroundData));
+    memset(&io, 0, sizeof(rhinfo));
+    bmem = NULL;
+    stats.fp_CPU = NULL;
+  }
+  free(ctx);
+}
+
+void rh_load_context(rhcontext *ctx)
+{
+  atmos = ctx->atmos;
+  geometry = ctx->geometry;
+  spectrum = ctx->spectrum;
+  stats = ctx->stats;
+  input = ctx->input;
+  commandline = ctx->commandline;
+  io = ctx->io;
+  bgdat = ctx->bgdat;
+  bmem = ctx->bmem;
+  formal_pool = ctx->formal_pool;
+  mpi = ctx->mpi;
+}
+
+static void rh_store_context(rhcontext *ctx)
+{
+  ctx->atmos = atmos;
+  ctx->geometry = geometry;
+  ctx->spectrum = spectrum;
+  ctx->stats = stats;
+  ctx->input = input;
+  ctx->commandline = commandline;
+  ctx->io = io;
+  ctx->bgdat = bgdat;
+  ctx->bmem = bmem;
+  ctx->formal_pool = formal_pool;
+  ctx->mpi = mpi;
+}
+
+rhcontext *rh_snapshot_context(rhcontext *ctx)
+{
+  if(ctx == NULL) ctx = (rhcontext*)calloc(1, sizeof(rhcontext));
+
+  ctx->id = mpi.instance;
+  rh_store_context(ctx);
+  
+  return ctx;
+}
+
+void rh_free_snapshot(rhcontext *ctx)
+{
+  free(ctx);
+}
+
+/* --- Free everything the instance loaded in the globals allocated.
+       The depth-dependent arrays of the model atmosphere (T, ne,
+       vturb, ...) belong to the caller and are left alone -- ------- */
+
+static void freeInstance(void)
+{
+  register int n, nspect, nact, kr;
+
+  Atom *atom;
+  AtomicLine *line;
+  Molecule *molecule;
+  Element *element;
+  ActiveSet *as;
+
+  free_Background_j();
+
+  /* --- Active sets and the wavelength grid (see SortLambda_j) -- -- */
+
+  for (nspect = 0;  nspect < spectrum.Nspect;  nspect++) {
+    as = &spectrum.as[nspect];
+    for (nact = 0;  nact < atmos.Nactiveatom;  nact++) {
+      free(as->art[nact]);
+      free(as->lower_levels[nact]);
+      free(as->upper_levels[nact]);
+    }
+    for (nact = 0;  nact < atmos.Nactivemol;  nact++) free(as->mrt[nact]);
+    free(as->Nactiveatomrt);  free(as->art);
+    free(as->Nactivemolrt);   free(as->mrt);
+    free(as->Nlower);         free(as->Nupper);
+    free(as->lower_levels);   free(as->upper_levels);
+  }
+  free(spectrum.as);
+  if (spectrum.lambda != NULL) free(spectrum.lambda - 1);
+  free(spectrum.linfo);
+  free(spectrum.PRDlines);
+
+  /* --- Radiation field and PRD bookkeeping --        -------------- */
+
+  if (spectrum.J != NULL)        freeMatrix((void **) spectrum.J);
+  if (spectrum.J20 != NULL)      freeMatrix((void **) spectrum.J20);
+  if (spectrum.I != NULL)        freeMatrix((void **) spectrum.I);
+  if (spectrum.Stokes_Q != NULL) freeMatrix((void **) spectrum.Stokes_Q);
+  if (spectrum.Stokes_U != NULL) freeMatrix((void **) spectrum.Stokes_U);
+  if (spectrum.Stokes_V != NULL) freeMatrix((void **) spectrum.Stokes_V);
+  if (spectrum.v_los != NULL)    freeMatrix((void **) spectrum.v_los);
+  if (spectrum.Jgas != NULL)     del_d2dim(spectrum.Jgas, -1, 0);
+  if (spectrum.Jlam != NULL)     free(spectrum.Jlam - 1);
+  if (spectrum.nc != NULL)       free(spectrum.nc - 1);
+  free(spectrum.iprdh);
+  free(spectrum.cprdh);
+  if (spectrum.PRDindex != NULL) {
+    free(spectrum.PRDindex);
+    close(spectrum.fd_Imu);
+  }
+
+  /* --- Atomic models, including what initSolution_j and the PRD
+         iterations added to the lines. The wavelengths of active
+         transitions point into spectrum.lambda -- -------------- */
+
+  for (n = 0;  n < atmos.Natom;  n++) {
+    atom = &atmos.atoms[n];
+    for (kr = 0;  kr < atom->Nline;  kr++) {
+      line = &atom->line[kr];
+      if (atom->active) line->lambda = NULL;
+      if (line->Ng_prd != NULL) NgFree(line->Ng_prd);
+      freeGIIstore(line);
+      if (line->gII != NULL)  freeMatrix((void **) line->gII);
+      if (line->frac != NULL) freeMatrix((void **) line->frac);
+      if (line->id0 != NULL)  freeMatrix((void **) line->id0);
+      if (line->id1 != NULL)  freeMatrix((void **) line->id1);
+      if (line->xrd != NULL)  free(line->xrd);
+    }
+    if (atom->active) {
+      for (kr = 0;  kr < atom->Ncont;  kr++)
+	atom->continuum[kr].lambda = NULL;
+      free(atom->rhth);
+    }
+    freeAtom(atom);
+  }
+  free(atmos.atoms);
+  free(atmos.activeatoms);
+
+  for (n = 0;  n < atmos.Nmolecule;  n++) {
+    molecule = &atmos.molecules[n];
+    if (molecule->active) {
+      for (kr = 0;  kr < molecule->Nrt;  kr++)
+	molecule->mrt[kr].lambda = NULL;
+      free(molecule->rhth);
+    }
+    freeMolecule(molecule);
+  }
+  free(atmos.molecules);
+  free(atmos.activemols);
+
+  for (n = 0;  n < atmos.Nelem;  n++) {
+    element = &atmos.elements[n];
+    if (element->pf != NULL) freeMatrix((void **) element->pf);
+    if (element->n != NULL)  freeMatrix((void **) element->n);
+    free(element->ionpot);
+    free(element->mol_index);
+  }
+  free(atmos.elements);
+  free(atmos.Tpf);
+
+  /* --- The rest of the atmosphere and the geometry -- ------------- */
+
+  free(atmos.N);
+  if (atmos.nH != NULL)      freeMatrix((void **) atmos.nH);
+  free(atmos.nHmin);
+  if (atmos.cos_gamma != NULL) freeMatrix((void **) atmos.cos_gamma);
+  if (atmos.cos_2chi != NULL)  freeMatrix((void **) atmos.cos_2chi);
+  if (atmos.sin_2chi != NULL)  freeMatrix((void **) atmos.sin_2chi);
+
+  free(geometry.mux);  free(geometry.muy);
+  free(geometry.muz);  free(geometry.wmu);
+  if (geometry.Itop != NULL)    freeMatrix((void **) geometry.Itop);
+  if (geometry.Ibottom != NULL) freeMatrix((void **) geometry.Ibottom);
+
+  free(io.atom_file_pos);
+  if (stats.fp_CPU != NULL) fclose(stats.fp_CPU);
+}
+
 /* ---- Check for directory --- */
 
 int bdir_exists(const char *name){
   DIR* dir = opendir(name);
-  if (dir) return 1;
-  else return 0;
+  if (dir) {
+    closedir(dir);
+    return 1;
+  } else return 0;
 }
 
 
@@ -98,25 +334,25 @@ bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho,
 	     double *rhs_z, double *rhs_nhtot, double *rhs_tau ,
 	     double *rhs_cmass, double gravity, bool_t stokes, ospec *sp,
 	     crhpop *save_pop, int mynw, double *mylambda, int myrank, int savpop,
-	     int iverbose, int *hydrostat, int computing_derivatives)
+	     int iverbose, int *hydrostat, int computing_derivatives,
+	     double iter_scale, rhcontext *ctx)
 {
   
-  bool_t write_analyze_output, equilibria_only, quiet = ((iverbose <= 1)? TRUE : FALSE);
+  bool_t write_analyze_output, equilibria_only, fixed_pops, quiet = ((iverbose <= 1)? TRUE : FALSE);
   int    niter, nact, i, sNgperiod, sNgdelay, sPRDNITER,k;
-  static int save_Nrays;
-  static double save_muz, save_mux, save_muy, save_wmu;
-  static enum StokesMode oldMode;
+  double sNgstart;
 
-  double dpopmax, *ne_lte = NULL;
-  static Atom *atom;
-  static Molecule *molecule;
+  double dpopmax, iterLimit, *ne_lte = NULL;
+  Atom *atom;
  
-  static bool_t firsttime = TRUE;
+  bool_t firsttime = ctx->firsttime;
  
   int argc = 1;
   char *argv[] = {"rhf1d",NULL};
 
 
+  rh_load_context(ctx);
+  mpi.instance = ctx->id;
   adjust_vlos(rhs_v, rhs_ndep, muz);
   
   if(firsttime){
@@ -151,12 +387,15 @@ bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho,
     readInput();
     readAbundance(&atmos);
     DUMMYatmos(&atmos, &geometry, firsttime);
-    oldMode = input.StokesMode;
+    ctx->oldMode = input.StokesMode;
     mpi.rank = myrank;
   }
   mpi.stop = false;
 
 
+  iterLimit = input.iterLimit * ((iter_scale > 0.0) ? iter_scale : 1.0);
+
+  
   /* --- Store Ng values --- */
 
   sNgperiod = input.Ngperiod;
@@ -179,7 +418,7 @@ bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho,
   atmos.nHtot = rhs_nhtot;
   atmos.rho = rhs_rho;
   save_popp = save_pop;
-  input.StokesMode = oldMode;
+  input.StokesMode = ctx->oldMode;
   spectrum.updateJ = TRUE;  
   getCPU(1, TIME_START, NULL);
   if (input.StokesMode > NO_STOKES)
@@ -206,11 +445,12 @@ bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho,
     
     /* --- Save geometry values to change back after --    ------------ */
     
-    save_Nrays = atmos.Nrays;   save_wmu = geometry.wmu[0];
-    save_muz = geometry.muz[0]; save_mux = geometry.mux[0]; save_muy = geometry.muy[0];
+    ctx->save_Nrays = atmos.Nrays;   ctx->save_wmu = geometry.wmu[0];
+    ctx->save_muz = geometry.muz[0]; ctx->save_mux = geometry.mux[0];
+    ctx->save_muy = geometry.muy[0];
   }
   
-  firsttime = FALSE;
+  ctx->firsttime = FALSE;
   
   if(input.solve_ne >= ITERATION_EOS){
     if(atmos.atoms[0].active) atmos.ne_flag = TRUE;
@@ -241,47 +481,67 @@ bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho,
     getProfiles();
     initSolution_j( myrank, savpop);
 
+    fixed_pops = FALSE;
     if(computing_derivatives || (input.solve_ne < ITERATION_EOS))
-       read_populations(save_pop,0);
-
-    if((savpop == 0) && 1){
-      input.Ngdelay = min(15,input.Ngdelay) ;
-      input.Ngperiod = min(13,input.Ngperiod) ;
-      //input.PRD_NmaxIter = min(3,input.PRD_NmaxIter) ;
-    }
+      fixed_pops = (read_populations(save_pop,0) == atmos.Nactiveatom) &&
+	((computing_derivatives == DERIVATIVES_FIXED_POPS) ||
+	 (computing_derivatives == DERIVATIVES_MAGNETIC &&
+	  input.StokesMode <= FIELD_FREE));
 
     // for(niter=0; niter<spectrum.nPRDlines; niter++)
     // fprintf(stderr,"prdline->frac[0][0]=%e\n", spectrum.PRDlines[niter]->frac[0][0]);
     
-    initScatter();
+    if(fixed_pops){
+
+      /* --- Keep the departure coefficients and radiation field of
+	 the saved solution, only the output ray is computed --- */
+      
+      dpopmax = 0.0;
+      if(atmos.Nactiveatom > 0 && atmos.Stokes && input.StokesMode > NO_STOKES)
+	input.StokesMode = FULL_STOKES;
+      
+    } else {
+      if((savpop == 0) && 1){
+	input.Ngdelay = min(15,input.Ngdelay) ;
+	input.Ngperiod = min(13,input.Ngperiod) ;
+	//input.PRD_NmaxIter = min(3,input.PRD_NmaxIter) ;
+      }
+      
+      initScatter();
     
-    //getCPU(1, TIME_POLL, "Total Initialize");
+      //getCPU(1, TIME_POLL, "Total Initialize");
     
     
-    /* --- Solve radiative transfer for active ingredients -- --------- */
+      /* --- Solve radiative transfer for active ingredients. With a
+	     looser convergence limit Ng may start earlier too -- ----- */
     
-    Iterate_j(input.NmaxIter, input.iterLimit, &dpopmax);
-    if(isnan(dpopmax) || isinf(dpopmax) || dpopmax < 0){
-      mpi.stop = true;
-    }
+      sNgstart = input.ng_start_limit;
+      input.ng_start_limit *= iterLimit / input.iterLimit;
+      
+      Iterate_j(input.NmaxIter, iterLimit, &dpopmax);
+      if(isnan(dpopmax) || isinf(dpopmax) || dpopmax < 0){
+	mpi.stop = true;
+      }
 
-    input.Ngdelay=sNgdelay, input.Ngperiod = sNgperiod, input.PRD_NmaxIter = sPRDNITER;
+      input.Ngdelay=sNgdelay, input.Ngperiod = sNgperiod, input.PRD_NmaxIter = sPRDNITER;
+      input.ng_start_limit = sNgstart;
     
     
-    /* --- Adjust stokes mode in case we are running POLARIZATION_FREE --- */
+      /* --- Adjust stokes mode in case we are running POLARIZATION_FREE --- */
     
-    if(!mpi.stop){
-      adjustStokesMode();
-      niter = 0;
+      if(!mpi.stop){
+	adjustStokesMode();
+	niter = 0;
       
-      while ((niter < input.NmaxScatter)) {
-	if (solveSpectrum(FALSE, FALSE, 0, TRUE) <= input.iterLimit) break;
-	niter++;
-      }
-    } else dpopmax = 1.0e13;
+	while ((niter < input.NmaxScatter)) {
+	  if (solveSpectrum(FALSE, FALSE, 0, TRUE) <= iterLimit) break;
+	  niter++;
+	}
+      } else dpopmax = 1.0e13;
+    }
   } else dpopmax = 1.0e13;
   
-  bool_t converged = dpopmax < input.iterLimit;
+  bool_t converged = dpopmax < iterLimit;
 
   /* --- Store populations if needed --- */
 
@@ -306,18 +566,18 @@ bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho,
     
     /* --- Put back previous values for geometry  --- */
     
-    atmos.Nrays     = save_Nrays;
-    geometry.Nrays = save_Nrays;
-    geometry.muz[0] = save_muz;
-    geometry.mux[0] = save_mux;
-    geometry.muy[0] = save_muy;
-    geometry.wmu[0] = save_wmu;
+    atmos.Nrays     = ctx->save_Nrays;
+    geometry.Nrays = ctx->save_Nrays;
+    geometry.muz[0] = ctx->save_muz;
+    geometry.mux[0] = ctx->save_mux;
+    geometry.muy[0] = ctx->save_muy;
+    geometry.wmu[0] = ctx->save_wmu;
     spectrum.updateJ = TRUE;
 
 
   }
 
-  input.StokesMode = oldMode;
+  input.StokesMode = ctx->oldMode;
 
   
   /* --- Copy desired ray to output arrays---*/
@@ -371,6 +631,9 @@ bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho,
     //else exit(0);
   }
 
+  rh_store_context(ctx);
+  save_popp = NULL;
+  
   return converged;
 }
 
@@ -409,7 +672,7 @@ void clean_saved_populations(crhpop *save_pop){
     free(save_pop->pop);
     free(save_pop->lambda);
     free(save_pop->J);
-    if(input.backgr_pol) free(save_pop->J20);
+    if(save_pop->J20) free(save_pop->J20);
     free(save_pop->tau_ref);
     if(save_pop->ne_dep){
       free(save_pop->ne_dep);
@@ -538,7 +801,7 @@ void save_populations(crhpop *save_pop, double *ne_lte){
   
 }
 
-void read_populations(crhpop *save_pop, int flag){
+int read_populations(crhpop *save_pop, int flag){
   Atom *atom;
   int    niter, nact, save_Nrays, nactotal, ii, nprd, kr, kkr, copied = 0;
   AtomicLine *line;
@@ -549,7 +812,8 @@ void read_populations(crhpop *save_pop, int flag){
   if(save_pop->pop == NULL || save_pop->nactive != atmos.Nactiveatom){
     // fprintf(stderr,"read_population: atmos->Nactiveatom[%d] != save_pop->nactive[%d]\n",
     //atmos.Nactiveatom, save_pop->nactive);
-    return;
+    free(tmp1);
+    return 0;
   }
 
   
@@ -649,6 +913,7 @@ void read_populations(crhpop *save_pop, int flag){
   }
   
   free(tmp1);
+  return copied;
 }
 
 
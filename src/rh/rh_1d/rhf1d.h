@@ -12,8 +12,10 @@ extern "C" {
   } rhinfo;
   
   typedef struct{
-    bool_t allocated;
+    bool_t allocated, shared;
+    int Nrec, nstokes;
     double **chi_b, **eta_b, **sca_b, **chip_b;
+    float  **chi_s, **eta_s, **sca_s, **chip_s;
   } rhbgmem;
   
   typedef struct{
@@ -39,26 +41,71 @@ extern "C" {
   } crhpop;
   
   typedef struct{
-    int rank, verb, iter;
+    int rank, verb, iter, instance;
     bool_t stop;
     FILE *logfile;
     char filename[300];
   } MPI_t;
   
+  /* --- Opaque per-instance state of rhf1d (see rhf1d.c). Each
+         object that calls rhf1d owns one, so several of them can
+         run in separate threads of the same process --  ------------ */
+  
+  typedef struct rhcontext rhcontext;
+  
+  rhcontext *rh_new_context(void);
+  void rh_free_context(rhcontext *ctx);
+
+  /* --- Copy of the current thread's state, and the inverse, so that
+         worker threads can take over the state of their parent. The
+         snapshot is written into ctx, or into a new record when ctx
+         is NULL. It shares the data of the instance, so it is freed
+         with rh_free_snapshot and not with rh_free_context --- */
+  
+  rhcontext *rh_snapshot_context(rhcontext *ctx);
+  void rh_free_snapshot(rhcontext *ctx);
+  void rh_load_context(rhcontext *ctx);
+
+  /* --- Worker threads of the formal solution of an instance (see
+         iterate_j.c) --                               -------------- */
+
+  typedef struct FormalPool FormalPool;
+
+  void freeFormalPool(FormalPool *pool);
+  
   void save_populations(crhpop *save_pop, double *ne_lte);
-  void read_populations(crhpop *save_pop, int flag);
+  int  read_populations(crhpop *save_pop, int flag);
   void clean_saved_populations(crhpop *save_pop_ref);
   void UpdateAtmosDep(void);
   void Initvarious();
   void calculateRay(void);
 
+  /* --- With computing_derivatives == DERIVATIVES_FIXED_POPS the
+         departure coefficients and radiation field in save_pop are
+         kept instead of solving the statistical equilibrium again,
+         only the output ray is computed. Used for approximate
+         Jacobians, falls back to the full solution when save_pop
+         does not match the active atoms --           -------------- */
+
+#define DERIVATIVES_FIXED_POPS  2
+
+  /* --- DERIVATIVES_MAGNETIC does the same when only the magnetic
+         field was perturbed and the populations are solved without
+         it (NO_STOKES or FIELD_FREE), so the result is exact --- */
+
+#define DERIVATIVES_MAGNETIC    3
+
+  /* --- The populations are converged to iter_scale times ITER_LIMIT
+         (keyword.input), values <= 0 are treated as 1 --  ---------- */
+
   bool_t rhf1d(float muz, int rhs_ndep, double *rhs_T, double *rhs_rho, 
 	       double *rhs_nne, double *rhs_vturb, double *rhs_v, 
 	       double *rhs_B, double *rhs_inc, double *rhs_azi,
 	       double *rhs_z, double *rhs_nhtot, double *rhs_ltau,
 	       double *rhs_cmass, double gravity, bool_t stokes, ospec *sp,
 	       crhpop *save_pop, int mynw, double *mylambda, int myrank, int savpop,
-	       int iverbose, int *hydrostat, int computing_derivatives);
+	       int iverbose, int *hydrostat, int computing_derivatives,
+	       double iter_scale, rhcontext *ctx);
 
   void   Redistribute_j(int NmaxIter, double iterLimit, double iprec);
   void hermitian_interpolation(int n, double *x, double *y, int nn, double *xp, double *yp, int lo);
@@ -54,7 +54,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Geometry geometry;
+extern RH_TLS Geometry geometry;
 
 
 /* ------- begin -------------------------- RII.c ------------------- */
@@ -63,8 +63,8 @@ double RII(double v_emit, double v_abs, double adamp, int mu1, int mu2)
 {
   const char routineName[] = "RII";
   register int n;
-  static bool_t initialize = TRUE;
-  static double xg0[N_GAUSS_QUADR], wg0[N_GAUSS_QUADR];
+  static RH_TLS bool_t initialize = TRUE;
+  static RH_TLS double xg0[N_GAUSS_QUADR], wg0[N_GAUSS_QUADR];
 
   double theta_min, theta_plus, vmin, vplus, theta1, theta2,
     xg[N_GAUSS_QUADR], wg[N_GAUSS_QUADR], rii, mu12, muz1, muz2,
@@ -13,13 +13,17 @@
           Eliza Miller-Ricci (Middlebury College), Jun 29 2001 
 
 
- Note: Scratch files for the redistribution weights are now written
-       in a location determined from PRD_FILE_TEMPLATE. The files are
-       no longer automatically deleted. Careful, they can be quite big.
+ Note: The redistribution weights are kept in memory in the GII
+       store of the line (see atom.h). Only when PRD_GII_MEM_LIMIT
+       (in MB, per RH instance) would be exceeded are they spilled to a
+       scratch file in a location determined from PRD_FILE_TEMPLATE.
+       These files are not automatically deleted. With PRD_GII_SINGLE
+       the weights are stored in single precision.
        --                                              -------------- */
 
  
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "rh.h"
@@ -36,17 +40,154 @@
 
 /* --- Function prototypes --                          -------------- */
 
+static void openGIIfile(AtomicLine *PRDline, const char *mode);
+static void rewindGII(AtomicLine *PRDline);
+static int  writeGII(AtomicLine *PRDline, double *gii, int Np);
+static int  readGII(AtomicLine *PRDline, double *gii, int Np);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 //extern MPI_data mpi;
-extern MPI_t mpi;
+extern RH_TLS MPI_t mpi;
 
 
+/* ------- begin -------------------------- openGIIfile.c ----------- */
+
+static void openGIIfile(AtomicLine *PRDline, const char *mode)
+{
+  const char routineName[] = "openGIIfile";
+
+  char  filename[MAX_LINE_SIZE];
+  Atom *atom = PRDline->atom;
+
+  sprintf(filename,
+	  (atom->ID[1] == ' ') ? PRD_FILE_TEMPLATE1 : PRD_FILE_TEMPLATE,
+	  atom->ID, PRDline->j, PRDline->i, mpi.rank, mpi.instance);
+
+  if ((PRDline->fp_GII = fopen(filename, mode)) == NULL) {
+    sprintf(messageStr, "Unable to open temporary file %s", filename);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+}
+/* ------- end ---------------------------- openGIIfile.c ----------- */
+
+/* ------- begin -------------------------- rewindGII.c ------------- */
+
+static void rewindGII(AtomicLine *PRDline)
+{
+  PRDline->GII.pos = 0;
+  if (PRDline->fp_GII != NULL) rewind(PRDline->fp_GII);
+}
+/* ------- end ---------------------------- rewindGII.c ------------- */
+
+/* ------- begin -------------------------- writeGII.c -------------- */
+
+static int writeGII(AtomicLine *PRDline, double *gii, int Np)
+{
+  register long n;
+
+  GIIstore *store = &PRDline->GII;
+  size_t    size, Nnew;
+  double    limit, *ddata;
+  float    *fdata;
+
+  /* --- Append Np weights to the store of PRDline, or to its scratch
+         file once the store has been spilled. Returns the number of
+         weights written. --                           -------------- */
+
+  if (PRDline->fp_GII != NULL)
+    return fwrite(gii, sizeof(double), Np, PRDline->fp_GII);
+
+  if (store->N == 0) store->single = input.PRD_GII_single;
+  size = (store->single) ? sizeof(float) : sizeof(double);
+
+  if (store->N + Np > store->Nalloc) {
+    Nnew = MAX(2 * store->Nalloc, store->N + Np);
+
+    /* --- Spill to file when the instance would exceed its limit - - */
+
+    limit = input.PRD_GII_memlimit * 1024.0 * 1024.0;
+    if (limit > 0.0 &&
+	spectrum.GIIbytes + (Nnew - store->Nalloc) * size > limit) {
+      openGIIfile(PRDline, "w+");
+
+      ddata = (double *) store->data;
+      fdata = (float *) store->data;
+      for (n = 0;  n < store->N;  n++) {
+	double g = (store->single) ? fdata[n] : ddata[n];
+	fwrite(&g, sizeof(double), 1, PRDline->fp_GII);
+      }
+      freeGIIstore(PRDline);
+      return fwrite(gii, sizeof(double), Np, PRDline->fp_GII);
+    }
+    store->data = realloc(store->data, Nnew * size);
+    spectrum.GIIbytes += (Nnew - store->Nalloc) * size;
+    store->Nalloc = Nnew;
+  }
+
+  if (store->single) {
+    fdata = (float *) store->data + store->N;
+    for (n = 0;  n < Np;  n++) fdata[n] = (float) gii[n];
+  } else
+    memcpy((double *) store->data + store->N, gii, Np * sizeof(double));
+
+  store->N += Np;
+  return Np;
+}
+/* ------- end ---------------------------- writeGII.c -------------- */
+
+/* ------- begin -------------------------- readGII.c --------------- */
+
+static int readGII(AtomicLine *PRDline, double *gii, int Np)
+{
+  register long n;
+
+  GIIstore *store = &PRDline->GII;
+  float    *fdata;
+
+  /* --- Read the next Np weights in the order they were written.
+         Returns the number of weights read. --        -------------- */
+
+  if (PRDline->fp_GII != NULL)
+    return fread(gii, sizeof(double), Np, PRDline->fp_GII);
+
+  if (store->pos + Np > store->N) return 0;
+
+  if (store->single) {
+    fdata = (float *) store->data + store->pos;
+    for (n = 0;  n < Np;  n++) gii[n] = fdata[n];
+  } else
+    memcpy(gii, (double *) store->data + store->pos, Np * sizeof(double));
+
+  store->pos += Np;
+  return Np;
+}
+/* ------- end ---------------------------- readGII.c --------------- */
+
+/* ------- begin -------------------------- freeGIIstore.c ---------- */
+
+void freeGIIstore(AtomicLine *PRDline)
+{
+  GIIstore *store = &PRDline->GII;
+
+  /* --- Release the in-memory weights of PRDline. A scratch file the
+         store was spilled to is left open so that reading continues
+         from it; it is closed when the atmosphere is updated. -- --- */
+
+  if (store->data != NULL) {
+    free(store->data);
+    spectrum.GIIbytes -= store->Nalloc *
+      ((store->single) ? sizeof(float) : sizeof(double));
+  }
+  store->data = NULL;
+  store->N = store->Nalloc = store->pos = 0;
+}
+/* ------- end ---------------------------- freeGIIstore.c ---------- */
+
 /* ------- begin -------------------------- PRDScatter.c ------------ */
 
 void PRDScatter(AtomicLine *PRDline, enum Interpolation representation)
@@ -54,7 +195,6 @@ void PRDScatter(AtomicLine *PRDline, enum Interpolation representation)
   const char routineName[] = "scatterIntegral";
   register int  la, k, lap, kr, ip, kxrd;
 
-  char    filename[MAX_LINE_SIZE];
   bool_t  hunt, initialize;
   int     Np, Nread, Nwrite, ij, Nsubordinate;
   double  q_emit, q0, qN, *q_abs = NULL, *qp = NULL, *wq = NULL,
@@ -76,23 +216,11 @@ void PRDScatter(AtomicLine *PRDline, enum Interpolation representation)
 
   getCPU(3, TIME_START, NULL);
 
-  /* --- Open temporary file for storage of redistribution weights when
-         called for the first time  --                 -------------- */
+  /* --- Redistribution weights are computed and stored when called
+         for the first time, and read back afterwards -- ------------ */
 
-  initialize = FALSE;
-  if (PRDline->fp_GII == NULL) {
-    sprintf(filename,
-	    (atom->ID[1] == ' ') ? PRD_FILE_TEMPLATE1 : PRD_FILE_TEMPLATE,
-	    atom->ID, PRDline->j, PRDline->i, mpi.rank);
- 
-    /* --- If file exists, it will be overwritten - - */
-    initialize = TRUE;
-    if ((PRDline->fp_GII = fopen(filename, "w+")) == NULL) {
-      sprintf(messageStr, "Unable to open temporary file %s", filename);
-      Error(ERROR_LEVEL_2, routineName, messageStr);
-    }
-  }
-  if (!initialize) rewind(PRDline->fp_GII);
+  initialize = (PRDline->GII.N == 0 && PRDline->fp_GII == NULL);
+  if (!initialize) rewindGII(PRDline);
   
   /* --- Set XRD line array --                         -------------- */
 
@@ -246,7 +374,7 @@ void PRDScatter(AtomicLine *PRDline, enum Interpolation representation)
 	    gii[lap] = GII(adamp[k], waveratio, q_emit, qp[lap]) * wq[lap];
 
 	  if ((Nwrite =
-	       fwrite(gii, sizeof(double), Np, PRDline->fp_GII)) != Np) {
+	       writeGII(PRDline, gii, Np)) != Np) {
 	    sprintf(messageStr,
 		  "Unable to write proper number of redistribution weights\n"
 		  " Wrote %d instead of %d.\n Line %d -> %d, la = %d, k = %d",
@@ -255,7 +383,7 @@ void PRDScatter(AtomicLine *PRDline, enum Interpolation representation)
 	  }
 	} else {
 	  if ((Nread =
-	       fread(gii, sizeof(double), Np, PRDline->fp_GII)) != Np) {
+	       readGII(PRDline, gii, Np)) != Np) {
 	    sprintf(messageStr,
 		  "Unable to read proper number of redistribution weights\n"
 		  " Read %d instead of %d.\n Line %d -> %d, la = %d, k = %d",
@@ -528,12 +656,12 @@ void PRDAngleScatter(AtomicLine *PRDline,
   const char routineName[] = "scatterIntegral";
   register int  la, k, lap, kr, ip, mu, mup;
 
-  char    filename[MAX_LINE_SIZE];
   bool_t  hunt, initialize, to_obs, to_obs_p;
   int     Np, Nread, Nwrite, ij, lamu;
   double *v_emit, v0, vN, *v_abs = NULL, *vp = NULL, *wv = NULL,
          *rii = NULL, *adamp, *Jbar, cDop, *RIInorm, *I = NULL,
-        **Imup, *Ik, *Pj, *gamma, **v_los, *phi_emit, wmup, *sv;
+        **Imup, *Ik, *Pj, *gamma, **v_los, *phi_emit, wmup, *sv,
+        *phi_stored = NULL;
   Atom *atom;
   AtomicLine *line;
   AtomicContinuum *continuum;
@@ -552,30 +680,11 @@ void PRDAngleScatter(AtomicLine *PRDline,
 
   cDop = (NM_TO_M * PRDline->lambda0) / (4.0 * PI);
 
-  /* --- When called for the first time open temporary file for
-         storage of redistribution weights --            ------------ */
+  /* --- Redistribution weights are computed and stored when called
+         for the first time, and read back afterwards -- ------------ */
 
-  initialize = FALSE;
-  if (PRDline->fp_GII == NULL) {
-    sprintf(filename,
-	    (atom->ID[1] == ' ') ? PRD_FILE_TEMPLATE1 : PRD_FILE_TEMPLATE,
-	    atom->ID, PRDline->j, PRDline->i, mpi.rank);
-
-    /* --- First try if file exists and can be opened for reading - - */
-
-    if ((PRDline->fp_GII = fopen(filename, "r")) != NULL) {
-      sprintf(messageStr,
-	      "Using file %s with existing redistribution weights", filename);
-      Error(WARNING, routineName, messageStr);
-    } else {
-      initialize = TRUE;
-      if ((PRDline->fp_GII = fopen(filename, "w+")) == NULL) {
-	sprintf(messageStr, "Unable to open temporary file %s", filename);
-	Error(ERROR_LEVEL_2, routineName, messageStr);
-      }
-    }
-  }
-  if (!initialize) rewind(PRDline->fp_GII);
+  initialize = (PRDline->GII.N == 0 && PRDline->fp_GII == NULL);
+  if (!initialize) rewindGII(PRDline);
 
   /* --- Temporary storage space --                    -------------- */
 
@@ -591,6 +700,11 @@ void PRDAngleScatter(AtomicLine *PRDline,
   RIInorm = (double *) malloc(atmos.Nspace * sizeof(double));
   sv      = (double *) malloc(atmos.Nspace * sizeof(double));
 
+  /* --- Profiles kept in single precision are read per wavelength - */
+
+  if (input.profile_single)
+    phi_stored = (double *) malloc(7*atmos.Nspace * sizeof(double));
+
   /* --- Evaluate first the total rate Pj out of the line's upper level
          and then the coherency fraction gamma --      -------------- */
 
@@ -644,7 +758,12 @@ void PRDAngleScatter(AtomicLine *PRDline,
       for (to_obs = 0;  to_obs <= 1;  to_obs++) {
 	lamu = 2*(atmos.Nrays*la + mu) + to_obs;
 
-	if (atmos.moving ||
+	if (input.profile_single) {
+	  readProfile(PRDline, (atmos.moving || (PRDline->polarizable &&
+			 input.StokesMode > FIELD_FREE)) ? lamu : la,
+		      phi_stored);
+	  phi_emit = phi_stored;
+	} else if (atmos.moving ||
 	    (PRDline->polarizable && input.StokesMode > FIELD_FREE))
 	  phi_emit = PRDline->phi[lamu];
 	else
@@ -772,8 +891,7 @@ void PRDAngleScatter(AtomicLine *PRDline,
 		  rii[lap] = RII(v_emit[k], vp[lap], adamp[k], mu, mup) *
 		    (sv[k] / phi_emit[k]) * wv[lap] * wmup;
 		}
-		if ((Nwrite = fwrite(rii, sizeof(double), Np,
-				     PRDline->fp_GII)) != Np) {
+		if ((Nwrite = writeGII(PRDline, rii, Np)) != Np) {
 		  sprintf(messageStr,
 		"Unable to write proper number of redistribution weights\n"
 		" Wrote %d instead of %d.\n Line %d -> %d, la = %d, k = %d",
@@ -781,8 +899,7 @@ void PRDAngleScatter(AtomicLine *PRDline,
 		  Error(ERROR_LEVEL_2, routineName, messageStr);
 		}
 	      } else {
-		if ((Nread = fread(rii, sizeof(double), Np,
-				   PRDline->fp_GII)) != Np) {
+		if ((Nread = readGII(PRDline, rii, Np)) != Np) {
 		  sprintf(messageStr,
 		"Unable to read proper number of redistribution weights\n"
 	        " Read %d instead of %d.\n Line %d -> %d, la = %d, k = %d",
@@ -817,6 +934,7 @@ void PRDAngleScatter(AtomicLine *PRDline,
   free(gamma);  free(Pj);
   free(wv);     free(I);       free(rii);
   free(vp);     free(Jbar);   free(RIInorm); free(sv);
+  if (phi_stored != NULL) free(phi_stored);
 
   sprintf(messageStr, "Scatter Int %5.1f", PRDline->lambda0);
   getCPU(3, TIME_POLL, messageStr);
@@ -15,13 +15,13 @@
 #include "rhf1d.h"
 
 /* --- Global variables --                             -------------- */
-extern Atmosphere atmos;
-extern Geometry geometry;
-extern InputData input;
-extern CommandLine commandline;
-extern char messageStr[];
-extern Spectrum spectrum;
-extern rhinfo io;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Geometry geometry;
+extern RH_TLS InputData input;
+extern RH_TLS CommandLine commandline;
+extern RH_TLS char messageStr[];
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS rhinfo io;
 
 extern void distribute_nH();
 
@@ -125,7 +125,9 @@ void UpdateAtmosDep(void) {
       atom->C = NULL;
     }
 
-    /* Allocate Gamma, as iterate released the memory */
+    /* Allocate Gamma, as iterate released the memory. It is still
+       there when the previous call kept fixed populations */
+    if (atom->Gamma != NULL) freeMatrix((void **) atom->Gamma);
     atom->Gamma = matrix_double(SQ(atom->Nlevel), atmos.Nspace);
 
     
@@ -204,6 +206,7 @@ void UpdateAtmosDep(void) {
 	  line->Ng_prd = NULL;
 	}
 	
+	freeGIIstore(line);
 	if (line->fp_GII != NULL) {
 	  fclose(line->fp_GII);
 	  line->fp_GII = NULL;
@@ -283,6 +286,7 @@ void UpdateAtmosDep(void) {
     
     if (molecule->active) {
       /* Allocate Gamma, as iterate released the memory */
+      if (molecule->Gamma != NULL) freeMatrix((void **) molecule->Gamma);
       molecule->Gamma = matrix_double(SQ(molecule->Nv), atmos.Nspace);
       
       LTEmolecule(molecule);
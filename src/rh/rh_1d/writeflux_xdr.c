@@ -23,10 +23,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Geometry geometry;
-extern Spectrum spectrum;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Geometry geometry;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- writeFlux.c ------------- */
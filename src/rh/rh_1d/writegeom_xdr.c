@@ -27,8 +27,8 @@
 
 extern enum Topology topology;
 
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- writeGeometry.c --------- */
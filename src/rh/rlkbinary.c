@@ -0,0 +1,320 @@
+/* ------- file: -------------------------- rlkbinary.c ------------- */
+
+/* --- Binary Kurucz line lists.
+
+       Parsing the ASCII line lists named in KURUCZ_DATA is slow for
+       large lists, and every instance of the code does it on its first
+       call. A list can instead be converted once with rlkconvert (see
+       rlkconvert.c) into a binary file of RLK_Record structures,
+       sorted by wavelength, that is memory mapped read-only. The
+       pages of the file are then shared by all processes on a node,
+       and readKuruczLines only takes the lines within reach of the
+       wavelengths of the spectrum.
+
+       Layout of the file: an RLK_BinaryHeader, the wavelength of the
+       first line of each block of block_size lines (Nblock doubles),
+       and the Nline records. The file is written in native byte order
+       and is rejected when the version or the size of a record do not
+       match.
+       --                                              -------------- */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rh.h"
+#include "atom.h"
+#include "background.h"
+#include "constant.h"
+#include "error.h"
+#include "readAtomFile.h"
+
+
+#define COMMENT_CHAR        "#"
+#define RLK_RECORD_LENGTH   160
+
+
+/* --- Function prototypes --                          -------------- */
+
+
+/* --- Global variables --                             -------------- */
+
+extern RH_TLS char messageStr[];
+
+
+/* ------- begin -------------------------- readKuruczRecord.c ------ */
+
+int readKuruczRecord(char *inputLine, RLK_Record *rec)
+{
+  char   Gvalues[18+1], elem_code[7];
+  int    Nread, tmp;
+  double lambda_air, Ei, Ej;
+
+  /* --- Parse one line of a Kurucz line list into rec. Fields that
+         cannot be read keep their values from the previous line, so
+         the same record should be passed for all lines of a list.
+         Returns the number of items read, which should be 17 -- ---- */
+
+  Nread = sscanf(inputLine, "%lf %lf %s %lf",
+		 &lambda_air, &rec->gf, (char *) &elem_code, &Ei);
+
+  /* --- Ionization stage and periodic table index --  -------------- */
+
+  sscanf(elem_code, "%d.%d", &rec->pt_index, &rec->stage);
+
+  Nread += sscanf(inputLine+53, "%lf", &Ej);
+
+  Ei = fabs(Ei) * (HPLANCK * CLIGHT) / CM_TO_M;
+  Ej = fabs(Ej) * (HPLANCK * CLIGHT) / CM_TO_M;
+
+  Nread += sscanf(inputLine+35, "%lf", &rec->Ji);
+  Nread += sscanf(inputLine+63, "%lf", &rec->Jj);
+
+  strncpy(Gvalues, inputLine+79, 18);
+  Gvalues[18] = '\0';
+  Nread += sscanf(Gvalues, "%lf %lf %lf",
+		  &rec->Grad, &rec->GStark, &rec->GvdWaals);
+
+  /* --- Isotope and hyperfine fractions and splittings, kept as
+         given in the list --                          -------------- */
+
+  Nread += sscanf(inputLine+106, "%d", &rec->isotope);
+  Nread += sscanf(inputLine+108, "%lf", &rec->isotope_frac);
+  Nread += sscanf(inputLine+117, "%lf", &rec->hyperfine_frac);
+  Nread += sscanf(inputLine+123, "%5d%5d", &rec->hfs_i, &rec->hfs_j);
+  Nread += sscanf(inputLine+143, "%5d%5d", &rec->gL_i, &rec->gL_j);
+
+  /* --- Beware: the Kurucz linelist has upper and lower levels
+         of a transition in random order. Store the level with the
+         lowest energy first --                        -------------- */
+
+  if (Ej < Ei) {
+    rec->Ei = Ej;
+    rec->Ej = Ei;
+    memcpy(rec->labeli, inputLine+69, RLK_LABEL_LENGTH);
+    memcpy(rec->labelj, inputLine+41, RLK_LABEL_LENGTH);
+    SWAPDOUBLE(rec->Ji, rec->Jj);
+    tmp = rec->hfs_i;  rec->hfs_i = rec->hfs_j;  rec->hfs_j = tmp;
+    tmp = rec->gL_i;   rec->gL_i  = rec->gL_j;   rec->gL_j  = tmp;
+  } else {
+    rec->Ei = Ei;
+    rec->Ej = Ej;
+    memcpy(rec->labeli, inputLine+41, RLK_LABEL_LENGTH);
+    memcpy(rec->labelj, inputLine+69, RLK_LABEL_LENGTH);
+  }
+  rec->lambda0 = (HPLANCK * CLIGHT) / (rec->Ej - rec->Ei) / NM_TO_M;
+
+  return Nread;
+}
+/* ------- end ---------------------------- readKuruczRecord.c ------ */
+
+/* ------- begin -------------------------- rlkrec_ascend.c --------- */
+
+static int rlkrec_ascend(const void *v1, const void *v2)
+{
+  RLK_Record *rec1 = (RLK_Record *) v1, *rec2 = (RLK_Record *) v2;
+
+  /* --- By wavelength, and in the order of the list for lines of
+         equal wavelength, independent of the sorting algorithm -- -- */
+
+  if (rec1->lambda0 < rec2->lambda0)
+    return -1;
+  else if (rec1->lambda0 > rec2->lambda0)
+    return 1;
+  else
+    return rec1->line_index - rec2->line_index;
+}
+/* ------- end ---------------------------- rlkrec_ascend.c --------- */
+
+/* ------- begin -------------------------- writeKuruczBinary.c ----- */
+
+long writeKuruczBinary(char *listName, char *binaryName)
+{
+  const char routineName[] = "writeKuruczBinary";
+  register long n;
+
+  char   inputLine[RLK_RECORD_LENGTH+1], *tmpName,
+        *commentChar = COMMENT_CHAR;
+  int    Nread, checkPoint, Nrequired;
+  long   Nline;
+  double *block_lambda;
+  RLK_Record *records, rec;
+  RLK_BinaryHeader header;
+  FILE  *fp_linelist, *fp_binary;
+
+  /* --- Convert the ASCII Kurucz line list listName into binary file
+         binaryName. The file is written under a temporary name and
+         renamed when complete, so that readers never see a partial
+         file. Returns the number of lines -- -------- -------------- */
+
+  if ((fp_linelist = fopen(listName, "r")) == NULL) {
+    sprintf(messageStr, "Unable to open input file %s", listName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  Nline = 0;
+  while (fgets(inputLine, RLK_RECORD_LENGTH+1, fp_linelist) != NULL)
+    if (*inputLine != *commentChar) Nline++;
+  rewind(fp_linelist);
+
+  records = (RLK_Record *) malloc(MAX(Nline, 1) * sizeof(RLK_Record));
+  memset(&rec, 0, sizeof(RLK_Record));
+
+  n = 0;
+  while (fgets(inputLine, RLK_RECORD_LENGTH+1, fp_linelist) != NULL) {
+    if (*inputLine != *commentChar) {
+      Nread = readKuruczRecord(inputLine, &rec);
+      checkNread(Nread, Nrequired=17, routineName, checkPoint=1);
+      rec.line_index = n;
+      records[n++] = rec;
+    }
+  }
+  fclose(fp_linelist);
+
+  qsort(records, Nline, sizeof(RLK_Record), rlkrec_ascend);
+
+  memset(&header, 0, sizeof(RLK_BinaryHeader));
+  memcpy(header.magic, RLK_BINARY_MAGIC, sizeof(header.magic));
+  header.version     = RLK_BINARY_VERSION;
+  header.record_size = sizeof(RLK_Record);
+  header.block_size  = RLK_BLOCK_SIZE;
+  header.Nblock      = (Nline + RLK_BLOCK_SIZE - 1) / RLK_BLOCK_SIZE;
+  header.Nline       = Nline;
+
+  block_lambda = (double *) malloc(MAX(header.Nblock, 1) * sizeof(double));
+  for (n = 0;  n < header.Nblock;  n++)
+    block_lambda[n] = records[n * RLK_BLOCK_SIZE].lambda0;
+
+  tmpName = (char *) malloc(strlen(binaryName) + 16);
+  sprintf(tmpName, "%s.%d", binaryName, (int) getpid());
+  if ((fp_binary = fopen(tmpName, "wb")) == NULL) {
+    sprintf(messageStr, "Unable to open output file %s", tmpName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  if (fwrite(&header, sizeof(RLK_BinaryHeader), 1, fp_binary) != 1 ||
+      fwrite(block_lambda, sizeof(double), header.Nblock, fp_binary) !=
+      (size_t) header.Nblock ||
+      fwrite(records, sizeof(RLK_Record), Nline, fp_binary) !=
+      (size_t) Nline) {
+    sprintf(messageStr, "Unable to write to output file %s", tmpName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  fclose(fp_binary);
+
+  if (rename(tmpName, binaryName)) {
+    sprintf(messageStr, "Unable to rename %s to %s", tmpName, binaryName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  free(tmpName);
+  free(block_lambda);
+  free(records);
+
+  return Nline;
+}
+/* ------- end ---------------------------- writeKuruczBinary.c ----- */
+
+/* ------- begin -------------------------- openKuruczBinary.c ------ */
+
+bool_t openKuruczBinary(char *fileName, RLK_Binary *rb)
+{
+  const char routineName[] = "openKuruczBinary";
+
+  char  *data;
+  int    fd;
+  struct stat st;
+  RLK_BinaryHeader *header;
+
+  /* --- Map a binary line list read-only, or take it from the model
+         archive (see modelarchive.c). Returns FALSE, without
+         complaint, when fileName is not a binary line list -- ------ */
+
+  rb->map = NULL;
+  if ((data = getModelFile(fileName, &rb->size)) == NULL) {
+    if ((fd = open(fileName, O_RDONLY)) < 0) return FALSE;
+
+    if (fstat(fd, &st)) {
+      close(fd);
+      return FALSE;
+    }
+    rb->size = st.st_size;
+    rb->map  = (rb->size > 0) ?
+      mmap(NULL, rb->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (rb->map == MAP_FAILED) {
+      rb->map = NULL;
+      return FALSE;
+    }
+    data = (char *) rb->map;
+  }
+  if (rb->size < sizeof(RLK_BinaryHeader)) {
+    closeKuruczBinary(rb);
+    return FALSE;
+  }
+  header = (RLK_BinaryHeader *) data;
+  if (memcmp(header->magic, RLK_BINARY_MAGIC, sizeof(header->magic))) {
+    closeKuruczBinary(rb);
+    return FALSE;
+  }
+  if (header->version != RLK_BINARY_VERSION ||
+      header->record_size != sizeof(RLK_Record) ||
+      header->block_size != RLK_BLOCK_SIZE ||
+      rb->size != sizeof(RLK_BinaryHeader) +
+      header->Nblock * sizeof(double) + header->Nline * sizeof(RLK_Record)) {
+    sprintf(messageStr,
+	    "Binary line list %s does not match this version of the code,\n"
+	    " convert the ASCII line list again with rlkconvert", fileName);
+    Error(ERROR_LEVEL_2, routineName, messageStr);
+  }
+  rb->Nblock = header->Nblock;
+  rb->Nline  = header->Nline;
+  rb->block_lambda = (double *) (data + sizeof(RLK_BinaryHeader));
+  rb->record = (RLK_Record *) (rb->block_lambda + rb->Nblock);
+
+  return TRUE;
+}
+/* ------- end ---------------------------- openKuruczBinary.c ------ */
+
+/* ------- begin -------------------------- closeKuruczBinary.c ----- */
+
+void closeKuruczBinary(RLK_Binary *rb)
+{
+  if (rb->map != NULL) munmap(rb->map, rb->size);
+  rb->map = NULL;
+}
+/* ------- end ---------------------------- closeKuruczBinary.c ----- */
+
+/* ------- begin -------------------------- locateKuruczBinary.c ---- */
+
+long locateKuruczBinary(RLK_Binary *rb, double lambda)
+{
+  long low, high, index;
+
+  /* --- Index of the first line with wavelength >= lambda (Nline when
+         there is none). The block index is searched first, so that
+         only the pages of one block of records are touched -- ------ */
+
+  low = 0;  high = rb->Nblock;
+  while (high - low > 1) {
+    index = (high + low) >> 1;
+    if (rb->block_lambda[index] < lambda)
+      low = index;
+    else
+      high = index;
+  }
+  low *= RLK_BLOCK_SIZE;
+  high = MIN(low + RLK_BLOCK_SIZE, rb->Nline);
+
+  while (low < high) {
+    index = (high + low) >> 1;
+    if (rb->record[index].lambda0 < lambda)
+      low = index + 1;
+    else
+      high = index;
+  }
+  return low;
+}
+/* ------- end ---------------------------- locateKuruczBinary.c ---- */
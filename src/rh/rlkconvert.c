@@ -0,0 +1,57 @@
+/* ------- file: -------------------------- rlkconvert.c ------------ */
+
+/* --- Convert an ASCII Kurucz line list into a binary line list that
+       is memory mapped by readKuruczLines (see rlkbinary.c).
+
+       Build with "make rlkconvert" in this directory, run as
+
+         rlkconvert <ASCII line list> <binary line list>
+
+       and list the binary file instead of the ASCII one in the file
+       given by KURUCZ_DATA. The binary file is specific to the
+       byte order and the build of the code that wrote it.
+       --                                              -------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rh.h"
+#include "atom.h"
+#include "background.h"
+#include "error.h"
+#include "inputs.h"
+
+
+/* --- Function prototypes --                          -------------- */
+
+
+/* --- Global variables --                             -------------- */
+
+RH_TLS CommandLine commandline;
+RH_TLS InputData input;
+RH_TLS char messageStr[MAX_MESSAGE_LENGTH];
+
+
+/* ------- begin -------------------------- rlkconvert.c ------------ */
+
+int main(int argc, char *argv[])
+{
+  long Nline;
+
+  commandline.quiet   = FALSE;
+  commandline.logfile = stderr;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <ASCII line list> <binary line list>\n",
+	    argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  Nline = writeKuruczBinary(argv[1], argv[2]);
+
+  sprintf(messageStr, "Wrote %ld Kurucz lines from %s to %s\n",
+	  Nline, argv[1], argv[2]);
+  Error(MESSAGE, "rlkconvert", messageStr);
+
+  return EXIT_SUCCESS;
+}
+/* ------- end ---------------------------- rlkconvert.c ------------ */
@@ -40,10 +40,10 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern Spectrum spectrum;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS Spectrum spectrum;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- PRDScatter.c ------------ */
@@ -312,7 +312,8 @@ void PRDAngleScatter(AtomicLine *PRDline,
   int     Np, Nread, Nwrite, ij, lamu;
   double *v_emit, v0, vN, *v_abs = NULL, *vp = NULL, *wv = NULL,
          *rii = NULL, *adamp, *Jbar, cDop, *RIInorm, *I = NULL,
-        **Imup, *Ik, *Pj, *gamma, **v_los, *phi_emit, wmup, *sv;
+        **Imup, *Ik, *Pj, *gamma, **v_los, *phi_emit, wmup, *sv,
+        *phi_stored = NULL;
   Atom *atom;
   AtomicLine *line;
   AtomicContinuum *continuum;
@@ -370,6 +371,11 @@ void PRDAngleScatter(AtomicLine *PRDline,
   RIInorm = (double *) malloc(atmos.Nspace * sizeof(double));
   sv      = (double *) malloc(atmos.Nspace * sizeof(double));
 
+  /* --- Profiles kept in single precision are read per wavelength - */
+
+  if (input.profile_single)
+    phi_stored = (double *) malloc(7*atmos.Nspace * sizeof(double));
+
   /* --- Evaluate first the total rate Pj out of the line's upper level
          and then the coherency fraction gamma --      -------------- */
 
@@ -423,7 +429,12 @@ void PRDAngleScatter(AtomicLine *PRDline,
       for (to_obs = 0;  to_obs <= 1;  to_obs++) {
 	lamu = 2*(atmos.Nrays*la + mu) + to_obs;
 
-	if (atmos.moving ||
+	if (input.profile_single) {
+	  readProfile(PRDline, (atmos.moving || (PRDline->polarizable &&
+			 input.StokesMode > FIELD_FREE)) ? lamu : la,
+		      phi_stored);
+	  phi_emit = phi_stored;
+	} else if (atmos.moving ||
 	    (PRDline->polarizable && input.StokesMode > FIELD_FREE))
 	  phi_emit = PRDline->phi[lamu];
 	else
@@ -596,6 +607,7 @@ void PRDAngleScatter(AtomicLine *PRDline,
   free(gamma);  free(Pj);
   free(wv);     free(I);       free(rii);
   free(vp);     free(Jbar);   free(RIInorm); free(sv);
+  if (phi_stored != NULL) free(phi_stored);
 
   sprintf(messageStr, "Scatter Int %5.1f", PRDline->lambda0);
   getCPU(3, TIME_POLL, messageStr);
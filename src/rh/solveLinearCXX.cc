@@ -1,5 +1,7 @@
 #include <cmath>
 #include <cstdio>
+#include <vector>
+#include <algorithm>
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/SVD>
 #include <cstdio>
@@ -67,3 +69,186 @@ void solveLinearCXX(int n, double **a, double *b, bool_t improve)
 
 }
 */
+
+/* --- Batched solution of the small dense systems of statistical
+       equilibrium, one per depth point. A[N*N][Nspace] and b[N][Nspace]
+       have depth as fastest running index (the layout of Gamma), so
+       depth points are taken in blocks of BATCH_LANES with the lane as
+       innermost loop. Each lane is factorized with partial pivoting and
+       implicit row scaling and gets one step of iterative improvement,
+       as in SolveLinearEq. Lanes with a relative pivot below BATCH_TINY
+       are solved again with the SVD of solveLinearCXX. --- */
+
+namespace{
+  
+  static const int    BATCH_LANES = 8;
+  static const double BATCH_TINY  = 1.e-13;
+
+  
+  template<int NT>
+  int solveBlock(int Nrun, int k0, int nl, double **A, double **b,
+		 double *work, int *piv)
+  {
+    static const int L = BATCH_LANES;
+    const int N = (NT > 0) ? NT : Nrun;
+    
+    double *a  = work;          // LU factors
+    double *a0 = a  + N*N*L;    // original matrix
+    double *x  = a0 + N*N*L;    // solution
+    double *b0 = x  + N*L;      // original rhs
+    double *r  = b0 + N*L;      // residual
+    double *sc = r  + N*L;      // implicit row scaling
+    double big[L], rinv[L];
+    int    ip[L];
+    bool   singular[L];
+    int    nsvd = 0;
+
+    
+    /* --- Load the block, padding unused lanes with identity --- */
+    
+    for(int ij=0; ij<N*N; ++ij){
+      const bool diag = (ij / N) == (ij % N);
+      for(int l=0; l<L; ++l)
+	a0[ij*L+l] = (l < nl) ? A[ij][k0+l] : ((diag) ? 1.0 : 0.0);
+    }
+    for(int i=0; i<N; ++i)
+      for(int l=0; l<L; ++l) b0[i*L+l] = (l < nl) ? b[i][k0+l] : 0.0;
+
+    for(int i=0; i<N; ++i){
+      for(int l=0; l<L; ++l) big[l] = 0.0;
+      for(int j=0; j<N; ++j)
+	for(int l=0; l<L; ++l) big[l] = std::max(big[l], fabs(a0[(i*N+j)*L+l]));
+      
+      for(int l=0; l<L; ++l){
+	if(big[l] == 0.0) return -1; // A row of zeros, nothing to fall back on
+	sc[i*L+l] = 1.0 / big[l];
+      }
+    }
+    for(int n=0; n<N*N*L; ++n) a[n] = a0[n];
+    for(int l=0; l<L; ++l) singular[l] = false;
+
+    
+    /* --- Pivoted LU, right-looking --- */
+    
+    for(int j=0; j<N; ++j){
+      for(int l=0; l<L; ++l){
+	ip[l] = j;
+	big[l] = sc[j*L+l] * fabs(a[(j*N+j)*L+l]);
+      }
+      for(int i=j+1; i<N; ++i)
+	for(int l=0; l<L; ++l){
+	  const double v = sc[i*L+l] * fabs(a[(i*N+j)*L+l]);
+	  if(v > big[l]){
+	    big[l] = v;
+	    ip[l] = i;
+	  }
+	}
+
+      for(int l=0; l<L; ++l){
+	piv[j*L+l] = ip[l];
+	if(ip[l] != j){
+	  for(int c=0; c<N; ++c) std::swap(a[(j*N+c)*L+l], a[(ip[l]*N+c)*L+l]);
+	  std::swap(sc[j*L+l], sc[ip[l]*L+l]);
+	}
+	if(big[l] < BATCH_TINY){
+	  singular[l] = true;
+	  a[(j*N+j)*L+l] = 1.0;
+	}
+	rinv[l] = 1.0 / a[(j*N+j)*L+l];
+      }
+
+      for(int i=j+1; i<N; ++i){
+	for(int l=0; l<L; ++l) a[(i*N+j)*L+l] *= rinv[l];
+	for(int c=j+1; c<N; ++c)
+	  for(int l=0; l<L; ++l)
+	    a[(i*N+c)*L+l] -= a[(i*N+j)*L+l] * a[(j*N+c)*L+l];
+      }
+    }
+
+    
+    /* --- Forward and back substitution of y in place --- */
+    
+    auto subst = [&](double *y)
+      {
+	for(int j=0; j<N; ++j)
+	  for(int l=0; l<L; ++l)
+	    if(piv[j*L+l] != j) std::swap(y[j*L+l], y[piv[j*L+l]*L+l]);
+	
+	for(int i=1; i<N; ++i)
+	  for(int j=0; j<i; ++j)
+	    for(int l=0; l<L; ++l) y[i*L+l] -= a[(i*N+j)*L+l] * y[j*L+l];
+	
+	for(int i=N-1; i>=0; --i){
+	  for(int j=i+1; j<N; ++j)
+	    for(int l=0; l<L; ++l) y[i*L+l] -= a[(i*N+j)*L+l] * y[j*L+l];
+	  for(int l=0; l<L; ++l) y[i*L+l] /= a[(i*N+i)*L+l];
+	}
+      };
+
+    for(int n=0; n<N*L; ++n) x[n] = b0[n];
+    subst(x);
+
+    
+    /* --- Improve solution! --- */
+    
+    for(int i=0; i<N; ++i){
+      for(int l=0; l<L; ++l) r[i*L+l] = b0[i*L+l];
+      for(int j=0; j<N; ++j)
+	for(int l=0; l<L; ++l) r[i*L+l] -= a0[(i*N+j)*L+l] * x[j*L+l];
+    }
+    subst(r);
+    for(int n=0; n<N*L; ++n) x[n] += r[n];
+
+    
+    /* --- Store, near-singular lanes go through the SVD --- */
+    
+    for(int l=0; l<nl; ++l){
+      if(singular[l]){
+	std::vector<double> M(N*N), c(N);
+	std::vector<double*> rows(N);
+	
+	for(int i=0; i<N; ++i){
+	  rows[i] = &M[i*N];
+	  c[i] = b0[i*L+l];
+	  for(int j=0; j<N; ++j) M[i*N+j] = a0[(i*N+j)*L+l];
+	}
+	solveLinearCXX(N, &rows[0], &c[0], TRUE);
+	for(int i=0; i<N; ++i) b[i][k0+l] = c[i];
+	nsvd++;
+      }else
+	for(int i=0; i<N; ++i) b[i][k0+l] = x[i*L+l];
+    }
+    
+    return nsvd;
+  }
+  
+} // namespace
+
+int solveLinearBatch(int N, int Nspace, double **A, double **b)
+{
+  static const int L = BATCH_LANES;
+  
+  std::vector<double> work(2*N*N*L + 4*N*L);
+  std::vector<int> piv(N*L);
+  int nsvd = 0, n = 0;
+
+  
+  /* --- Unrolled versions for the most common number of levels --- */
+  
+  for(int k0=0; k0<Nspace; k0+=L){
+    const int nl = std::min(L, Nspace-k0);
+    
+    switch(N){
+    case 2:  n = solveBlock<2>(N, k0, nl, A, b, &work[0], &piv[0]); break;
+    case 3:  n = solveBlock<3>(N, k0, nl, A, b, &work[0], &piv[0]); break;
+    case 4:  n = solveBlock<4>(N, k0, nl, A, b, &work[0], &piv[0]); break;
+    case 5:  n = solveBlock<5>(N, k0, nl, A, b, &work[0], &piv[0]); break;
+    case 6:  n = solveBlock<6>(N, k0, nl, A, b, &work[0], &piv[0]); break;
+    default: n = solveBlock<0>(N, k0, nl, A, b, &work[0], &piv[0]); break;
+    }
+    if(n < 0) return n;
+    nsvd += n;
+  }
+  
+  return nsvd;
+}
@@ -9,6 +9,7 @@ extern "C" {
 #include <stdbool.h>
   
   void solveLinearCXX(int N, double **A, double *b, bool_t improve);
+  int  solveLinearBatch(int N, int Nspace, double **A, double **b);
  
     
 #ifdef __cplusplus
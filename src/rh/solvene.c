@@ -46,8 +46,8 @@ double getKuruczpf(Element *element, int stage, int k);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- Solve_ne.c -------------- */
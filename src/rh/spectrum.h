@@ -57,12 +57,14 @@ typedef struct {
   linf *linfo;
   AtomicLine **PRDlines;
   int nPRDlines; 
+  long GIIbytes;
 } Spectrum;
 
 
 /* --- Associated function prototypes --               -------------- */
 
 double Formal(int nspect, bool_t eval_operator, bool_t redistribute, int iter);
+double FormalBatch(int Nlam, int *nspect, int iter);
 double solveSpectrum(bool_t eval_operator, bool_t redistribute, int iter, bool_t synth_all);
 
 void   addtoGamma(int nspect, double wmu, double *P, double *Psi);
@@ -19,18 +19,18 @@
 
 /* --- Global variables --                             -------------- */
 
-static bool_t  ascend;
-static int     Ntable;
-static double *xtable, xmin, xmax;
+static RH_TLS bool_t  ascend;
+static RH_TLS int     Ntable;
+static RH_TLS double *xtable, xmin, xmax;
 
 /* ------- begin -------------------------- splineCoef.c ------------ */
 
-static double *M = NULL, *ytable;
+static RH_TLS double *M = NULL, *ytable;
 
 void splineCoef(int N, double *x, double *y)
 {
   register int j;
-  static double *u = NULL;
+  static RH_TLS double *u = NULL;
 
   double  p, *q, hj, hj1, D, D1, mu;
 
@@ -28,6 +28,7 @@
 #include "inputs.h"
 #include "statequil_H.h"
 #include "background.h"
+#include "solveLinearCXX.h"
 
 
 /* --- Function prototypes --                          -------------- */
@@ -35,11 +36,11 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char messageStr[];
-extern MPI_t mpi;
-extern InputData input;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
+extern RH_TLS MPI_t mpi;
+extern RH_TLS InputData input;
 
 
 /* ------- begin -------------------------- statEquil.c ------------- */
@@ -49,32 +50,30 @@ void statEquil(Atom *atom, int isum)
   register int i, j, ij, k;
 
   int    i_eliminate, Nlevel;
-  double GamDiag, nmax_k, *n_k, **Gamma_k;
+  double GamDiag, nmax_k, **n_k, **Gamma_k;
 
   getCPU(3, TIME_START, NULL);
 
   Nlevel = atom->Nlevel;
 
-  /* --- Need temporary storage because Gamma has to be solved spatial
-         point by spatial point while depth is normally the fastest
-         running index --                              -------------- */
+  /* --- Temporary storage keeps depth as the fastest running index
+         so that all spatial points are solved in one batch -- ----- */
 
-  n_k     = (double *) malloc(Nlevel * sizeof(double));
-  Gamma_k = matrix_double(Nlevel, Nlevel);
+  n_k     = matrix_double(Nlevel, atmos.Nspace);
+  Gamma_k = matrix_double(Nlevel*Nlevel, atmos.Nspace);
 
-  for (k = 0;  k < atmos.Nspace;  k++) {
-    for (i = 0, ij = 0;  i < Nlevel;  i++) {
-      n_k[i] = atom->n[i][k];
-      for (j = 0;  j < Nlevel;  j++, ij++)
-	Gamma_k[i][j] = atom->Gamma[ij][k] + atom->C[ij][k]; // Now the collisional rates are not added in initGamma
-    }
+  for (ij = 0;  ij < Nlevel*Nlevel;  ij++) {
+    for (k = 0;  k < atmos.Nspace;  k++)
+      Gamma_k[ij][k] = atom->Gamma[ij][k] + atom->C[ij][k]; // Now the collisional rates are not added in initGamma
+  }
 
+  for (k = 0;  k < atmos.Nspace;  k++) {
     if (isum == -1) {
       i_eliminate  = 0;
       nmax_k = 0.0;
       for (i = 0;  i < Nlevel;  i++) {
-	if (n_k[i] > nmax_k) {
-	  nmax_k = n_k[i];
+	if (atom->n[i][k] > nmax_k) {
+	  nmax_k = atom->n[i][k];
 	  i_eliminate = i;
 	}
       }
@@ -85,35 +84,36 @@ void statEquil(Atom *atom, int isum)
 
     for (i = 0;  i < Nlevel;  i++) {
       GamDiag = 0.0;
-      Gamma_k[i][i] = 0.0;
-      n_k[i] = 0.0;
+      Gamma_k[i*Nlevel + i][k] = 0.0;
+      n_k[i][k] = 0.0;
 
-      for (j = 0;  j < Nlevel;  j++) GamDiag += Gamma_k[j][i];
-      Gamma_k[i][i] = -GamDiag;
+      for (j = 0;  j < Nlevel;  j++) GamDiag += Gamma_k[j*Nlevel + i][k];
+      Gamma_k[i*Nlevel + i][k] = -GamDiag;
     }
     /* --- Close homogeneous set with particle conservation-- ------- */
 
-    n_k[i_eliminate] = atom->ntotal[k];
-    for (j = 0;  j < Nlevel;  j++) Gamma_k[i_eliminate][j] = 1.0;
-
-    /* --- Solve for new population numbers at location k -- -------- */
+    n_k[i_eliminate][k] = atom->ntotal[k];
+    for (j = 0;  j < Nlevel;  j++) Gamma_k[i_eliminate*Nlevel + j][k] = 1.0;
+  }
 
-    SolveLinearEq(Nlevel, Gamma_k, n_k, TRUE);
-    //solveLinearCXX(Nlevel, Gamma_k, n_k);
+  /* --- Solve for new population numbers at all locations. Pivoted
+         LU per depth point, with SVD for near-singular points -- --- */
 
+  if (solveLinearBatch(Nlevel, atmos.Nspace, Gamma_k, n_k) < 0) {
+    sprintf(messageStr, "Singular matrix");
+    Error(ERROR_LEVEL_2, "statEquil", messageStr);
+    mpi.stop = TRUE;
     
-    if (mpi.stop) {
-      free(n_k);
-      freeMatrix((void **) Gamma_k);
-      return; /* Get out if there is a singular matrix */
-      //solveLinearCXX(Nlevel, Gamma_k, n_k);
-      //mpi.stop = 0;
-    }
-    
-    for (i = 0;  i < Nlevel;  i++) atom->n[i][k] = n_k[i];
+    freeMatrix((void **) n_k);
+    freeMatrix((void **) Gamma_k);
+    return; /* Get out if there is a singular matrix */
   }
 
-  free(n_k);
+  for (i = 0;  i < Nlevel;  i++) {
+    for (k = 0;  k < atmos.Nspace;  k++) atom->n[i][k] = n_k[i][k];
+  }
+
+  freeMatrix((void **) n_k);
   freeMatrix((void **) Gamma_k);
 
   getCPU(3, TIME_POLL, "Stat Equil");
@@ -205,7 +205,7 @@ double updatePopulations(int niter)
 {
   register int nact, ii;
 
-  bool_t accel, quiet, hydrogen = FALSE;
+  bool_t accel, quiet, hydrogen = FALSE, coupled;
   double dpops, dpopsmax = 0.0, dnemax = 0.0;
   Atom *atom;
   Molecule *molecule;
@@ -220,12 +220,20 @@ double updatePopulations(int niter)
   for (nact = atmos.Nactiveatom-1;  nact >= 0;  --nact) {
     atom = atmos.activeatoms[nact];
     dnemax = 0.0;
+
+    /* --- Populations and electron density accelerated together? -- */
+    
+    coupled = (atom->Ng_n->N1 < atom->Ng_n->N);
     
     if(hydrogen && nact == 0){
       atmos.ne_flag = TRUE;
       statEquil_H(atom, input.isum, niter);
       //
-      accel = Accelerate(atmos.ng_ne, atmos.ne);
+      if(coupled){
+	accel = AccelerateCoupled(atom->Ng_n, atom->n[0], atmos.ne);
+	Accelerate(atmos.ng_ne, atmos.ne);
+      } else
+	accel = Accelerate(atmos.ng_ne, atmos.ne);
       //
       sprintf(messageStr, " Ne,");
       dnemax = MaxChange(atmos.ng_ne, messageStr, quiet=FALSE);
@@ -244,8 +252,12 @@ double updatePopulations(int niter)
       if(nact==0) atmos.ne_flag = FALSE;
       statEquil(atom, input.isum);
       if(mpi.stop) return 1.;
+
+      /* --- The electron density is not updated here -- --------- */
+      
+      if(coupled) accel = AccelerateCoupled(atom->Ng_n, atom->n[0], NULL);
     }
-    accel = Accelerate(atom->Ng_n, atom->n[0]);
+    if(!coupled) accel = Accelerate(atom->Ng_n, atom->n[0]);
     if(mpi.stop) return 1.;
     
     sprintf(messageStr, " %s,", atom->ID);
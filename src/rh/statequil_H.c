@@ -43,11 +43,11 @@ double getKuruczpf2(Element *element, int stage, int k);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char messageStr[];
-extern MPI_t mpi;
-extern InputData input;
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
+extern RH_TLS MPI_t mpi;
+extern RH_TLS InputData input;
 
 
 inline double getKuruczpf2(Element *element, int stage, int k)
@@ -27,7 +27,7 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
+extern RH_TLS Atmosphere atmos;
 
 
 /* ------- begin -------------------------- Thomson.c --------------- */
@@ -48,6 +48,10 @@
 
 #define  TINY 1.0E-08
 
+/* --- Number of points that the array versions process at a time -- */
+
+#define  VOIGT_BLOCK  64
+
 
 /* --- Function prototypes --                          -------------- */
 
@@ -70,12 +74,14 @@ complex Humlicek3(complex z);
 complex Humlicek4(complex z);
 #endif
 
-double VoigtLookup(double a, double v);
+double VoigtLookup(double a, double v, double *F);
+static void VoigtHumlicekArray(int N, const double *a, const double *v,
+			       double *H, double *F);
 
 
 /* --- Global variables --                             -------------- */
 
-extern char messageStr[];
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- Voigt.c ----------------- */
@@ -98,7 +104,7 @@ double Voigt(double a, double v, double *F, enum VoigtAlgorithm algorithm)
     voigt = VoigtHumlicek(a, v, F);
     break;
   case LOOKUP:
-    voigt = VoigtLookup(a, v);
+    voigt = VoigtLookup(a, v, F);
     break;
   default:
     sprintf(messageStr, "Unregognized Voigt algorithm: %d", algorithm);
@@ -108,6 +114,34 @@ double Voigt(double a, double v, double *F, enum VoigtAlgorithm algorithm)
 }
 /* ------- end ---------------------------- Voigt.c ----------------- */
 
+/* ------- begin -------------------------- VoigtArray.c ------------ */
+
+/* --- Array version of Voigt: H[n] = H(a[n], v[n]) and, when F is
+       not NULL and the algorithm supplies it, F[n] = F(a[n], v[n]).
+       The HUMLICEK and LOOKUP algorithms have kernels that handle
+       VOIGT_BLOCK points at a time without per-point branching, so
+       that the compiler can vectorize them. The other algorithms are
+       evaluated point by point. --                    -------------- */
+
+void VoigtArray(int N, double *a, double *v, double *H, double *F,
+		enum VoigtAlgorithm algorithm)
+{
+  register int n;
+
+  switch (algorithm) {
+  case HUMLICEK:
+    VoigtHumlicekArray(N, a, v, H, F);
+    break;
+  case LOOKUP:
+    VoigtLookupArray(N, a, v, H, F);
+    break;
+  default:
+    for (n = 0;  n < N;  n++)
+      H[n] = Voigt(a[n], v[n], (F != NULL) ? F + n : NULL, algorithm);
+  }
+}
+/* ------- end ---------------------------- VoigtArray.c ------------ */
+
 /* ------- begin -------------------------- VoigtArmstrong.c -------- */
 
 #define  NT  10
@@ -258,8 +292,8 @@ double VoigtK3(double a, double v)
 double VoigtRybicki(double a, double v)
 {
   register int m, n;
-  static   int initialize = TRUE;
-  static   double c[NGR];
+  static RH_TLS int initialize = TRUE;
+  static RH_TLS double c[NGR];
 
   double a1, a2, b1, b2, e, s, t, zi, zr, voigt;
 
@@ -419,103 +453,497 @@ double VoigtHumlicek(double a, double v, double *F)
 }
 /* ------- end ---------------------------- VoigtHumlicek.c --------- */
 
-/* ------- begin -------------------------- VoigtLookup.c ----------- */
+/* ------- begin -------------------------- VoigtHumlicekArray.c ---- */
+
+/* --- Array version of VoigtHumlicek. The points of each block are
+       first sorted into the four regions of Humlicek's approximation,
+       after which each region is evaluated in a branch-free loop with
+       explicit real arithmetic. Same approximation as VoigtHumlicek
+       (see humlicek.c). --                            -------------- */
+
+static void VoigtHumlicekArray(int N, const double *a, const double *v,
+			       double *H, double *F)
+{
+  register int n, m, j, region;
+
+  static const double a3[5] = {0.5642236, 3.778987, 11.96482,
+			       20.20933, 16.4955};
+  static const double b3[5] = {6.699398, 21.69274,  39.27121,
+			       38.82363, 16.4955};
+  static const double a4[7] = {0.56419, 1.320522, 35.7668, 219.031,
+			       1540.787, 3321.99, 36183.31};
+  static const double b4[7] = {1.841439, 61.57037, 364.2191, 2186.181,
+			       9022.228, 24322.84, 32066.6};
+
+  int    Nr[4], index[4][VOIGT_BLOCK], *idx;
+  double zr[VOIGT_BLOCK], zi[VOIGT_BLOCK], Wr[VOIGT_BLOCK],
+         Wi[VOIGT_BLOCK], s, ur, ui, pr, pi, qr, qi, tmp, denom, e;
+
+  for (n = 0;  n < N;  n += VOIGT_BLOCK) {
+    const int Nb = MIN(VOIGT_BLOCK, N - n);
+
+    Nr[0] = Nr[1] = Nr[2] = Nr[3] = 0;
+    for (m = 0;  m < Nb;  m++) {
+      s = fabs(v[n+m]) + a[n+m];
+      if (s >= 15.0)
+	region = 0;
+      else if (s >= 5.5)
+	region = 1;
+      else if (a[n+m] >= 0.195*fabs(v[n+m]) - 0.176)
+	region = 2;
+      else
+	region = 3;
+      index[region][Nr[region]++] = n + m;
+    }
+
+    for (region = 0;  region < 4;  region++) {
+      if (Nr[region] == 0) continue;
+      idx = index[region];
+
+      /* --- z = a - iv --                             -------------- */
+
+      for (m = 0;  m < Nr[region];  m++) {
+	zr[m] =  a[idx[m]];
+	zi[m] = -v[idx[m]];
+      }
+
+      switch (region) {
+      case 0:
+
+	/* --- Region I: W = 0.5641896 z / (z^2 + 0.5) -- ---------- */
+
+	for (m = 0;  m < Nr[0];  m++) {
+	  qr = zr[m]*zr[m] - zi[m]*zi[m] + 0.5;
+	  qi = 2.0*zr[m]*zi[m];
+	  denom = 0.5641896 / (qr*qr + qi*qi);
+	  Wr[m] = (zr[m]*qr + zi[m]*qi) * denom;
+	  Wi[m] = (zi[m]*qr - zr[m]*qi) * denom;
+	}
+	break;
+
+      case 1:
+
+	/* --- Region II: W = z (0.5641896 u + 1.410474) /
+	                      (u (u + 3) + 0.75), u = z^2 -- ------ */
+
+	for (m = 0;  m < Nr[1];  m++) {
+	  ur = zr[m]*zr[m] - zi[m]*zi[m];
+	  ui = 2.0*zr[m]*zi[m];
+	  tmp = 0.5641896*ur + 1.410474;
+	  pr = zr[m]*tmp - zi[m]*0.5641896*ui;
+	  pi = zr[m]*0.5641896*ui + zi[m]*tmp;
+	  qr = ur*(ur + 3.0) - ui*ui + 0.75;
+	  qi = ui*(ur + 3.0) + ur*ui;
+	  denom = 1.0 / (qr*qr + qi*qi);
+	  Wr[m] = (pr*qr + pi*qi) * denom;
+	  Wi[m] = (pi*qr - pr*qi) * denom;
+	}
+	break;
+
+      case 2:
+
+	/* --- Region III: rational function of z -- -------------- */
+
+	for (m = 0;  m < Nr[2];  m++) {
+	  pr = a3[0];        pi = 0.0;
+	  qr = zr[m] + b3[0];  qi = zi[m];
+	  for (j = 1;  j < 5;  j++) {
+	    tmp = pr*zr[m] - pi*zi[m] + a3[j];
+	    pi  = pr*zi[m] + pi*zr[m];
+	    pr  = tmp;
+	    tmp = qr*zr[m] - qi*zi[m] + b3[j];
+	    qi  = qr*zi[m] + qi*zr[m];
+	    qr  = tmp;
+	  }
+	  denom = 1.0 / (qr*qr + qi*qi);
+	  Wr[m] = (pr*qr + pi*qi) * denom;
+	  Wi[m] = (pi*qr - pr*qi) * denom;
+	}
+	break;
+
+      case 3:
+
+	/* --- Region IV: W = exp(u) - z p(u) / q(u), u = -z^2 -- -- */
+
+	for (m = 0;  m < Nr[3];  m++) {
+	  ur = zi[m]*zi[m] - zr[m]*zr[m];
+	  ui = -2.0*zr[m]*zi[m];
+	  pr = a4[0];        pi = 0.0;
+	  qr = ur + b4[0];   qi = ui;
+	  for (j = 1;  j < 7;  j++) {
+	    tmp = ur*pr - ui*pi + a4[j];
+	    pi  = ur*pi + ui*pr;
+	    pr  = tmp;
+	    tmp = ur*qr - ui*qi + b4[j];
+	    qi  = ur*qi + ui*qr;
+	    qr  = tmp;
+	  }
+	  tmp = zr[m]*pr - zi[m]*pi;
+	  pi  = zr[m]*pi + zi[m]*pr;
+	  pr  = tmp;
+	  denom = 1.0 / (qr*qr + qi*qi);
+	  e = exp(-ur);
+	  Wr[m] = e*cos(ui) - (pr*qr + pi*qi) * denom;
+	  Wi[m] = -e*sin(ui) - (pi*qr - pr*qi) * denom;
+	}
+	break;
+      }
+      for (m = 0;  m < Nr[region];  m++) H[idx[m]] = Wr[m];
+      if (F != NULL)
+	for (m = 0;  m < Nr[region];  m++) F[idx[m]] = Wi[m];
+    }
+  }
+}
+/* ------- end ---------------------------- VoigtHumlicekArray.c ---- */
 
-#define TABLE_ALGORITHM  RYBICKI
+/* ------- begin -------------------------- VoigtWeideman.c --------- */
 
-#define A_MIN  1.0E-05
-#define A_MAX  1.0E-02
-#define N_A    50
+/* --- Complex probability function w(z), z = v + ia, from the
+       rational expansion of Weideman 1994, SIAM J. Numer. Anal. 31,
+       p. 1497. With N_WEIDEMAN = 40 terms the absolute error in w is
+       about 1.0E-15, and the relative error in H stays below 1.0E-8
+       for a >= 1.0E-6 and |v| <= 50. It is used as the reference for
+       the lookup table below. Expansion coefficients are computed on
+       the first call. */
 
-#define V_MIN_LIN    0.0
-#define V_MAX_LIN    4.0
-#define N_V_LIN      400    
-#define V_MIN_LOG V_MAX_LIN
-#define V_MAX_LOG 1000.0
-#define N_V_LOG       30
-     
+#define N_WEIDEMAN  40
 
-/* --- Compute lookup table of Voigt function when called
-       for the first time. With subsequent calls the lookup table is
-       interpolated (bi-linearly for the moment) --    -------------- */
+static RH_TLS bool_t weideman_init = TRUE;
+static RH_TLS double weideman_coef[N_WEIDEMAN];
 
-double VoigtLookup(double a, double v)
+static void VoigtWeideman(double a, double v, double *Wr, double *Wi)
 {
-  const char routineName[] = "VoigtLookup";
-  register int n, m;
+  register int k, m;
 
-  static bool_t initialize = TRUE, hunt;
-  static double *a_table, *v_table_lin, *v_table_log,
-               **table_lin, **table_log, voigt, log_a;
+  const int M = 2*N_WEIDEMAN;
+  const double L = sqrt(N_WEIDEMAN / sqrt(2.0));
 
-  double da, dv;
+  double t, sum, Zr, Zi, pr, pi, qr, qi, dr, di, d2, tmp;
 
-  v = fabs(v);
+  if (weideman_init) {
+    for (m = 1;  m <= N_WEIDEMAN;  m++) {
+      sum = 0.0;
+      for (k = -M + 1;  k < M;  k++) {
+	t = L * tan(0.5*k*PI / M);
+	sum += exp(-t*t) * (L*L + t*t) * cos(PI * k*m / M);
+      }
+      weideman_coef[m-1] = sum / (2*M);
+    }
+    weideman_init = FALSE;
+  }
+  /* --- Z = (L + iz) / (L - iz), with d = L - iz = (L + a) - iv -- - */
+
+  dr = L + a;
+  di = -v;
+  d2 = dr*dr + di*di;
+  Zr = ((L - a)*dr - v*v) / d2;
+  Zi = (v*dr + (L - a)*v) / d2;
+
+  pr = weideman_coef[N_WEIDEMAN-1];
+  pi = 0.0;
+  for (m = N_WEIDEMAN-2;  m >= 0;  m--) {
+    tmp = pr*Zr - pi*Zi + weideman_coef[m];
+    pi  = pr*Zi + pi*Zr;
+    pr  = tmp;
+  }
+  /* --- w = (2p/d + 1/sqrt(pi)) / d --                -------------- */
 
-  if (a < A_MIN || a > A_MAX || v > V_MAX_LOG) {
-    sprintf(messageStr,
-	    "Arguments (%E, %E) outside domain table", a, v);
-    Error(WARNING, routineName, messageStr);
+  qr = 2.0 * (pr*dr + pi*di) / d2 + 1.0/SQRTPI;
+  qi = 2.0 * (pi*dr - pr*di) / d2;
+
+  *Wr = (qr*dr + qi*di) / d2;
+  *Wi = (qi*dr - qr*di) / d2;
+}
+/* ------- end ---------------------------- VoigtWeideman.c --------- */
+
+/* ------- begin -------------------------- VoigtLookupAccuracy.c --- */
+
+/* --- Tabulated complex probability function with controlled accuracy.
 
-    return Voigt(a, v, NULL, TABLE_ALGORITHM);
+       Inside |v| + a < LOOKUP_S the function w(z) is tabulated on a
+       square grid in the complex plane with spacing LOOKUP_H, and is
+       evaluated with a Taylor expansion around the nearest grid node.
+       The derivatives follow from the recurrence
+
+         w^(n+1)(z) = -2z w^(n)(z) - 2n w^(n-1)(z),
+         w'(z) = -2z w(z) + 2i/sqrt(pi),
+
+       so only w itself needs to be stored. Outside the table the
+       Laplace continued fraction of w is used. When the table is
+       built the order of the expansion and the depth of the continued
+       fraction are chosen as the smallest ones for which H and F
+       are reproduced to the requested relative accuracy (see
+       VoigtLookupAccuracy) at the points farthest from the nodes.
+
+       Since w(-v + ia) = conj(w(v + ia)) only v >= 0 is tabulated. -- */
+
+#define LOOKUP_S          8.0
+#define LOOKUP_H          0.125
+#define N_LOOKUP          65
+#define LOOKUP_ACCURACY   1.0E-06
+#define LOOKUP_A_TEST     1.0E-04
+#define LOOKUP_ORDER_MAX  16
+#define LOOKUP_NCF_MAX    80
+
+typedef struct {
+  bool_t  initialized;
+  int     order, Ncf;
+  double  accuracy, *Wr, *Wi;
+} VoigtTable;
+
+static RH_TLS VoigtTable lookup = {FALSE, 0, 0, LOOKUP_ACCURACY,
+				   NULL, NULL};
+
+static void lookupEval(int N, const double *a, const double *v,
+		       double *H, double *F, int order, int Ncf);
+static void initVoigtLookup(void);
+
+
+/* --- Set the relative accuracy of the lookup table. The table is
+       rebuilt at the next call when the accuracy changes -- -------- */
+
+void VoigtLookupAccuracy(double accuracy)
+{
+  if (accuracy <= 0.0) accuracy = LOOKUP_ACCURACY;
+  if (accuracy != lookup.accuracy) {
+    lookup.accuracy = accuracy;
+    lookup.initialized = FALSE;
   }
+}
+/* ------- end ---------------------------- VoigtLookupAccuracy.c --- */
+
+/* ------- begin -------------------------- VoigtLookup.c ----------- */
 
-  /* --- Populate the lookup tables on initialization -- ------------ */
+double VoigtLookup(double a, double v, double *F)
+{
+  double H;
 
-  if (initialize) {
-    a_table     = (double *) malloc(N_A * sizeof(double));
-    v_table_lin = (double *) malloc(N_V_LIN * sizeof(double));
-    v_table_log = (double *) malloc(N_V_LOG * sizeof(double));
-
-    table_lin = matrix_double(N_A, N_V_LIN);
-    table_log = matrix_double(N_A, N_V_LOG);
-
-    a_table[0]     = log(A_MIN);
-    a_table[N_A-1] = log(A_MAX);
-    da = (a_table[N_A-1] - a_table[0]) / (N_A - 1);
-    for (n = 1;  n < N_A-1;  n++)
-      a_table[n] = a_table[n-1] + da;
-
-    v_table_lin[0]         = V_MIN_LIN;
-    v_table_lin[N_V_LIN-1] = V_MAX_LIN;
-    dv = (v_table_lin[N_V_LIN-1] - v_table_lin[0]) / (N_V_LIN - 1);
-    for (m = 1;  m < N_V_LIN-1;  m++)
-      v_table_lin[m] = v_table_lin[m-1] + dv;
-
-    v_table_log[0]         = log(V_MIN_LOG);
-    v_table_log[N_V_LOG-1] = log(V_MAX_LOG);
-    dv = (v_table_log[N_V_LOG-1] - v_table_log[0]) / (N_V_LOG - 1);
-    for (m = 1;  m < N_V_LOG-1;  m++)
-      v_table_log[m] = v_table_log[m-1] + dv;
-
-    for (n = 0;  n < N_A;  n++) {
-      for (m = 0;  m < N_V_LIN;  m++) {
-        table_lin[n][m] = Voigt(exp(a_table[n]), v_table_lin[m],
-				NULL, TABLE_ALGORITHM);
+  VoigtLookupArray(1, &a, &v, &H, F);
+  return H;
+}
+/* ------- end ---------------------------- VoigtLookup.c ----------- */
+
+/* ------- begin -------------------------- VoigtLookupArray.c ------ */
+
+void VoigtLookupArray(int N, double *a, double *v, double *H, double *F)
+{
+  if (!lookup.initialized) initVoigtLookup();
+
+  lookupEval(N, a, v, H, F, lookup.order, lookup.Ncf);
+}
+/* ------- end ---------------------------- VoigtLookupArray.c ------ */
+
+/* ------- begin -------------------------- lookupEval.c ------------ */
+
+static void lookupEval(int N, const double *a, const double *v,
+		       double *H, double *F, int order, int Ncf)
+{
+  register int n, m, j;
+
+  int    Ntab, Nout, itab[VOIGT_BLOCK], iout[VOIGT_BLOCK], node, i0, j0;
+  double x[VOIGT_BLOCK], y[VOIGT_BLOCK], z0r[VOIGT_BLOCK],
+         z0i[VOIGT_BLOCK], dzr[VOIGT_BLOCK], dzi[VOIGT_BLOCK],
+         e0r[VOIGT_BLOCK], e0i[VOIGT_BLOCK], e1r[VOIGT_BLOCK],
+         e1i[VOIGT_BLOCK], Wr[VOIGT_BLOCK], Wi[VOIGT_BLOCK],
+         cr, ci, qr, qi, tmp, dz2r, dz2i, rr, ri, denom, vabs;
+
+  for (n = 0;  n < N;  n += VOIGT_BLOCK) {
+    const int Nb = MIN(VOIGT_BLOCK, N - n);
+
+    /* --- Sort the points of this block into table and
+           continued fraction domains --               -------------- */
+
+    Ntab = Nout = 0;
+    for (m = 0;  m < Nb;  m++) {
+      if (fabs(v[n+m]) + a[n+m] < LOOKUP_S)
+	itab[Ntab++] = n + m;
+      else
+	iout[Nout++] = n + m;
+    }
+    /* --- Taylor expansion around the nearest node --  -------------- */
+
+    for (m = 0;  m < Ntab;  m++) {
+      vabs = fabs(v[itab[m]]);
+      i0 = (int) (vabs / LOOKUP_H + 0.5);
+      j0 = (int) (a[itab[m]] / LOOKUP_H + 0.5);
+      node = j0*N_LOOKUP + i0;
+
+      z0r[m] = i0 * LOOKUP_H;
+      z0i[m] = j0 * LOOKUP_H;
+      dzr[m] = vabs - z0r[m];
+      dzi[m] = a[itab[m]] - z0i[m];
+      e0r[m] = lookup.Wr[node];
+      e0i[m] = lookup.Wi[node];
+    }
+    for (m = 0;  m < Ntab;  m++) {
+
+      /* --- e_n = w^(n)(z0) dz^n / n!, starting with e_0 and e_1 -- */
+
+      qr = -2.0*(z0r[m]*e0r[m] - z0i[m]*e0i[m]);
+      qi = -2.0*(z0r[m]*e0i[m] + z0i[m]*e0r[m]) + 2.0/SQRTPI;
+      e1r[m] = qr*dzr[m] - qi*dzi[m];
+      e1i[m] = qr*dzi[m] + qi*dzr[m];
+      Wr[m]  = e0r[m] + e1r[m];
+      Wi[m]  = e0i[m] + e1i[m];
+    }
+    for (j = 1;  j < order;  j++) {
+
+      /* --- e_(j+1) = -2 (z0 dz e_j + dz^2 e_(j-1)) / (j+1) -- ----- */
+
+      for (m = 0;  m < Ntab;  m++) {
+	cr = z0r[m]*dzr[m] - z0i[m]*dzi[m];
+	ci = z0r[m]*dzi[m] + z0i[m]*dzr[m];
+	dz2r = dzr[m]*dzr[m] - dzi[m]*dzi[m];
+	dz2i = 2.0*dzr[m]*dzi[m];
+
+	qr = (cr*e1r[m] - ci*e1i[m]) + (dz2r*e0r[m] - dz2i*e0i[m]);
+	qi = (cr*e1i[m] + ci*e1r[m]) + (dz2r*e0i[m] + dz2i*e0r[m]);
+	tmp = -2.0 / (j + 1);
+
+	e0r[m] = e1r[m];
+	e0i[m] = e1i[m];
+	e1r[m] = tmp * qr;
+	e1i[m] = tmp * qi;
+	Wr[m] += e1r[m];
+	Wi[m] += e1i[m];
       }
-      for (m = 0;  m < N_V_LOG;  m++) {
-        table_log[n][m] = Voigt(exp(a_table[n]), exp(v_table_log[m]),
-				NULL, TABLE_ALGORITHM);
+    }
+    for (m = 0;  m < Ntab;  m++) {
+      H[itab[m]] = Wr[m];
+      if (F != NULL)
+	F[itab[m]] = (v[itab[m]] < 0.0) ? -Wi[m] : Wi[m];
+    }
+    /* --- Laplace continued fraction outside the table -- ---------- */
+
+    for (m = 0;  m < Nout;  m++) {
+      x[m] = fabs(v[iout[m]]);
+      y[m] = a[iout[m]];
+    }
+    for (m = 0;  m < Nout;  m++) {
+      rr = ri = 0.0;
+      for (j = Ncf;  j >= 1;  j--) {
+	cr = x[m] - rr;
+	ci = y[m] - ri;
+	denom = 0.5*j / (cr*cr + ci*ci);
+	rr =  cr * denom;
+	ri = -ci * denom;
       }
+      /* --- w = (i/sqrt(pi)) / (z - r) --             -------------- */
+
+      cr = x[m] - rr;
+      ci = y[m] - ri;
+      denom = 1.0 / (SQRTPI * (cr*cr + ci*ci));
+      Wr[m] = ci * denom;
+      Wi[m] = cr * denom;
+    }
+    for (m = 0;  m < Nout;  m++) {
+      H[iout[m]] = Wr[m];
+      if (F != NULL)
+	F[iout[m]] = (v[iout[m]] < 0.0) ? -Wi[m] : Wi[m];
     }
-    sprintf(messageStr, "Created Voigt lookup tables\n");
-    Error(MESSAGE, routineName, messageStr);
+  }
+}
+/* ------- end ---------------------------- lookupEval.c ------------ */
 
-    initialize = FALSE;
+/* ------- begin -------------------------- initVoigtLookup.c ------- */
+
+/* --- Largest relative error in H and F of the approximation with
+       given order and continued fraction depth with respect to the
+       Weideman expansion. --                          -------------- */
+
+static double lookupError(int N, double *a, double *v,
+			  double *Href, double *Fref,
+			  int order, int Ncf)
+{
+  register int n;
+
+  double *H, *F, error = 0.0;
+
+  H = (double *) malloc(N * sizeof(double));
+  F = (double *) malloc(N * sizeof(double));
+  lookupEval(N, a, v, H, F, order, Ncf);
+
+  for (n = 0;  n < N;  n++) {
+    error = MAX(error, fabs(H[n] - Href[n]) / fabs(Href[n]));
+    error = MAX(error, fabs(F[n] - Fref[n]) / fabs(Fref[n]));
   }
-  /* --- There are two domains. Interpolation is always logarithmic
-         in damping parameter a. For large values of Doppler frequency
-         v it is also logarithmic in v, otherwise it is linear in v - */
+  free(H);  free(F);
 
-  log_a = log(a);
+  return error;
+}
 
-  if (v < V_MAX_LIN) {
-    voigt = BiLinear(N_A, a_table, log_a, N_V_LIN, v_table_lin, v,
-		     table_lin, hunt=TRUE);
-  } else {
-    voigt = BiLinear(N_A, a_table, log_a, N_V_LOG, v_table_log, log(v),
-		     table_log, hunt=FALSE);
+static void initVoigtLookup(void)
+{
+  const char routineName[] = "initVoigtLookup";
+  register int i, j;
+
+  int     Ninner, Nedge, Nalloc;
+  double *a, *v, *Href, *Fref, error;
+
+  if (lookup.Wr == NULL) {
+    lookup.Wr = (double *) malloc(SQ(N_LOOKUP) * sizeof(double));
+    lookup.Wi = (double *) malloc(SQ(N_LOOKUP) * sizeof(double));
+
+    for (j = 0;  j < N_LOOKUP;  j++) {
+      for (i = 0;  i < N_LOOKUP;  i++)
+	VoigtWeideman(j*LOOKUP_H, i*LOOKUP_H,
+		      lookup.Wr + j*N_LOOKUP + i, lookup.Wi + j*N_LOOKUP + i);
+    }
   }
-  return voigt;
+  /* --- Test points halfway between nodes, where the Taylor
+         expansion is least accurate, including a row close to the
+         real axis where H is small in the line wings, and points
+         along the table boundary, where the continued fraction
+         converges slowest --                          -------------- */
+
+  Nalloc = SQ(N_LOOKUP) + 2*N_LOOKUP;
+  a    = (double *) malloc(Nalloc * sizeof(double));
+  v    = (double *) malloc(Nalloc * sizeof(double));
+  Href = (double *) malloc(Nalloc * sizeof(double));
+  Fref = (double *) malloc(Nalloc * sizeof(double));
+
+  Ninner = 0;
+  for (j = -1;  j < N_LOOKUP-1;  j++) {
+    for (i = 0;  i < N_LOOKUP-1;  i++) {
+      a[Ninner] = (j < 0) ? LOOKUP_A_TEST : (j + 0.5) * LOOKUP_H;
+      v[Ninner] = (i + 0.5) * LOOKUP_H;
+      if (a[Ninner] + v[Ninner] < LOOKUP_S) Ninner++;
+    }
+  }
+  Nedge = 0;
+  for (i = 0;  i < N_LOOKUP-1;  i++, Nedge++) {
+    a[Ninner + Nedge] = (i + 0.5) * LOOKUP_H;
+    v[Ninner + Nedge] = LOOKUP_S - a[Ninner + Nedge];
+  }
+  for (i = 0;  i < Ninner + Nedge;  i++)
+    VoigtWeideman(a[i], v[i], Href + i, Fref + i);
+
+  for (lookup.order = 2;  lookup.order < LOOKUP_ORDER_MAX;
+       lookup.order++) {
+    error = lookupError(Ninner, a, v, Href, Fref, lookup.order, 0);
+    if (error <= lookup.accuracy) break;
+  }
+  for (lookup.Ncf = 1;  lookup.Ncf < LOOKUP_NCF_MAX;  lookup.Ncf++) {
+    if (lookupError(Nedge, a + Ninner, v + Ninner, Href + Ninner,
+		    Fref + Ninner, lookup.order, lookup.Ncf) <=
+	lookup.accuracy) break;
+  }
+  error = MAX(error, lookupError(Nedge, a + Ninner, v + Ninner,
+				 Href + Ninner, Fref + Ninner,
+				 lookup.order, lookup.Ncf));
+  if (error > lookup.accuracy) {
+    sprintf(messageStr, "Requested accuracy %E not reached, "
+	    "using %E instead", lookup.accuracy, error);
+    Error(WARNING, routineName, messageStr);
+  }
+  sprintf(messageStr,
+	  "Created Voigt lookup table: order %d, %d fraction terms, "
+	  "accuracy %9.3E\n", lookup.order, lookup.Ncf, error);
+  Error(MESSAGE, routineName, messageStr);
+
+  free(a);  free(v);
+  free(Href);  free(Fref);
+
+  lookup.initialized = TRUE;
 }
-/* ------- begin -------------------------- VoigtLookup.c ----------- */
+/* ------- end ---------------------------- initVoigtLookup.c ------- */
@@ -0,0 +1,149 @@
+/* ------- file: -------------------------- voigtbench.c ------------ */
+
+/* --- Micro benchmark of the Voigt function generators in voigt.c.
+
+       Times the point-by-point Voigt() for each algorithm and the
+       array version VoigtArray() for HUMLICEK and LOOKUP on a set of
+       (a, v) values typical for line profiles, and reports the largest
+       relative error in H and F with respect to the lookup table
+       evaluated at an accuracy of 1.0E-09.
+
+       Build with "make voigtbench" in this directory, run as
+
+         voigtbench [lookup accuracy (1.0E-06)] [Npoints (100000)]
+
+       --                                              -------------- */
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "rh.h"
+#include "error.h"
+#include "inputs.h"
+
+
+/* --- Function prototypes --                          -------------- */
+
+
+/* --- Global variables --                             -------------- */
+
+RH_TLS CommandLine commandline;
+RH_TLS char messageStr[MAX_MESSAGE_LENGTH];
+
+#define A_MIN      1.0E-04
+#define A_MAX      1.0
+#define V_MAX     20.0
+#define N_REPEAT   20
+#define REFERENCE_ACCURACY  1.0E-09
+
+static const char *algorithmName[] = {"ARMSTRONG", "RYBICKI", "HUI_ETAL",
+				      "HUMLICEK", "LOOKUP"};
+
+
+/* ------- begin -------------------------- seconds.c --------------- */
+
+static double seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0E-09*ts.tv_nsec;
+}
+/* ------- end ---------------------------- seconds.c --------------- */
+
+/* ------- begin -------------------------- report.c ---------------- */
+
+static void report(const char *label, enum VoigtAlgorithm algorithm,
+		   double time, int N, double *H, double *F,
+		   double *Href, double *Fref)
+{
+  register int n;
+
+  double errH = 0.0, errF = 0.0;
+
+  for (n = 0;  n < N;  n++) {
+    errH = MAX(errH, fabs(H[n] - Href[n]) / fabs(Href[n]));
+    if (F != NULL && Fref[n] != 0.0)
+      errF = MAX(errF, fabs(F[n] - Fref[n]) / fabs(Fref[n]));
+  }
+  if (F != NULL)
+    printf(" %-6s %-10s %8.2f ns/point   max rel. error H %9.2E  F %9.2E\n",
+	   label, algorithmName[algorithm], 1.0E9 * time / (N_REPEAT * N),
+	   errH, errF);
+  else
+    printf(" %-6s %-10s %8.2f ns/point   max rel. error H %9.2E\n",
+	   label, algorithmName[algorithm], 1.0E9 * time / (N_REPEAT * N),
+	   errH);
+}
+/* ------- end ---------------------------- report.c ---------------- */
+
+/* ------- begin -------------------------- main.c ------------------ */
+
+int main(int argc, char *argv[])
+{
+  register int n, r;
+
+  enum VoigtAlgorithm algorithm;
+  int     N, withF;
+  double  accuracy, *a, *v, *H, *F, *Href, *Fref, time, sum = 0.0;
+
+  accuracy = (argc > 1) ? atof(argv[1]) : 1.0E-06;
+  N        = (argc > 2) ? atoi(argv[2]) : 100000;
+
+  commandline.quiet   = FALSE;
+  commandline.logfile = stderr;
+
+  a    = (double *) malloc(N * sizeof(double));
+  v    = (double *) malloc(N * sizeof(double));
+  H    = (double *) malloc(N * sizeof(double));
+  F    = (double *) malloc(N * sizeof(double));
+  Href = (double *) malloc(N * sizeof(double));
+  Fref = (double *) malloc(N * sizeof(double));
+
+  /* --- Damping logarithmically and Doppler offset uniformly
+         distributed, in the order of a depth loop -- ------------- */
+
+  srand(1);
+  for (n = 0;  n < N;  n++) {
+    a[n] = A_MIN * pow(A_MAX / A_MIN, (double) rand() / RAND_MAX);
+    v[n] = V_MAX * (2.0 * rand() / RAND_MAX - 1.0);
+  }
+  VoigtLookupAccuracy(REFERENCE_ACCURACY);
+  VoigtLookupArray(N, a, v, Href, Fref);
+  VoigtLookupAccuracy(accuracy);
+  VoigtLookupArray(1, a, v, H, F);
+
+  printf("\n Voigt benchmark: %d points, a = [%.1E, %.1E], |v| < %.1f,"
+	 " lookup accuracy %.1E\n\n", N, A_MIN, A_MAX, V_MAX, accuracy);
+
+  for (algorithm = ARMSTRONG;  algorithm <= LOOKUP;  algorithm++) {
+    withF = (algorithm == HUI_ETAL || algorithm == HUMLICEK ||
+	     algorithm == LOOKUP);
+    time = seconds();
+    for (r = 0;  r < N_REPEAT;  r++) {
+      for (n = 0;  n < N;  n++)
+	H[n] = Voigt(a[n], v[n], (withF) ? F + n : NULL, algorithm);
+      sum += H[r % N];
+    }
+    report("Voigt", algorithm, seconds() - time, N, H,
+	   (withF) ? F : NULL, Href, Fref);
+  }
+  printf("\n");
+  for (algorithm = HUMLICEK;  algorithm <= LOOKUP;  algorithm++) {
+    time = seconds();
+    for (r = 0;  r < N_REPEAT;  r++) {
+      VoigtArray(N, a, v, H, F, algorithm);
+      sum += H[r % N];
+    }
+    report("Array", algorithm, seconds() - time, N, H, F, Href, Fref);
+  }
+  printf("\n (checksum %E)\n\n", sum);
+
+  free(a);  free(v);  free(H);  free(F);
+  free(Href);  free(Fref);
+
+  return 0;
+}
+/* ------- end ---------------------------- main.c ------------------ */
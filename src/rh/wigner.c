@@ -163,8 +163,8 @@ double fact(double xi)
 
   register int n;
 
-  static bool_t initialize = TRUE;
-  static double *factorial;
+  static RH_TLS bool_t initialize = TRUE;
+  static RH_TLS double *factorial;
 
   if (initialize) {
     factorial = (double *) malloc(NFACT * sizeof(double));
@@ -25,8 +25,8 @@
 
 /* --- Global variables --                             -------------- */
 
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- xdr_counted_string.c ---- */
@@ -26,8 +26,8 @@ bool_t xdr_molecules(XDR *xdrs, Molecule *molecules);
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- writeMolecules.c -------- */
@@ -27,9 +27,9 @@
 
 /* --- Global variables --                             -------------- */
 
-extern Atmosphere atmos;
-extern InputData input;
-extern char messageStr[];
+extern RH_TLS Atmosphere atmos;
+extern RH_TLS InputData input;
+extern RH_TLS char messageStr[];
 
 
 /* ------- begin -------------------------- determinate.c ----------- */
@@ -333,7 +333,7 @@ void adjustStokesMode()
 	  /* --- First free up the space used in field-free
                  calculation --                        -------------- */
 	  
-	  if (!input.limit_memory){
+	  if (!input.limit_memory && !input.profile_single){
 	    freeMatrix((void **) line->phi);
 	    line->phi = NULL;
 	  }
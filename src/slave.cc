@@ -14,6 +14,7 @@
 #include <mpi.h>
 #include <vector>
 #include <stdio.h>
+#include <omp.h>
 #include "io.h"
 #include "comm.h"
 #include "input.h"
@@ -22,6 +23,7 @@
 #include "depthmodel.h"
 #include "cmemt.h"
 #include "crh.h"
+#include "master_sparse.h"
 //
 #include "instruments.h"
 #include "spectral.h"
@@ -29,6 +31,91 @@
 #include "fpigen.h"
 
 using namespace std;
+//
+/* --- FFTW plans are re-created when the PSF changes and the planner is
+   not thread-safe --- */
+
+static void updateInstruments(vector<instrument*> &inst, iput_t &input)
+{
+  int const nreg = int(inst.size());
+  
+#pragma omp critical(slave_fftw_plan)
+  for(int kk = 0; kk<nreg; kk++) //inst[kk]->update((size_t)(input.ipix + pixel));
+    inst[kk]->update(input.regions[kk].psf.d.size(), &input.regions[kk].psf.d[0]);
+}
+
+//
+/* --- Sub-master: receives blocks of pixels from rank 0, spreads them over
+   the slaves of this node with the same machinery as the master and returns
+   the block as if it had been computed here --- */
+
+static void do_submaster(iput_t &input, iput_t &up)
+{
+  comm_queue_t queue = {};
+  comm_queue_t *qptr = NULL;
+  if(up.prefetch > 0){
+    comm_slave_init_queue(up, queue);
+    qptr = &queue;
+  }
+
+  /* --- The master already ordered and sized the blocks --- */
+  
+  input.schedule = 0, input.pix_order = 0;
+  int const ndep = input.ndep, nw = input.nw_tot, ns = input.ns;
+  
+  while(1){
+    int action = 0, cgrad = 0;
+    mat<double> obs, pars;
+    vector<mdepth_t> m;
+    
+    comm_slave_unpack_data(up, action, obs, pars, m, cgrad, qptr);
+    if(action == 0) break;
+
+    
+    /* --- The block is a raster of 1 x B pixels for the local slaves --- */
+    
+    int const B = up.nPacked;
+    input.nx = B, input.ny = 1;
+    input.regions = up.regions; // instrumental profile of this block
+    input.dpar = up.dpar;
+
+    mat<double> lobs, lpars, chi2, dsyn, ptime;
+    lobs.set({1, B, nw, ns});
+    lpars.set({1, B, max(input.npar,1)});
+    if(obs.d.size() == lobs.d.size()) lobs.d = obs.d;
+    if(pars.d.size() == lpars.d.size()) lpars.d = pars.d;
+    
+    mdepthall_t lm;
+    lm.setsize(1, B, ndep, false);
+    lm.boundary.set({1, B});
+    for(int ii=0; ii<B; ii++){
+      memcpy(&lm.cub.d[ii*13*ndep], &m[ii].cub.d[0], 13*ndep*sizeof(double));
+      lm.boundary.d[ii] = m[ii].bound_val;
+    }
+    
+    if(input.mode == 4) dsyn.set({1, B, input.nresp, ndep, nw, ns});
+    else if(input.mode == 3 && cgrad) dsyn.set({1, B, input.npar, nw, ns});
+
+    
+    /* --- Farm out to the slaves of this node --- */
+    
+    slaveInversion(input, lm, lobs, lpars, chi2, dsyn, ptime);
+
+    
+    /* --- Send back upwards in slave format --- */
+    
+    for(int ii=0; ii<B; ii++)
+      memcpy(&m[ii].cub.d[0], &lm.cub.d[ii*13*ndep], 13*ndep*sizeof(double));
+    up.chi = chi2.d;
+    up.ptime = ptime.d;
+    
+    comm_slave_pack_data(up, lobs, lpars, dsyn, cgrad, m, qptr);
+  }
+
+  if(qptr) comm_slave_free_queue(queue);
+  comm_kill_slaves(input, input.nprocs);
+}
+
 //
 void do_slave(int myrank, int nprocs, char hostname[]){
   //
@@ -54,38 +141,76 @@ void do_slave(int myrank, int nprocs, char hostname[]){
   input.myrank = myrank;
   if(input.mode == 1 || input.mode == 3) comm_send_weights(input, w);
 
+
+  /* --- Sub-masters only redistribute work (mpi_submasters) --- */
+  {
+    iput_t up;
+    if(comm_init_hierarchy(input, &up) == 1){
+      do_submaster(input, up);
+      return;
+    }
+  }
+
+  
+  /* --- Threads per slave (slave_threads): each one gets its own atmos and
+     instruments (and therefore its own RH instance). The Fortran EOS keeps
+     global state, so several threads need the C++ EOS (eos_type = 1) --- */
+
+  int nthreads = max(input.slave_threads, 1);
+  if(nthreads > 1 && input.eos_type != 1){
+    if(myrank == 1)
+      fprintf(stderr, "%s%sWARNING, slave_threads > 1 needs eos_type = 1, using 1 thread\n",
+	      input.myid.c_str(), inam.c_str());
+    nthreads = 1;
+  }
+  
   
   /* --- Init atmosphere --- */
-  atmos *atmos;
-  if(input.atmos_type == string("lte")){
-    atmos = new clte(input, 4.44);
-  }else if(input.atmos_type == string("rh")){
-    atmos = new crh(input, 4.44);
-  }else{
-    cerr << input.myid << inam << "ERROR, atmos ["<<input.atmos_type<<"] not implemented"<<endl;
-    exit(0);
+  vector<atmos*> atm(nthreads, NULL);
+  for(auto &it: atm){
+    if(input.atmos_type == string("lte")){
+      it = new clte(input, 4.44);
+    }else if(input.atmos_type == string("rh")){
+      it = new crh(input, 4.44);
+    }else{
+      cerr << input.myid << inam << "ERROR, atmos ["<<input.atmos_type<<"] not implemented"<<endl;
+      exit(0);
+    }
   }
 
-
+  
   /* --- (TO-DO, change this!) --- */
 
-  vector<instrument*> inst;
-  int nreg = atmos->input.regions.size();
-  inst.resize(nreg);
+  int nreg = atm[0]->input.regions.size();
+  vector<vector<instrument*>> insts(nthreads);
+
+  for(int tt=0; tt<nthreads; tt++){
+    vector<instrument*> &inst = insts[tt];
+    atmos *atmos = atm[tt];
+    inst.resize(nreg);
   
-  for(int kk = 0; kk<nreg; kk++){
-    if(atmos->input.regions[kk].inst == "spectral") inst[kk] = new   spectral(atmos->input.regions[kk], 1);
-    else if(atmos->input.regions[kk].inst == "fpi") inst[kk] = new       sfpi(atmos->input.regions[kk], 1);
-    else if(atmos->input.regions[kk].inst == "fpigen") inst[kk] = new sfpigen(atmos->input.regions[kk], 1);
-    else inst[kk] = new instrument();
+    for(int kk = 0; kk<nreg; kk++){
+      if(atmos->input.regions[kk].inst == "spectral") inst[kk] = new   spectral(atmos->input.regions[kk], 1);
+      else if(atmos->input.regions[kk].inst == "fpi") inst[kk] = new       sfpi(atmos->input.regions[kk], 1);
+      else if(atmos->input.regions[kk].inst == "fpigen") inst[kk] = new sfpigen(atmos->input.regions[kk], 1);
+      else inst[kk] = new instrument();
+    }
+    atmos->inst = &inst[0];
   }
-  atmos->inst = &inst[0];
 
   
   vector<mdepth_t> m;
   mat<double> dobs;
-  vector<double> pgas_saved;
-  pgas_saved.resize(input.ndep);
+
+
+  /* --- Keep packages queued while we work? --- */
+
+  comm_queue_t queue = {};
+  comm_queue_t *qptr = NULL;
+  if(input.prefetch > 0){
+    comm_slave_init_queue(input, queue);
+    qptr = &queue;
+  }
   
   // 
   // Work until action == 0
@@ -99,7 +224,7 @@ void do_slave(int myrank, int nprocs, char hostname[]){
     // Receive package from master, including action
     //
     int compute_derivatives = 0;
-    comm_slave_unpack_data(input, action, obs, pars, m, compute_derivatives);
+    comm_slave_unpack_data(input, action, obs, pars, m, compute_derivatives, qptr);
     if(action == 0) break; // Exit while loop if action = 0
     
     //
@@ -108,24 +233,29 @@ void do_slave(int myrank, int nprocs, char hostname[]){
     if(input.mode == 1){
 
       /* --- Invert pixels --- */
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
       for(int pp = 0; pp<input.nPacked; pp++){
+	double t0 = MPI_Wtime();
+	int const tid = omp_get_thread_num();
 
 	/* --- Update instrumental profile if needed --- */
-	
-	for(int kk = 0; kk<nreg; kk++) inst[kk]->update(input.regions[kk].psf.d.size(), &input.regions[kk].psf.d[0]);
+
+	updateInstruments(insts[tid], input);
 
 	
 	/* --- Perform inversion --- */
 	
 	input.chi[pp] =
-	  atmos->fitModel2( m[pp], input.npar, &pars(pp,0),
-			    (int)(input.nw_tot*input.ns), &obs(pp,0,0), w);
+	  atm[tid]->fitModel2( m[pp], input.npar, &pars(pp,0),
+			       (int)(input.nw_tot*input.ns), &obs(pp,0,0), w);
+
+	input.ptime[pp] = MPI_Wtime() - t0; // used by the master to size packages
       }
 
       
       // Send back to master
       
-      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m);
+      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m, qptr);
       
     }else if(input.mode == 2){
       
@@ -134,12 +264,14 @@ void do_slave(int myrank, int nprocs, char hostname[]){
       
       int nPacked = input.nPacked;
       int ndata = input.nw_tot * input.ns;
-      vector<int> mydims = {nPacked, input.npar, input.nw_tot, input.ns};
 
       
       /* --- Loop pixels --- */
-      int pixel = 0;      
-      for(auto &it: m){
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+      for(int pixel = 0; pixel<nPacked; pixel++){
+	double t0 = MPI_Wtime();
+	atmos *atmos = atm[omp_get_thread_num()];
+	mdepth_t &it = m[pixel];
 
 	/* --- Log tau to tau --- */
 	
@@ -179,22 +311,21 @@ void do_slave(int myrank, int nprocs, char hostname[]){
 	/* --- If not converged, printout message --- */
 	if(!conv) {
 	  int x =0, y=0;
-	  comm_get_xy(input.ipix+pixel, input.nx, y, x);
+	  comm_get_xy(input.pixels[pixel], input.nx, y, x);
 	  
 	  fprintf(stderr, "[%6d] slave: ERROR, atom populations did not converge for pixel (x,y) = [%4d,%4d]\n", myrank, x, y);
 	}
       
 	/* --- Update instrumental profile if needed --- */
 	
-	for(int kk = 0; kk<nreg; kk++) //inst[kk]->update((size_t)(input.ipix + pixel));
-	  inst[kk]->update(input.regions[kk].psf.d.size(), &input.regions[kk].psf.d[0]);
+	updateInstruments(insts[omp_get_thread_num()], input);
 
 	
 	/* --- Degrade --- */
 
 	atmos->spectralDegrade(input.ns, (int)1, ndata, &obs(pixel, 0, 0));
 	
-	pixel++;
+	input.ptime[pixel] = MPI_Wtime() - t0;
       }
 
 
@@ -203,7 +334,7 @@ void do_slave(int myrank, int nprocs, char hostname[]){
       
       /* --- Send back profiles --- */
       
-      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m);
+      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m, qptr);
       m.clear();
       
       
@@ -218,8 +349,12 @@ void do_slave(int myrank, int nprocs, char hostname[]){
       
       
       /* --- Loop pixels --- */
-      int pixel = 0;      
-      for(auto &it: m){
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+      for(int pixel = 0; pixel<nPacked; pixel++){
+	double t0 = MPI_Wtime();
+	atmos *atmos = atm[omp_get_thread_num()];
+	mdepth_t &it = m[pixel];
+	vector<double> pgas_saved(input.ndep, 0.0);
 
 
 	/* --- Check parameter ranges --- */
@@ -261,12 +396,12 @@ void do_slave(int myrank, int nprocs, char hostname[]){
 
 	memcpy(&it.pgas[0], &pgas_saved[0], input.ndep*sizeof(double));
 	
-	pixel++;
-      } // auto it: m
+	input.ptime[pixel] = MPI_Wtime() - t0;
+      } // pixel
       
       
       /* --- Send results back to master --- */
-      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m);
+      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m, qptr);
 
       
       /* --- Clean-up ---*/
@@ -286,8 +421,11 @@ void do_slave(int myrank, int nprocs, char hostname[]){
       dobs.zero();
       
       /* --- Loop pixels --- */
-      int pixel = 0;      
-      for(auto &it: m){
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+      for(int pixel = 0; pixel<nPacked; pixel++){
+	double t0 = MPI_Wtime();
+	atmos *atmos = atm[omp_get_thread_num()];
+	mdepth_t &it = m[pixel];
 
 	/* --- Log tau to tau --- */
 	
@@ -310,8 +448,7 @@ void do_slave(int myrank, int nprocs, char hostname[]){
 	
 	/* --- Update instrumental profile if needed --- */
 	
-	for(int kk = 0; kk<nreg; kk++) //inst[kk]->update((size_t)(input.ipix + pixel));
-	  inst[kk]->update(input.regions[kk].psf.d.size(), &input.regions[kk].psf.d[0]);
+	updateInstruments(insts[omp_get_thread_num()], input);
 
 	
 	/* --- Synthesize spectra --- */
@@ -321,7 +458,7 @@ void do_slave(int myrank, int nprocs, char hostname[]){
 	/* --- If not converged, printout message --- */
 	if(!conv) {
 	  int x =0, y=0;
-	  comm_get_xy(input.ipix+pixel, input.nx, y, x);
+	  comm_get_xy(input.pixels[pixel], input.nx, y, x);
 	  
 	  fprintf(stderr, "[%6d] slave: ERROR, atom populations did not converge for pixel (x,y) = [%4d,%4d]\n", myrank, x, y);
 	}
@@ -346,14 +483,14 @@ void do_slave(int myrank, int nprocs, char hostname[]){
 	/* --- Degrade --- */
 
 	atmos->spectralDegrade(input.ns, (int)1, ndata, &obs(pixel, 0, 0));
-	pixel++;
+	input.ptime[pixel] = MPI_Wtime() - t0;
       }
 
       
       
       /* --- Send back profiles --- */
       
-      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m);
+      comm_slave_pack_data(input, obs, pars, dobs, compute_derivatives, m, qptr);
       m.clear();
       
       
@@ -365,7 +502,10 @@ void do_slave(int myrank, int nprocs, char hostname[]){
   }
 
   
-  for(auto &it: inst)
-    delete it;  
+  if(qptr) comm_slave_free_queue(queue);
+  
+  for(auto &inst: insts)
+    for(auto &it: inst)
+      delete it;  
   
 }